@@ -5,6 +5,7 @@
 #include <cstdint>
 
 #include "gzn/audio/context.hpp"
+#include "gzn/audio/telemetry.hpp"
 
 namespace gzn::audio {
 
@@ -14,6 +15,10 @@ enum class status_t : uint8_t {
 	busy    = 2, ///< pwm audio busy
 };
 
+inline constexpr uint8_t DUTY_SHIFT{ BITS_PER_SAMPLE - DUTY_RESOLUTION };
+
+using duty_array = std::array<uint16_t, SAMPLE_BATCH_SIZE * OUTPUT_CHANNELS>;
+
 struct pwm {
 	static auto startup() -> startup_result;
 	static void shutdown();
@@ -24,17 +29,36 @@ struct pwm {
 	[[nodiscard]]
 	static auto status() -> status_t;
 
-	static void set_track_volume(const track_id track, const uint8_t value);
-	static void send_sample(std::span<const int16_t> samples);
-	static void send_samples(
-		const std::array<samples_array, MAX_SOUND_TRACKS> &samples_batch,
-		const std::array<size_t,        MAX_SOUND_TRACKS> &batch_sizes,
-		const size_t max_batch_size,
-		const uint16_t active_batches_count
-	);
+	/// Formats mixed (interleaved if stereo) samples to duty values and sends them to the ISR
+	static void send_block(std::span<const int16_t> samples);
+
+	/// Nothing to send for a while, so the ISR starving isn't an underrun
+	static void idle();
+
+	/// Frames sent but not played yet
+	[[nodiscard]]
+	static auto queued_frames() -> uint32_t;
+
+	[[nodiscard]]
+	static auto telemetry() -> backend_telemetry;
+	static void reset_telemetry();
+
+	/// Signed sample to the unsigned duty of DUTY_RESOLUTION bits
+	[[nodiscard]] [[gnu::always_inline]]
+	static constexpr auto to_duty(const int16_t sample) -> uint16_t {
+		return static_cast<uint16_t>((static_cast<int32_t>(sample) + 0x8000) >> DUTY_SHIFT);
+	}
+
+	[[gnu::always_inline]]
+	static constexpr void format(std::span<const int16_t> samples, std::span<uint16_t> duties) {
+		for (size_t i{}; i < std::size(samples); ++i) {
+			duties[i] = to_duty(samples[i]);
+		}
+	}
 };
 
+inline constexpr uint16_t SILENCE_DUTY{ pwm::to_duty(0) };
+
 using backend = pwm;
 
 } // namespace gzn::audio
-
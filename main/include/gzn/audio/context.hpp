@@ -1,12 +1,13 @@
 #pragma once
 
+#include <bit>
 #include <array>
 #include <limits>
+#include <utility>
+#include <algorithm>
 #include <cstdint>
 #include <string_view>
 
-#include <driver/ledc.h>
-
 namespace gzn::audio {
 
 using track_id = size_t;
@@ -15,25 +16,74 @@ enum class sample_rate : uint32_t {
 	SR_8000_HZ  =  8'000,
 	SR_11025_HZ = 11'025,
 	SR_16000_HZ = 16'000,
+	SR_22050_HZ = 22'050,
+	SR_44100_HZ = 44'100,
 
 	SR_MIN = SR_8000_HZ,
-	SR_MAX = SR_16000_HZ,
+	SR_MAX = SR_44100_HZ,
 };
 
+inline constexpr uint32_t PWM_SOURCE_CLOCK_HZ{ 80'000'000 }; ///< APB, clocks the LEDC timer
+inline constexpr uint8_t  MIN_DUTY_RESOLUTION{  8 };
+inline constexpr uint8_t  MAX_DUTY_RESOLUTION{ 14 }; ///< LEDC limit
+inline constexpr size_t   MAX_BATCH_SIZE     { 1024u };
+
+/// The widest duty whose PWM period still fits into a single sample
+[[nodiscard]]
+consteval auto duty_resolution_for(const sample_rate rate) -> uint8_t {
+	uint8_t bits{ MAX_DUTY_RESOLUTION };
+	while (bits > MIN_DUTY_RESOLUTION && (PWM_SOURCE_CLOCK_HZ >> bits) < std::to_underlying(rate)) {
+		--bits;
+	}
+	return bits;
+}
+
+/// About 1/16 s of frames, so the blocks take the same time at any rate
+[[nodiscard]]
+consteval auto batch_size_for(const sample_rate rate) -> size_t {
+	return std::min<size_t>(std::bit_ceil(std::to_underlying(rate) / 16u), MAX_BATCH_SIZE);
+}
+
+#if defined(GZN_AUDIO_SAMPLE_RATE)
+inline constexpr auto     SAMPLE_RATE    { static_cast<sample_rate>(GZN_AUDIO_SAMPLE_RATE) };
+#else
+inline constexpr auto     SAMPLE_RATE    { sample_rate::SR_8000_HZ };
+#endif // defined(GZN_AUDIO_SAMPLE_RATE)
+
+static_assert(SAMPLE_RATE == sample_rate::SR_8000_HZ  || SAMPLE_RATE == sample_rate::SR_11025_HZ
+	||        SAMPLE_RATE == sample_rate::SR_16000_HZ || SAMPLE_RATE == sample_rate::SR_22050_HZ
+	||        SAMPLE_RATE == sample_rate::SR_44100_HZ,
+	"GZN_AUDIO_SAMPLE_RATE has to be one of the sample_rate values"
+);
 
 inline constexpr int8_t   BITS_PER_SAMPLE{ 16 };
 inline constexpr int8_t   BYTES_PER_SAMPLE{ BITS_PER_SAMPLE / 8 };
-inline constexpr auto     DUTY_RESOLUTION{ LEDC_TIMER_14_BIT };
+inline constexpr uint8_t  DUTY_RESOLUTION{ duty_resolution_for(SAMPLE_RATE) }; ///< bits, see ledc_timer_bit_t
 inline constexpr int16_t  VOLUME_0DB     { 16 };
-inline constexpr auto     SAMPLE_RATE    { sample_rate::SR_8000_HZ };
-inline constexpr auto     TIMER_ID       { LEDC_TIMER_0 };
 
 inline constexpr uint32_t SOUND_TASK_CORE_ID{ 0u };
 inline constexpr int32_t  SOUND_TASK_STACK_DEPTH { 2048 };
-inline constexpr int32_t  SOUND_TASK_PRIORITY    {    1 };
+inline constexpr int32_t  SOUND_TASK_PRIORITY    {    2 };
+
+inline constexpr uint32_t PREFETCH_TASK_CORE_ID    { 0u };
+inline constexpr int32_t  PREFETCH_TASK_STACK_DEPTH{ 3072 };
+inline constexpr int32_t  PREFETCH_TASK_PRIORITY   {    1 }; ///< below the mixer
+inline constexpr size_t   PREFETCH_BUFFERS         {    2 }; ///< per voice
+
+#if defined(GZN_AUDIO_MAX_VOICES)
+inline constexpr size_t   MAX_VOICES{ GZN_AUDIO_MAX_VOICES }; ///< voice pool capacity
+#else
+inline constexpr size_t   MAX_VOICES{ 4 };
+#endif // defined(GZN_AUDIO_MAX_VOICES)
+
+static_assert(MAX_VOICES >= 1 && MAX_VOICES <= 16, "GZN_AUDIO_MAX_VOICES has to be from 1 to 16");
 
 inline constexpr track_id INVALID_TRACK_ID { (std::numeric_limits<track_id>::max)() };
-inline constexpr size_t   MAX_SOUND_TRACKS{ 4 };
+inline constexpr size_t   MAX_SOUND_TRACKS{ MAX_VOICES }; ///< mixer width, an input per voice of the pool
+inline constexpr size_t   MUSIC_TRACK     { MAX_SOUND_TRACKS }; ///< mixer input of the music
+inline constexpr size_t   MIXER_INPUTS    { MAX_SOUND_TRACKS + 1 };
+inline constexpr size_t   TRACK_INDEX_BITS{ 8 };
+inline constexpr size_t   TRACK_INDEX_MASK{ (1u << TRACK_INDEX_BITS) - 1u };
 inline constexpr uint32_t SOUND_TRACKS_MASK{ []{
 	uint32_t value{};
 	for (uint32_t i{}; i < MAX_SOUND_TRACKS; ++i) {
@@ -43,16 +93,82 @@ inline constexpr uint32_t SOUND_TRACKS_MASK{ []{
 }() };
 
 
-inline constexpr size_t SAMPLE_BATCH_SIZE{ 512u };
+#if defined(GZN_AUDIO_STEREO)
+inline constexpr uint8_t OUTPUT_CHANNELS{ 2 }; ///< interleaved L/R frames
+#else
+inline constexpr uint8_t OUTPUT_CHANNELS{ 1 };
+#endif // defined(GZN_AUDIO_STEREO)
+inline constexpr uint8_t MAX_SOURCE_CHANNELS{ OUTPUT_CHANNELS }; ///< no downmix
+
+inline constexpr size_t SAMPLE_BATCH_SIZE{ batch_size_for(SAMPLE_RATE) }; ///< frames per mixed block
 
-using samples_array = std::array<int16_t, SAMPLE_BATCH_SIZE>;
+inline constexpr uint8_t  LOWEST_PRIORITY {   0 };
+inline constexpr uint8_t  DEFAULT_PRIORITY{ 128 };
+inline constexpr uint8_t  HIGHEST_PRIORITY{ 255 };
+inline constexpr uint8_t  FADE_OUT_SHIFT  { static_cast<uint8_t>(
+	std::bit_width(std::to_underlying(SAMPLE_RATE) / 125u) - 1
+) };
+inline constexpr uint16_t FADE_OUT_SAMPLES{ 1u << FADE_OUT_SHIFT }; ///< 6-8 ms at any rate
+
+inline constexpr int8_t   PAN_LEFT  { -16 };
+inline constexpr int8_t   PAN_CENTER{   0 };
+inline constexpr int8_t   PAN_RIGHT {  16 };
+
+/// Block of the widest frames, interleaved if stereo
+using samples_array = std::array<int16_t, SAMPLE_BATCH_SIZE * MAX_SOURCE_CHANNELS>;
+using output_array  = std::array<int16_t, SAMPLE_BATCH_SIZE * OUTPUT_CHANNELS>;
 
 struct track_info {
 	std::string_view filename{};
 	int8_t           volume : 7 { 16 }; ///< from -16 to 16
 	bool             loop   : 1 { false };
+	uint8_t          priority{ DEFAULT_PRIORITY }; ///< may steal voices with lower or equal one
+	int8_t           pan{ PAN_CENTER }; ///< from PAN_LEFT to PAN_RIGHT, stereo output only
+};
+
+using sound_event_id = uint8_t;
+
+inline constexpr size_t         MAX_SOUND_EVENTS   { 16 };
+inline constexpr sound_event_id INVALID_SOUND_EVENT{ 0xFF };
+
+/// Sound which gameplay may request every frame, see manager::trigger()
+struct sound_event_info {
+	track_info track{};           ///< the filename has to outlive the event
+	uint16_t   window_ms{ 50 };   ///< requests closer than that are coalesced
+	uint8_t    max_instances{ 1 }; ///< playing at once, up to MAX_VOICES
+	bool       retrigger{ true }; ///< rewind the oldest instance when capped, otherwise drop
+};
+
+using sfx_id = uint8_t;
+
+inline constexpr size_t MAX_SFX    { 16 };
+inline constexpr sfx_id INVALID_SFX{ 0xFF };
+
+struct music_info {
+	std::string_view filename{}; ///< ProTracker MOD module
+	int8_t           volume : 7 { 0 }; ///< from -16 to 16
+	bool             loop   : 1 { true };
+};
+
+struct setup_info {
+	uint8_t voices{ MAX_VOICES }; ///< voice pool size, clamped to [1; MAX_VOICES]
 };
 
+[[nodiscard]] [[gnu::always_inline]]
+constexpr inline auto make_track_id(const size_t index, const uint16_t generation) -> track_id {
+	return (static_cast<track_id>(generation) << TRACK_INDEX_BITS) | index;
+}
+
+[[nodiscard]] [[gnu::always_inline]]
+constexpr inline auto track_index(const track_id id) -> size_t {
+	return id & TRACK_INDEX_MASK;
+}
+
+[[nodiscard]] [[gnu::always_inline]]
+constexpr inline auto track_generation(const track_id id) -> uint16_t {
+	return static_cast<uint16_t>(id >> TRACK_INDEX_BITS);
+}
+
 enum class startup_result : uint8_t {
 	ok,
 	already_started,
@@ -1,12 +1,14 @@
 #pragma once
 
+#include "gzn/audio/synth.hpp"
 #include "gzn/audio/context.hpp"
+#include "gzn/audio/telemetry.hpp"
 
 namespace gzn::audio {
 
 class manager {
 public:
-	struct setup_info{};
+	using setup_info = audio::setup_info;
 
 	[[nodiscard]]
 	static auto initialize(const setup_info &info = {}) -> startup_result;
@@ -14,10 +16,68 @@ public:
 
 	static void update();
 
+	/// Starts at the next mixed block, see output_latency_us()
 	static auto play(const track_info &info) -> track_id;
+
+	/**
+	 * @brief Starts the sound at the exact sample, which reaches the speaker
+	 * at @p timestamp_us (esp_timer_get_time() clock)
+	 * The voice is taken right away and stays busy till then. Timestamps in
+	 * the past play as soon as possible, the ones too far ahead are clamped
+	 * to 10 seconds.
+	 */
+	static auto play_at(const track_info &info, const int64_t timestamp_us) -> track_id;
+
+	/// Estimated time from play() to the speaker, the current block included
+	[[nodiscard]]
+	static auto output_latency_us() -> uint32_t;
 	static auto stop(const track_id track) -> bool;
 	static auto stop_all() -> size_t;
 
+	/// @returns INVALID_SOUND_EVENT if there are MAX_SOUND_EVENTS already
+	static auto register_event(const sound_event_info &info) -> sound_event_id;
+
+	/**
+	 * @brief Plays the event sound, cheap enough for every frame
+	 * Requests within the window are coalesced, instances over the cap rewind
+	 * the oldest one, and the file header is parsed only once.
+	 * @returns the track which plays the request
+	 */
+	static auto trigger(const sound_event_id event) -> track_id;
+
+	/**
+	 * @brief Synthesises the effect into RAM, so playing it costs no I/O
+	 * @param lazy postpones rendering till the first play_sfx()
+	 * @returns INVALID_SFX if there are MAX_SFX already or no memory
+	 */
+	static auto load_sfx(const sfx_params &params, const bool lazy = false) -> sfx_id;
+
+	/// Plays the effect like a file, the filename of @p info isn't used
+	static auto play_sfx(const sfx_id id, const track_info &info = {}) -> track_id;
+
+	/// Loads the whole module into RAM and plays it in the MUSIC_TRACK
+	static auto play_music(const music_info &info) -> bool;
+	static void stop_music();
+	[[nodiscard]]
+	static auto is_music_playing() -> bool;
+
+	/// Whether any voice reads its file from the flash, samples in RAM don't count
+	[[nodiscard]]
+	static auto is_streaming() -> bool;
+
+	/// Mixed blocks which found no prefetched data of a playing voice
+	[[nodiscard]]
+	static auto prefetch_underruns() -> uint32_t;
+
+	/// Snapshot of the pipeline counters to size buffers and rates from data
+	[[nodiscard]]
+	static auto query_telemetry() -> telemetry;
+	static void reset_telemetry();
+
+	/// Audio CPU load since the last telemetry reset
+	[[nodiscard]]
+	static auto query_cpu_usage() -> cpu_usage;
+
 	[[nodiscard]]
 	static inline auto is_playing(const track_id id) -> bool;
 };
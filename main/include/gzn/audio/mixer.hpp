@@ -0,0 +1,51 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <cstdint>
+
+#include "gzn/audio/voice.hpp"
+#include "gzn/audio/tracker.hpp"
+
+namespace gzn::audio {
+
+inline constexpr uint8_t MIX_GAIN_SHIFT{ 12 };
+
+/**
+ * @brief Platform-independent part of the sound streaming task
+ * Voices hand over their prefetched batches one by one (without locking, see
+ * voice_state::consume()) and then they are mixed into a single block. The music is
+ * synthesised into its own MUSIC_TRACK input.
+ */
+struct mixer {
+	using accumulator_array = std::array<int32_t, SAMPLE_BATCH_SIZE * OUTPUT_CHANNELS>;
+
+	std::array<samples_array, MIXER_INPUTS> batches{};
+	std::array<size_t,        MIXER_INPUTS> batches_sizes{}; ///< in samples, not frames
+	std::array<int8_t,        MIXER_INPUTS> volumes{};
+	std::array<int8_t,        MIXER_INPUTS> pans{};
+	std::array<uint8_t,       MIXER_INPUTS> channels{};
+	accumulator_array                       accumulator{};
+
+	[[gnu::always_inline]]
+	inline void skip(const size_t index) {
+		batches_sizes[index] = 0;
+	}
+
+	/// @param frame output timeline position of the block being mixed
+	auto fetch(const size_t index, voice_state &voice, const uint32_t frame) -> size_t;
+	auto fetch_music(tracker &music, const int8_t volume) -> size_t;
+
+	/**
+	 * @brief Mixes fetched batches into @p out
+	 * Every voice is scaled by its volume and divided by the number of active
+	 * voices, so the sum never clips. Stereo output pans mono voices and
+	 * passes stereo ones through, both with the balance of their pan.
+	 * Shorter batches are padded with silence, so the output timeline always
+	 * advances by whole blocks and scheduled voices stay sample-accurate.
+	 * @returns SAMPLE_BATCH_SIZE, or 0 if nothing is playing
+	 */
+	auto mix(std::span<int16_t, SAMPLE_BATCH_SIZE * OUTPUT_CHANNELS> out) -> size_t;
+};
+
+} // namespace gzn::audio
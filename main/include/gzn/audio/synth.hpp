@@ -0,0 +1,103 @@
+#pragma once
+
+#include <span>
+#include <cstdint>
+#include <utility>
+
+#include "gzn/audio/context.hpp"
+
+namespace gzn::audio {
+
+enum class wave_shape : uint8_t {
+	square,
+	sawtooth,
+	triangle,
+	sine,
+	noise,
+};
+
+/**
+ * @brief sfxr-like description of a sound effect
+ * All the math is integer, so the same parameters render the same samples
+ * on the device and on the host. Time-based parameters are applied once per
+ * millisecond, so effects sound the same at any sample rate.
+ */
+struct sfx_params {
+	wave_shape shape{ wave_shape::square };
+	uint8_t    duty{ 128 };           ///< square wave duty, of 256
+	int8_t     duty_sweep{};          ///< duty change per ms, of 65536
+	uint8_t    volume{ 255 };         ///< of 256
+	uint16_t   frequency{ 440 };      ///< Hz at the start
+	uint16_t   min_frequency{ 20 };   ///< the slide down ends the sound there
+	int16_t    slide{};               ///< frequency change per ms, of 65536 of it
+	int8_t     delta_slide{};         ///< slide change per ms, of 256 of its unit
+	uint8_t    vibrato_depth{};       ///< of 256 of the frequency
+	uint8_t    vibrato_speed{};       ///< Hz
+	uint8_t    punch{};               ///< sustain boost fading till its end, of 256
+	uint16_t   arpeggio{ 256 };       ///< Q8 frequency multiplier at arpeggio_ms
+	uint16_t   arpeggio_ms{};         ///< 0 - no arpeggio
+	uint16_t   attack_ms{};
+	uint16_t   sustain_ms{ 100 };
+	uint16_t   decay_ms{ 100 };
+};
+
+/// Samples needed for the whole effect, the slide may end it earlier
+[[nodiscard]]
+auto sfx_length(
+	const sfx_params &params,
+	const uint32_t rate = std::to_underlying(SAMPLE_RATE)
+) -> size_t;
+
+/**
+ * @brief Renders the mono effect
+ * @param seed of the noise, the same seed renders the same noise
+ * @returns count of rendered samples, at most the size of @p out
+ */
+auto render_sfx(
+	const sfx_params &params,
+	std::span<int16_t> out,
+	const uint32_t rate = std::to_underlying(SAMPLE_RATE),
+	const uint32_t seed = 1
+) -> size_t;
+
+namespace sfx_presets {
+
+inline constexpr sfx_params LASER{
+	.shape{ wave_shape::square }, .duty{ 64 }, .duty_sweep{ 24 },
+	.frequency{ 1400 }, .min_frequency{ 120 }, .slide{ -500 }, .delta_slide{ 64 },
+	.sustain_ms{ 60 }, .decay_ms{ 140 },
+};
+
+inline constexpr sfx_params PICKUP{
+	.shape{ wave_shape::square },
+	.frequency{ 988 }, .punch{ 120 }, .arpeggio{ 341 }, .arpeggio_ms{ 60 },
+	.sustain_ms{ 50 }, .decay_ms{ 180 },
+};
+
+inline constexpr sfx_params JUMP{
+	.shape{ wave_shape::square }, .duty{ 96 },
+	.frequency{ 300 }, .slide{ 180 },
+	.sustain_ms{ 120 }, .decay_ms{ 120 },
+};
+
+inline constexpr sfx_params EXPLOSION{
+	.shape{ wave_shape::noise },
+	.frequency{ 2400 }, .slide{ -90 }, .punch{ 200 },
+	.sustain_ms{ 120 }, .decay_ms{ 420 },
+};
+
+inline constexpr sfx_params HIT{
+	.shape{ wave_shape::sawtooth },
+	.frequency{ 700 }, .min_frequency{ 60 }, .slide{ -400 },
+	.sustain_ms{ 20 }, .decay_ms{ 120 },
+};
+
+inline constexpr sfx_params BLIP{
+	.shape{ wave_shape::sine },
+	.frequency{ 1320 },
+	.sustain_ms{ 40 }, .decay_ms{ 40 },
+};
+
+} // namespace sfx_presets
+
+} // namespace gzn::audio
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <bit>
+#include <span>
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+#include "gzn/audio/context.hpp"
+
+namespace gzn::audio {
+
+inline constexpr size_t   HISTOGRAM_BINS     { 16 };
+inline constexpr size_t   UNDERRUN_HISTORY   {  8 };
+inline constexpr uint32_t ISR_SAMPLING_PERIOD{ 61 }; ///< ISR calls per CCOUNT sample, coprime
+                                                     ///< with blocks to sample all their phases
+
+/**
+ * @brief Power of two histogram
+ * bins[0] counts zeros, bins[i] counts values in [2^(i-1), 2^i), the last
+ * bin takes everything above.
+ */
+struct histogram {
+	std::array<uint32_t, HISTOGRAM_BINS> bins{};
+	uint64_t                             sum{};
+	uint32_t                             count{};
+	uint32_t                             max{};
+
+	[[gnu::always_inline]]
+	inline void add(const uint32_t value) {
+		++bins[std::min<size_t>(std::bit_width(value), HISTOGRAM_BINS - 1)];
+		sum  += value;
+		++count;
+		max   = std::max(max, value);
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto average() const -> uint32_t {
+		return count != 0 ? static_cast<uint32_t>(sum / count) : 0;
+	}
+};
+
+/// Written by the ISR and the streaming task, read by anyone. May be torn
+struct backend_telemetry {
+	histogram                                 isr_cycles{};       ///< CCOUNT per sampled ISR call
+	std::array<int64_t, UNDERRUN_HISTORY>     underrun_times{};   ///< µs since boot, the last ones
+	uint32_t                                  underruns{};        ///< ISR starved while the mixer was busy
+	uint32_t                                  ring_size{};        ///< bytes
+	uint32_t                                  ring_high{};        ///< max bytes queued after a send
+	uint32_t                                  ring_low{ UINT32_MAX }; ///< min bytes queued before a send
+
+	[[gnu::always_inline]]
+	inline void add_underrun(const int64_t timestamp) {
+		underrun_times[underruns % UNDERRUN_HISTORY] = timestamp;
+		++underruns;
+	}
+};
+
+struct telemetry {
+	backend_telemetry                         backend{};
+	histogram                                 mix_time_us{};      ///< fetch & mix of a single block
+	std::array<uint32_t, MIXER_INPUTS + 1>    active_inputs{};    ///< blocks by the count of mixed inputs
+	std::array<uint32_t, MIXER_INPUTS>        input_blocks{};     ///< blocks each voice (and music) took part in
+	int64_t                                   since_us{};         ///< the last reset
+	uint32_t                                  events_coalesced{};
+	uint32_t                                  events_retriggered{};
+	uint32_t                                  events_dropped{};   ///< capped without retrigger
+	uint32_t                                  prefetch_underruns{};
+	uint32_t                                  mixed_blocks{};
+
+	/// @param sizes batch sizes of the mixer inputs of the block
+	inline void add_block(const std::span<const size_t, MIXER_INPUTS> sizes, const uint32_t mix_time) {
+		size_t active{};
+		for (size_t i{}; i < MIXER_INPUTS; ++i) {
+			if (sizes[i] != 0) {
+				++input_blocks[i];
+				++active;
+			}
+		}
+		++active_inputs[active];
+		mix_time_us.add(mix_time);
+		++mixed_blocks;
+	}
+};
+
+/// Share of a single core, in 0.1% units
+struct cpu_usage {
+	uint32_t sample_rate{};
+	uint16_t isr_permille{};   ///< ISR body only, without the interrupt dispatch
+	uint16_t mixer_permille{}; ///< fetch & mix, without waiting for the ring
+};
+
+} // namespace gzn::audio
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include "gzn/audio/context.hpp"
+
+namespace gzn::audio {
+
+inline constexpr size_t  TRACKER_CHANNELS   {   4 };
+inline constexpr size_t  TRACKER_INSTRUMENTS{  31 };
+inline constexpr size_t  TRACKER_ORDERS     { 128 };
+inline constexpr size_t  TRACKER_ROWS       {  64 };
+inline constexpr uint8_t TRACKER_MAX_VOLUME {  64 };
+
+enum class tracker_error : uint8_t {
+	ok,
+	too_small,
+	unsupported_format,
+	corrupted,
+};
+
+/**
+ * @brief ProTracker MOD (4 channels) player
+ * Synthesises music from the module kept in RAM, so the only I/O is the
+ * initial load. Doesn't own the module memory.
+ *
+ * Supported effects: 0 arpeggio, 1/2 portamento, 3 tone portamento,
+ * 9 sample offset, A volume slide, B position jump, C set volume,
+ * D pattern break, F speed/tempo, E1/E2 fine portamento,
+ * EA/EB fine volume slide, EC note cut. Others are ignored.
+ */
+class tracker {
+public:
+	[[nodiscard]]
+	auto load(
+		const std::span<const uint8_t> module,
+		const uint32_t output_rate = std::to_underlying(SAMPLE_RATE)
+	) -> tracker_error;
+	void unload();
+	void restart();
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto is_playing() const -> bool { return playing; }
+
+	/**
+	 * @brief Renders the next samples of the song
+	 * @returns count of rendered samples. Less than the size of @p out means
+	 * the song is over (never happens for looping songs)
+	 */
+	auto render(std::span<int16_t> out) -> size_t;
+
+	bool loop{ true };
+
+private:
+	struct instrument {
+		const int8_t *data{};
+		uint32_t      length{};      ///< in samples
+		uint32_t      loop_start{};
+		uint32_t      loop_length{}; ///< 0 - doesn't loop
+		uint8_t       finetune{};    ///< raw nibble, 8..15 are -8..-1
+		uint8_t       volume{};
+	};
+
+	struct channel {
+		const instrument *sample{};   ///< currently playing
+		const instrument *selected{}; ///< the last one from the pattern
+		uint32_t position{};      ///< integer part of the sample cursor
+		uint32_t step{};          ///< Q16 cursor increment per output sample
+		uint16_t fraction{};      ///< fractional part of the sample cursor
+		uint16_t period{};
+		uint16_t porta_target{};
+		uint8_t  porta_speed{};
+		uint8_t  effect{};
+		uint8_t  param{};
+		uint8_t  volume{};
+		uint8_t  offset{};        ///< last 9xx param
+		bool     active{ false };
+	};
+
+	void process_row();
+	void process_tick();
+	void advance_row();
+	void update_step(channel &ch, const uint16_t period);
+
+	std::span<const uint8_t>                     song{};
+	std::array<instrument, TRACKER_INSTRUMENTS>  instruments{};
+	std::array<channel,    TRACKER_CHANNELS>     channels{};
+	const uint8_t                               *orders{};
+	const uint8_t                               *patterns{};
+	uint32_t                                     output_rate{};
+	uint32_t                                     tick_samples_left{};
+	uint8_t                                      song_length{};
+	uint8_t                                      restart_position{};
+	uint8_t                                      order{};
+	uint8_t                                      row{};
+	uint8_t                                      tick{};
+	uint8_t                                      speed{ 6 };
+	uint8_t                                      tempo{ 125 };
+	int16_t                                      jump_order{ -1 };
+	int16_t                                      break_row{ -1 };
+	bool                                         playing{ false };
+};
+
+} // namespace gzn::audio
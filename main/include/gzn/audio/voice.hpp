@@ -0,0 +1,203 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <utility>
+
+#include "gzn/audio/context.hpp"
+#include "gzn/audio/wav-format.hpp"
+
+namespace gzn::audio {
+
+inline constexpr size_t NO_VOICE{ MAX_SOUND_TRACKS };
+
+static_assert(PREFETCH_BUFFERS >= 2, "At least double buffering is required");
+
+enum class open_result : uint8_t {
+	ok,
+	cannot_open,
+	too_small,
+	corrupted,
+	unsupported_format,
+};
+
+/// Either a WAV file or samples in RAM, which the stream doesn't own
+struct stream_info {
+	std::FILE     *file_descr{ nullptr };
+	const int16_t *memory{ nullptr };
+	size_t         data_offset{};   ///< of the data chunk in the file
+	size_t         samples_total{}; ///< samples in one pass of the data
+	size_t         samples_left{};  ///< samples till the end of the current pass
+	uint8_t        priority{};
+	int8_t         volume{};
+	int8_t         pan{};
+	uint32_t       start_frame{};   ///< on the output timeline, if scheduled
+	uint16_t       lead_frames{};   ///< silence before the first sample, prefetched once
+	uint8_t        channels{ 1 };
+	bool           loop{ false };
+	bool           scheduled{ false };
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto is_open() const -> bool {
+		return file_descr != nullptr || memory != nullptr;
+	}
+
+	/// Starts the stream at @p frame of the output timeline instead of the next block
+	[[gnu::always_inline]]
+	inline void schedule(const uint32_t frame) {
+		start_frame = frame;
+		lead_frames = static_cast<uint16_t>(frame % SAMPLE_BATCH_SIZE);
+		scheduled   = true;
+	}
+
+	[[gnu::always_inline]]
+	inline void close() {
+		if (file_descr) {
+			std::fclose(std::exchange(file_descr, nullptr));
+		}
+		*this = {};
+	}
+
+	/// Goes back to the first sample
+	auto rewind() -> bool;
+
+	/// Reads up to the end of the pass, 0 is an error or the end of the file
+	auto read(std::span<int16_t> samples) -> size_t;
+};
+
+/**
+ * @brief Single producer, single consumer queue of prefetched batches
+ * Every batch is tagged with the serial of the stream it was read from, so
+ * the consumer skips batches of streams which were replaced meanwhile.
+ */
+struct prefetch_ring {
+	std::array<samples_array, PREFETCH_BUFFERS> buffers{};
+	std::array<uint16_t,      PREFETCH_BUFFERS> sizes{};
+	std::array<uint16_t,      PREFETCH_BUFFERS> serials{};
+	std::atomic<uint32_t>                       head{}; ///< advanced by the consumer only
+	std::atomic<uint32_t>                       tail{}; ///< advanced by the producer only
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto full() const -> bool {
+		return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire)
+			>= PREFETCH_BUFFERS;
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto empty() const -> bool {
+		return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto back() -> samples_array & {
+		return buffers[tail.load(std::memory_order_relaxed) % PREFETCH_BUFFERS];
+	}
+
+	[[gnu::always_inline]]
+	inline void push(const size_t size, const uint16_t serial) {
+		const auto index{ tail.load(std::memory_order_relaxed) };
+		sizes  [index % PREFETCH_BUFFERS] = static_cast<uint16_t>(size);
+		serials[index % PREFETCH_BUFFERS] = serial;
+		tail.store(index + 1, std::memory_order_release);
+	}
+
+	/// Copies the front batch of the @p serial stream into @p batch
+	auto pop(const uint16_t serial, std::span<int16_t> batch) -> size_t;
+};
+
+/**
+ * @brief Platform-independent state of the single mixer voice
+ * Doesn't lock anything. The owner has to guard everything except
+ * consume(), which is lock-free against prefetch().
+ */
+struct voice_state {
+	stream_info       current{};
+	stream_info       pending{};    ///< replaces current once fade-out is over
+	prefetch_ring     ring{};
+	std::atomic<bool> steal_requested{ false };
+	uint32_t          started_at{}; ///< mixed blocks counter at the start
+	uint32_t          underruns{};  ///< consume() found no prefetched data
+	uint16_t          generation{};
+	uint16_t          serial{};     ///< changes each time current stream is replaced
+	uint16_t          fade_left{};  ///< fade-out samples left, owned by consume()
+	uint16_t          fade_serial{};  ///< serial of the stream being faded out
+	uint32_t          start_frame{};  ///< of the serial stream, if scheduled
+	int8_t            volume{};       ///< mix parameters of the serial stream,
+	int8_t            pan{};          ///< they outlive its file for the ring tail
+	uint8_t           channels{ 1 };
+	bool              muted{ false }; ///< faded out, waiting for swap()
+	bool              primed{ false }; ///< the serial stream was heard, so an empty ring is an underrun
+	bool              scheduled{ false }; ///< holds the batches till the block of start_frame
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto busy() const -> bool {
+		return current.is_open() || pending.is_open() || !ring.empty();
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto audible() const -> const stream_info & {
+		return pending.is_open() ? pending : current;
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto swap_due() const -> bool {
+		return muted;
+	}
+
+	void close();
+
+	/// Starts @p stream right away or after fade-out of the current sound
+	void start(stream_info &&stream, const uint32_t now);
+
+	/// Replaces faded out current sound with the pending one
+	void swap();
+
+	/// Rewinds the current stream instead of opening it again
+	auto restart(const uint32_t now) -> bool;
+
+	/// Reads the next batch into the ring, handles loops and EOF (reader side)
+	auto prefetch() -> bool;
+
+	/**
+	 * @brief Takes the next prefetched batch and applies fade-out (mixer side)
+	 * @param frame output timeline position of the block being mixed
+	 */
+	auto consume(std::span<int16_t> batch, const uint32_t frame) -> size_t;
+};
+
+[[nodiscard]]
+auto open_stream(const track_info &info, stream_info &stream) -> open_result;
+
+/**
+ * @brief Opens the stream without parsing the file again
+ * @param layout of the file. Parsed and filled in if it's empty, so the
+ * caller could keep it for the next time
+ */
+[[nodiscard]]
+auto open_stream(const track_info &info, stream_info &stream, wav::layout &layout) -> open_result;
+
+/// Streams mono @p samples from RAM, the filename of @p info isn't used
+[[nodiscard]]
+auto open_stream(
+	const std::span<const int16_t> samples,
+	const track_info &info,
+	stream_info &stream
+) -> open_result;
+
+/**
+ * @brief Picks a free voice or the cheapest one to steal
+ * Victims are ordered by priority, then loudness, then samples left and then
+ * by age. Voices with higher priority than @p priority are never stolen.
+ * @returns voice index or NO_VOICE
+ */
+[[nodiscard]]
+auto select_voice(
+	const std::span<const voice_state> voices,
+	const uint32_t booked_bitset,
+	const uint8_t priority
+) -> size_t;
+
+} // namespace gzn::audio
@@ -1,10 +1,10 @@
 #pragma once
 
 #include <span>
+#include <cstdio>
 #include <cstdint>
 
 #if defined(GZN_DEBUG)
-#include <cstdio>
 #include <utility>
 #endif // defined(GZN_DEBUG)
 
@@ -87,5 +87,51 @@ struct header {
 #endif // defined(GZN_DEBUG)
 };
 
+enum class parse_result : uint8_t {
+	ok,
+	too_small,
+	not_riff,
+	no_format,
+	no_data,
+	corrupted,
+};
+
+/**
+ * @brief Everything the streaming needs to know about the WAV file
+ * Found by walking the RIFF chunks, so `LIST`, `fact` and other chunks are
+ * allowed anywhere in the file.
+ */
+struct layout {
+	format_t format{};
+	uint16_t channels{};
+	uint32_t sample_rate{};
+	uint16_t block_align{};
+	uint16_t bits_per_sample{};
+	uint32_t data_offset{}; ///< from the beginning of the file
+	uint32_t data_size{};   ///< in bytes, whole sample frames only
+
+#if defined(GZN_DEBUG)
+	void dump() const {
+		std::printf("----------- WAV INFO -----------\n");
+		std::printf("  format.........: 0x%04x\n", std::to_underlying(format));
+		std::printf("  channels.......: %u\n",     channels);
+		std::printf("  sample_rate....: %lu\n",    sample_rate);
+		std::printf("  block_align....: %u\n",     block_align);
+		std::printf("  bits_per_sample: %u\n",     bits_per_sample);
+		std::printf("  data_offset....: %lu\n",    data_offset);
+		std::printf("  data_size......: %lu\n",    data_size);
+		std::printf("--------------------------------\n");
+	}
+#endif // defined(GZN_DEBUG)
+};
+
+/// Parses the WAV file which is already in memory (cached or mapped)
+[[nodiscard]]
+auto parse(const std::span<const uint8_t> file, layout &out) -> parse_result;
+
+/// Parses the opened WAV file. Doesn't restore the file position
+[[nodiscard]]
+auto parse(std::FILE *file, layout &out) -> parse_result;
+
 } // namespace gzn::audio::wav
 
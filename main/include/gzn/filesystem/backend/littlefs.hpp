@@ -0,0 +1,36 @@
+#pragma once
+
+#include "gzn/filesystem/backend/vfs.hpp"
+
+namespace gzn::fs::backend {
+
+/**
+ * @brief LittleFS partitions through the IDF VFS (joltwing/littlefs)
+ * Directories, opens which don't scan the partition and copy-on-write
+ * metadata, so there's no garbage to collect. mount_info::max_simultanious_opened_files
+ * isn't limited by it.
+ */
+struct littlefs {
+	static auto mount(const mount_info &info) -> mount_error;
+	static void unmount(const std::string_view label);
+	static auto format(const std::string_view label) -> bool;
+	static auto usage(const std::string_view label, size_t &total, size_t &used) -> bool;
+};
+
+inline constexpr driver littlefs_driver{
+	.name{ "littlefs" },
+	.mount{ &littlefs::mount },
+	.unmount{ &littlefs::unmount },
+	.format{ &littlefs::format },
+	.usage{ &littlefs::usage },
+	.open{ &vfs::open },
+	.seek{ &vfs::seek },
+	.read{ &vfs::read },
+	.size{ &vfs::size },
+	.create{ &vfs::create },
+	.remove{ &vfs::remove },
+	.map{ &vfs::map },
+	.unmap{ &vfs::unmap },
+};
+
+} // namespace gzn::fs::backend
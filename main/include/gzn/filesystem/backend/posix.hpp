@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+
+#include "gzn/filesystem/driver.hpp"
+
+namespace gzn::fs::backend {
+
+struct posix_config {
+	std::string_view root{ "." };      ///< null-terminated
+	uint32_t         open_latency_us{};
+	uint32_t         seek_latency_us{};
+	uint32_t         read_latency_us{}; ///< a call, on top of the throughput
+	uint32_t         bytes_per_second{}; ///< 0 is unlimited
+};
+
+/// Roughly SPIFFS on the 80 MHz QIO flash of the S3 with a 1 MB partition
+inline constexpr posix_config spiffs_timings{
+	.open_latency_us { 1500 },
+	.seek_latency_us {  150 },
+	.read_latency_us {   40 },
+	.bytes_per_second{ 1'500'000 },
+};
+
+/**
+ * @brief Host directories as partitions, for tools/fs-host
+ * A partition is the <root>/<label> folder and the pack is the <root>/<label>.bin
+ * file, so `/assets/x.bin` is read from `<root>/assets/x.bin`. The optional
+ * delays make the host reads as slow as the flash, so loaders and caches
+ * measured on the host behave as on the device. Writes aren't slowed down.
+ */
+struct posix {
+	using config = posix_config;
+
+	/// Before mounting, the config outlives the mounts
+	static void configure(const config &info);
+
+	static auto mount(const mount_info &info) -> mount_error;
+	static void unmount(const std::string_view label);
+
+	static auto open(const std::string_view file) -> std::FILE *;
+	static auto seek(std::FILE *file, const size_t offset) -> bool;
+	static auto read(std::FILE *file, const std::span<uint8_t> out) -> size_t;
+	static auto size(const std::string_view file) -> size_t;
+	static auto create(const std::string_view file) -> std::FILE *;
+	static auto remove(const std::string_view file) -> bool;
+
+	static auto map(const std::string_view label, mapping &out) -> mount_error;
+	static void unmap(const mapping &mapped);
+};
+
+/// There's nothing to format or collect on the host
+inline constexpr driver posix_driver{
+	.name{ "posix" },
+	.mount{ &posix::mount },
+	.unmount{ &posix::unmount },
+	.open{ &posix::open },
+	.seek{ &posix::seek },
+	.read{ &posix::read },
+	.size{ &posix::size },
+	.create{ &posix::create },
+	.remove{ &posix::remove },
+	.map{ &posix::map },
+	.unmap{ &posix::unmap },
+};
+
+} // namespace gzn::fs::backend
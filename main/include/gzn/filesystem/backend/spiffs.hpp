@@ -0,0 +1,33 @@
+#pragma once
+
+#include "gzn/filesystem/backend/vfs.hpp"
+
+namespace gzn::fs::backend {
+
+/// SPIFFS partitions through the IDF VFS: flat, opens scan the whole partition
+struct spiffs {
+	static auto mount(const mount_info &info) -> mount_error;
+	static void unmount(const std::string_view label);
+	static auto format(const std::string_view label) -> bool;
+	static auto usage(const std::string_view label, size_t &total, size_t &used) -> bool;
+	static auto collect(const std::string_view label, const size_t bytes) -> bool;
+};
+
+inline constexpr driver spiffs_driver{
+	.name{ "spiffs" },
+	.mount{ &spiffs::mount },
+	.unmount{ &spiffs::unmount },
+	.format{ &spiffs::format },
+	.usage{ &spiffs::usage },
+	.collect{ &spiffs::collect },
+	.open{ &vfs::open },
+	.seek{ &vfs::seek },
+	.read{ &vfs::read },
+	.size{ &vfs::size },
+	.create{ &vfs::create },
+	.remove{ &vfs::remove },
+	.map{ &vfs::map },
+	.unmap{ &vfs::unmap },
+};
+
+} // namespace gzn::fs::backend
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "gzn/filesystem/driver.hpp"
+
+namespace gzn::fs::backend {
+
+/// Files of the partitions registered in the IDF VFS and the raw pack partition
+struct vfs {
+	static auto open(const std::string_view file) -> std::FILE *;
+	static auto seek(std::FILE *file, const size_t offset) -> bool;
+	static auto read(std::FILE *file, const std::span<uint8_t> out) -> size_t;
+	static auto size(const std::string_view file) -> size_t;
+	static auto create(const std::string_view file) -> std::FILE *;
+	static auto remove(const std::string_view file) -> bool;
+
+	static auto map(const std::string_view label, mapping &out) -> mount_error;
+	static void unmap(const mapping &mapped);
+};
+
+} // namespace gzn::fs::backend
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace gzn::fs {
+
+inline constexpr size_t max_benchmark_files{ 64 };
+
+struct benchmark_config {
+	uint16_t files      {        16 }; ///< small ones for the opens, up to max_benchmark_files
+	uint16_t file_size  {       256 };
+	uint32_t stream_size{ 64 * 1024 }; ///< of the file read sequentially and randomly
+	uint16_t chunk_size {      4096 };
+	uint16_t seeks      {        64 };
+	uint16_t seek_read  {        64 }; ///< bytes read after every seek
+	uint16_t writes     {        32 };
+	uint16_t write_size {        64 }; ///< a save game record or so
+};
+
+/// Times are averages in microseconds
+struct benchmark_result {
+	uint32_t create_us{};          ///< create, write file_size bytes, close
+	uint32_t open_us{};            ///< manager::open() of a small file, uncached, and close
+	uint32_t read_bytes_per_second{};
+	uint32_t write_bytes_per_second{};
+	uint32_t seek_us{};            ///< seek to a random offset and read seek_read bytes
+	uint32_t write_us{};           ///< write write_size bytes, flush and sync
+	uint32_t write_max_us{};       ///< the worst one, e.g. when SPIFFS collects meanwhile
+};
+
+/**
+ * @brief Measures the backend of a mounted partition the way the game uses it
+ * Creates its own `bench-*` files on the partition and removes them after, so
+ * the partition needs stream_size plus files * file_size bytes free. Run it
+ * on the device and in tools/fs-host to compare backends by numbers.
+ */
+class benchmark {
+public:
+	/// @param base_path the mount_info::base_path, e.g. "/assets"
+	[[nodiscard]]
+	static auto run(const std::string_view base_path, benchmark_result &result, const benchmark_config &config = {}) -> bool;
+};
+
+} // namespace gzn::fs
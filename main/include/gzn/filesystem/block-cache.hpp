@@ -0,0 +1,157 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+
+#include "gzn/filesystem/pack-format.hpp"
+
+namespace gzn::fs {
+
+inline constexpr size_t max_cache_blocks{ 256 };
+
+struct cache_stats {
+	uint32_t hits{};
+	uint32_t misses{};
+	uint32_t evictions{};
+};
+
+inline constexpr uint64_t FNV64_OFFSET_BASIS{ 14'695'981'039'346'656'037u };
+inline constexpr uint64_t FNV64_PRIME       {      1'099'511'628'211u };
+
+/**
+ * @brief Which file cached blocks belong to
+ * The paths aren't stored, so the 32-bit FNV-1a hash of the pack index, the
+ * 64-bit FNV-1a hash and the length of the path have to match. Taking another
+ * file's blocks is then very unlikely, though not impossible.
+ */
+struct file_key {
+	pack::hash_t hash{};
+	uint64_t     check{};
+	uint32_t     length{};
+	uint32_t     size{};   ///< of the file when it was opened, a rewrite to another size misses
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto same_path(const file_key &other) const -> bool {
+		return hash == other.hash && check == other.check && length == other.length;
+	}
+
+	[[nodiscard]]
+	static constexpr auto of(const std::string_view path) -> file_key {
+		uint64_t check_{ FNV64_OFFSET_BASIS };
+		for (const auto c : path) {
+			check_ = (check_ ^ static_cast<uint8_t>(c)) * FNV64_PRIME;
+		}
+		return { .hash = pack::hash(path), .check = check_, .length = static_cast<uint32_t>(std::size(path)) };
+	}
+
+	[[nodiscard]] constexpr bool operator==(const file_key &other) const = default;
+};
+
+/**
+ * @brief Fixed-size read cache of file blocks with CLOCK eviction
+ * Blocks are keyed by the file (see file_key) and the block index. Doesn't
+ * own the memory and doesn't lock anything, the owner has to.
+ */
+class block_cache {
+public:
+	struct config {
+		uint32_t block_size { 1024 }; ///< rounded down to a power of two
+		uint16_t block_count{ 32 };   ///< up to max_cache_blocks, 0 disables the cache
+	};
+
+	/// Takes @p memory for as many blocks as fit, forgets everything cached
+	void assign(const std::span<uint8_t> memory, const uint32_t block_size);
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto enabled() const -> bool { return count != 0; }
+
+	/**
+	 * @brief Copies @p out from the cached blocks, fetching the missing ones
+	 * @param fill `(block, span) -> size_t` reads the block into the span,
+	 * returns less at the end of the file and SIZE_MAX on errors (not cached)
+	 * @returns bytes copied, less than requested at the end of the file
+	 */
+	template<class Reader>
+	auto read(const file_key &key, const size_t offset, std::span<uint8_t> out, Reader &&fill) -> size_t {
+		size_t copied{};
+		while (copied < std::size(out)) {
+			const auto position{ offset + copied };
+			const auto block   { static_cast<uint32_t>(position >> shift) };
+			const auto within  { position & (block_size - 1) };
+
+			auto index{ find(key, block) };
+			if (index == count) {
+				++statistics.misses;
+				index = victim();
+				const auto size{ fill(block, data(index)) };
+				if (size == SIZE_MAX) [[unlikely]] {
+					break;
+				}
+				entries[index] = { .key{ key }, .block{ block }, .size{ static_cast<uint32_t>(size) }, .valid{ true } };
+			} else {
+				++statistics.hits;
+			}
+
+			auto &item{ entries[index] };
+			item.referenced = true;
+			if (within >= item.size) {
+				break; // the end of the file
+			}
+			const auto length{ std::min<size_t>(item.size - within, std::size(out) - copied) };
+			std::memcpy(std::data(out) + copied, std::data(data(index)) + within, length);
+			copied += length;
+		}
+		return copied;
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto contains(const file_key &key, const uint32_t block) const -> bool {
+		return find(key, block) != count;
+	}
+
+	/// Forgets the blocks of the file whatever its size, e.g. after it was written
+	void invalidate(const file_key &key);
+	void clear();
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto stats() const -> cache_stats { return statistics; }
+
+	[[gnu::always_inline]]
+	inline void reset_stats() { statistics = {}; }
+
+private:
+	struct entry {
+		file_key key{};
+		uint32_t block{};
+		uint32_t size{};  ///< valid bytes, less than block_size for the last block
+		bool     valid{ false };
+		bool     referenced{ false }; ///< second chance of CLOCK
+	};
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto data(const size_t index) -> std::span<uint8_t> {
+		return memory.subspan(index * block_size, block_size);
+	}
+
+	/// @returns count if the block isn't cached
+	[[nodiscard]]
+	auto find(const file_key &key, const uint32_t block) const -> size_t;
+
+	/// Sweeps the hand till an invalid or unreferenced block
+	[[nodiscard]]
+	auto victim() -> size_t;
+
+	std::array<entry, max_cache_blocks> entries{};
+	std::span<uint8_t>                  memory{};
+	uint32_t                            block_size{};
+	uint8_t                             shift{};
+	uint16_t                            count{};
+	uint16_t                            hand{};
+	cache_stats                         statistics{};
+};
+
+} // namespace gzn::fs
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+namespace gzn::fs {
+
+/**
+ * @brief LZSS in the heatshrink fashion: a bit stream of literals and back
+ * references into a small window, so the decoder fits a few KiB of stack
+ * Built by tools/asset-pack, the compressed assets start with lz::header.
+ */
+namespace lz {
+
+inline constexpr std::array<char, 4> MAGIC          { 'G', 'Z', 'L', 'Z' };
+inline constexpr uint8_t             MAX_WINDOW_BITS{ 10 }; ///< 1 KiB of the decoder window
+inline constexpr uint8_t             MAX_LENGTH_BITS{  4 };
+inline constexpr uint8_t             MIN_MATCH      {  3 }; ///< shorter ones are cheaper as literals
+
+enum class codec : uint8_t {
+	none,
+	lzss,
+};
+
+/**
+ * @brief Token stream, most significant bit first:
+ *   1 + 8 bits                           literal
+ *   0 + window_bits + length_bits bits   distance - 1, length - MIN_MATCH
+ * The stream is padded with zeros to a whole byte.
+ */
+struct header {
+	std::array<char, 4> magic{ MAGIC };
+	codec               method{ codec::lzss };
+	uint8_t             window_bits{ MAX_WINDOW_BITS };
+	uint8_t             length_bits{ MAX_LENGTH_BITS };
+	uint8_t             reserved{};
+	uint32_t            size{};   ///< decompressed
+};
+
+static_assert(sizeof(header) == 12, "The compressed layout is fixed");
+
+/// Parses and checks the header at the start of @p data
+[[nodiscard]]
+auto read_header(const std::span<const uint8_t> data, header &info) -> bool;
+
+[[nodiscard]] [[gnu::always_inline]]
+inline auto is_compressed(const std::span<const uint8_t> data) -> bool {
+	header info{};
+	return read_header(data, info);
+}
+
+class decoder {
+public:
+	void reset(const header &info);
+
+	/**
+	 * @brief Decodes as much of @p in as fits @p out
+	 * @param in advanced past the consumed bytes, refill it once it's empty
+	 * @returns bytes written
+	 */
+	auto decode(std::span<const uint8_t> &in, const std::span<uint8_t> out) -> size_t;
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto finished() const -> bool { return remaining == 0; }
+
+private:
+	[[gnu::always_inline]]
+	inline auto take(const uint8_t count) -> uint32_t {
+		const auto value{ bits >> (32 - count) };
+		bits      <<= count;
+		bit_count  -= count;
+		return value;
+	}
+
+	std::array<uint8_t, 1u << MAX_WINDOW_BITS> window{};
+	uint32_t bits{};       ///< pending input, aligned to the most significant bit
+	uint32_t remaining{};
+	uint16_t head{};
+	uint16_t distance{};
+	uint8_t  copy_left{};
+	uint8_t  bit_count{};
+	uint8_t  window_bits{};
+	uint8_t  length_bits{};
+};
+
+} // namespace lz
+
+/**
+ * @brief Streams a compressed asset into the caller's buffers
+ * @tparam Source fs::reader (use it uncached, the compressed data is read
+ * once), or the mapped asset of the pack as std::span<const uint8_t>
+ * Holds the 1 KiB window, so don't put it on a small task stack.
+ */
+template<class Source>
+class decompressor {
+	static constexpr bool   in_memory{ std::is_same_v<Source, std::span<const uint8_t>> };
+	static constexpr size_t input_size{ 256 };
+
+	struct no_input {};
+
+public:
+	explicit decompressor(Source source_) : source{ std::move(source_) } {
+		if constexpr (in_memory) {
+			valid   = lz::read_header(source, info);
+			pending = valid ? source.subspan(sizeof(lz::header)) : std::span<const uint8_t>{};
+		} else {
+			std::array<uint8_t, sizeof(lz::header)> raw{};
+			valid = source.read_into(raw) == std::size(raw) && lz::read_header(raw, info);
+		}
+		if (valid) {
+			decoder.reset(info);
+		}
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto is_open() const -> bool { return valid; }
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline explicit operator bool() const { return valid; }
+
+	/// Decompressed size of the whole asset
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto size() const -> size_t { return info.size; }
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto eof() const -> bool { return decoder.finished(); }
+
+	/// @returns bytes written, less than requested at the end or on truncated data
+	auto read_into(const std::span<uint8_t> destination) -> size_t {
+		size_t produced{};
+		while (valid && produced < std::size(destination) && !decoder.finished()) {
+			if constexpr (!in_memory) {
+				if (std::empty(pending)) {
+					const auto read{ source.read_into(input) };
+					pending = std::span{ input }.first(read);
+				}
+			}
+			const auto empty_input{ std::empty(pending) };
+			const auto decoded    { decoder.decode(pending, destination.subspan(produced)) };
+			produced += decoded;
+			if (decoded == 0 && empty_input) {
+				valid = false; // truncated
+			}
+		}
+		return produced;
+	}
+
+	/// Decodes and drops @p count bytes, there's no random access
+	auto skip(size_t count) -> size_t {
+		std::array<uint8_t, 64> scratch{};
+		size_t skipped{};
+		while (count != 0) {
+			const auto decoded{ read_into(std::span{ scratch }.first(std::min(count, std::size(scratch)))) };
+			if (decoded == 0) {
+				break;
+			}
+			skipped += decoded;
+			count   -= decoded;
+		}
+		return skipped;
+	}
+
+private:
+	Source                   source;
+	lz::header               info{};
+	lz::decoder              decoder{};
+	std::span<const uint8_t> pending{};
+	[[no_unique_address]]
+	std::conditional_t<in_memory, no_input, std::array<uint8_t, input_size>> input{};
+	bool                     valid{ false };
+};
+
+} // namespace gzn::fs
@@ -1,25 +1,76 @@
 #pragma once
 
+#include <span>
 #include <array>
 #include <limits>
+#include <cstdio>
 #include <cstdint>
 #include <string_view>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "gzn/filesystem/io.hpp"
+#include "gzn/filesystem/driver.hpp"
+#include "gzn/filesystem/reader.hpp"
+#include "gzn/filesystem/block-cache.hpp"
+
 namespace gzn::fs {
 
 constexpr size_t max_mounted_portations{ 8 };
 using partitions_array = std::array<std::string_view, max_mounted_portations>;
 
+/// SPIFFS collects whole blocks, and erasing one takes tens of milliseconds
+inline constexpr uint32_t min_gc_slice_bytes{  4096 };
+inline constexpr uint32_t max_gc_slice_bytes{ 65536 };
+
+/// Whether the flash may be busy now, e.g. nothing streams from it
+using gc_gate = bool(*)();
+
+struct gc_state {
+	size_t   last_used{};   ///< bytes of live data at the last check
+	size_t   churn{};       ///< bytes written or removed since, the estimate of the deleted pages
+	uint32_t slice_bytes{ min_gc_slice_bytes };
+};
+
+struct io_slot {
+	read_request request{};
+	reader       file{};     ///< owned by the I/O task
+	size_t       read{};
+	request_id   id{ invalid_request };
+	io_status    status{ io_status::unknown };
+	bool         cancel{ false };
+
+	[[gnu::always_inline]]
+	inline auto is_active() const -> bool {
+		return status == io_status::pending || status == io_status::reading;
+	}
+};
+
 struct context {
 	static constexpr auto npos{ (std::numeric_limits<size_t>::max)() };
 	struct garbage_collector_config{
-		uint8_t cleanup_frequency{ 40 };
-		uint8_t cleanup_attempts {  3 };
+		uint32_t idle_interval_ms{ 250 };    ///< the idle I/O task runs a slice this often
+		uint32_t slice_budget_us { 15'000 }; ///< slices shrink till they fit, and grow back
+		size_t   churn_threshold { 64 * 1024 };
+		uint8_t  min_free_percent{ 25 };     ///< any churn is collected below it
+		gc_gate  can_collect     { nullptr };
 	};
 
 	partitions_array         mounted_partitions{};
+	std::array<const driver *, max_mounted_portations> backends{};
+	const driver            *default_backend{};
+	std::array<gc_state, max_mounted_portations> gc_states{};
 	garbage_collector_config gc_config{};
-	uint8_t                  gc_counter{};
+	mapping                  pack{};          ///< the asset pack, validated
+	std::array<io_slot, max_io_requests> io_slots{};
+	SemaphoreHandle_t        io_guard{};
+	TaskHandle_t             io_task{};
+	request_id               last_request{ invalid_request };
+	volatile bool            io_running{ false };
+	block_cache              cache{};
+	std::span<uint8_t>       cache_memory{};  ///< PSRAM when there's any
+	SemaphoreHandle_t        cache_guard{};
 
 	[[gnu::always_inline]]
 	inline auto get_available_mount_id() -> size_t {
@@ -31,14 +82,78 @@ struct context {
 		return npos;
 	}
 
+	/// The slot of the request, nullptr if it's forgotten
+	[[gnu::always_inline]]
+	inline auto find_request(const request_id id) -> io_slot * {
+		for (auto &slot : io_slots) {
+			if (slot.id == id && id != invalid_request) {
+				return &slot;
+			}
+		}
+		return nullptr;
+	}
+
+	/// The most urgent active request, older ones first within a priority
+	[[gnu::always_inline]]
+	inline auto next_request() -> io_slot * {
+		io_slot *next{};
+		for (auto &slot : io_slots) {
+			if (!slot.is_active()) {
+				continue;
+			}
+			if (next == nullptr
+			||  slot.request.priority < next->request.priority
+			|| (slot.request.priority == next->request.priority
+				&& static_cast<int32_t>(slot.id - next->id) < 0)
+			) {
+				next = &slot;
+			}
+		}
+		return next;
+	}
+
+	/// A free slot, or the oldest finished one
+	[[gnu::always_inline]]
+	inline auto reusable_slot() -> io_slot * {
+		io_slot *oldest{};
+		for (auto &slot : io_slots) {
+			if (slot.is_active()) {
+				continue;
+			}
+			if (slot.id == invalid_request) {
+				return &slot;
+			}
+			if (oldest == nullptr || static_cast<int32_t>(slot.id - oldest->id) < 0) {
+				oldest = &slot;
+			}
+		}
+		return oldest;
+	}
+
 	[[gnu::always_inline]]
 	inline auto find_portation(const std::string_view portation) const -> bool {
-		for (const auto &name : mounted_partitions) {
-			if (name == portation) {
-				return true;
+		return find_mount(portation) != npos;
+	}
+
+	[[gnu::always_inline]]
+	inline auto find_mount(const std::string_view portation) const -> size_t {
+		for (size_t i{}; i < std::size(mounted_partitions); ++i) {
+			if (!std::empty(portation) && mounted_partitions[i] == portation) {
+				return i;
 			}
 		}
-		return false;
+		return npos;
+	}
+
+	/// The driver of the partition of "/<portation>/path", null if it isn't mounted
+	[[gnu::always_inline]]
+	inline auto backend_of(const std::string_view file) const -> const driver * {
+		const auto second_sep{ file.find_first_of('/', 1) };
+		if (std::size(file) < 2 || second_sep == std::string_view::npos) {
+			return nullptr;
+		}
+		const auto mount_id{ find_mount(file.substr(1, second_sep - 1)) };
+		return mount_id != npos ? backends[mount_id] : nullptr;
 	}
 };
 
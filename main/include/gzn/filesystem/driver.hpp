@@ -0,0 +1,66 @@
+#pragma once
+
+#include <span>
+#include <cstdio>
+#include <cstdint>
+#include <string_view>
+
+namespace gzn::fs {
+
+struct driver;
+
+struct mount_info {
+	std::string_view base_path{};
+	std::string_view partition_label{};
+	size_t           max_simultanious_opened_files{};
+	bool             format_if_mount_failed{ false };
+	const driver    *backend{ nullptr }; ///< manager::setup_info::backend if null
+};
+enum class mount_error {
+	ok,
+	invalid_argument,
+	not_found,
+	not_enough_memory,
+	already_mounted,
+	already_mounted_or_encrypted,
+	mount_failed,
+	max_mounted_portations_reached,
+	invalid_pack,
+};
+
+/// Read-only view of a raw partition, the asset pack
+struct mapping {
+	std::span<const uint8_t> data{};
+	uint32_t                 handle{};
+};
+
+/**
+ * @brief What fs::manager needs from a file system, see fs::backend
+ * Every partition is mounted with its own driver, and the files of the
+ * partition are opened, sought and read through it.
+ */
+struct driver {
+	std::string_view name{};
+
+	mount_error (*mount)(const mount_info &info){};
+	void        (*unmount)(const std::string_view label){};
+	bool        (*format)(const std::string_view label){};
+	bool        (*usage)(const std::string_view label, size_t &total, size_t &used){};
+	/// Frees at least @p bytes, false once there's nothing left to collect
+	bool        (*collect)(const std::string_view label, const size_t bytes){};
+
+	std::FILE  *(*open)(const std::string_view file){}; ///< for reading, null-terminated path
+	bool        (*seek)(std::FILE *file, const size_t offset){};
+	/// @returns SIZE_MAX on errors
+	size_t      (*read)(std::FILE *file, const std::span<uint8_t> out){};
+	/// @returns SIZE_MAX if there's no such file
+	size_t      (*size)(const std::string_view file){};
+	/// For writing, truncates the file. Saves and the like, the manager itself only reads
+	std::FILE  *(*create)(const std::string_view file){};
+	bool        (*remove)(const std::string_view file){};
+
+	mount_error (*map)(const std::string_view label, mapping &out){};
+	void        (*unmap)(const mapping &mapped){};
+};
+
+} // namespace gzn::fs
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <span>
+#include <cstdint>
+#include <string_view>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+namespace gzn::fs {
+
+/// Renders on core 1 wait for the display most of the time, the I/O takes that
+inline constexpr uint32_t io_task_core_id   {    1u };
+inline constexpr uint32_t io_task_stack_size{ 3072u };
+inline constexpr uint32_t io_task_priority  {    1u };
+inline constexpr size_t   max_io_requests   {    8u };
+
+using request_id = uint32_t;
+inline constexpr request_id invalid_request{ 0 };
+
+/// Lower goes first, requests of the same priority are served in order
+enum class io_priority : uint8_t {
+	audio,      ///< stream refills, late ones are heard
+	high,
+	normal,
+	background, ///< textures, levels and other preloading
+};
+
+enum class io_status : uint8_t {
+	unknown,   ///< no such request, or it's forgotten already
+	pending,
+	reading,
+	done,      ///< see io_result::read, files shorter than the destination read less
+	failed,
+	cancelled,
+};
+
+struct io_result {
+	request_id id{ invalid_request };
+	io_status  status{ io_status::unknown };
+	size_t     read{};   ///< bytes, also the ones read before a cancellation
+	void      *user{};
+};
+
+/// Called on the I/O task, so it has to be short and must not submit & wait
+using io_callback = void(*)(const io_result &result);
+
+struct read_request {
+	std::string_view   file{};           ///< null-terminated, outlives the request
+	size_t             offset{};
+	std::span<uint8_t> destination{};    ///< reads up to its size, written till the request is over
+	io_priority        priority{ io_priority::normal };
+	io_callback        on_complete{ nullptr };
+	void              *user{ nullptr };
+	TaskHandle_t       notify{ nullptr }; ///< gets xTaskNotifyGive() once the request is over
+	bool               uncached{ false }; ///< bypasses the block cache even for the urgent ones
+};
+
+} // namespace gzn::fs
@@ -2,59 +2,29 @@
 
 #include <span>
 #include <memory>
-#include <functional>
 
+#include "gzn/filesystem/reader.hpp"
 #include "gzn/filesystem/context.hpp"
+#include "gzn/filesystem/pack-format.hpp"
 
 namespace gzn::fs {
 
 inline constexpr size_t default_chunk_size{ 4096 };
 using file_id = uint32_t;
 
-struct mount_info {
-	std::string_view base_path{};
-	std::string_view partition_label{};
-	size_t           max_simultanious_opened_files{};
-	bool             format_if_mount_failed{ false };
-};
-enum class mount_error {
-	ok,
-	invalid_argument,
-	not_found,
-	not_enough_memory,
-	already_mounted,
-	already_mounted_or_encrypted,
-	mount_failed,
-	max_mounted_portations_reached,
-};
-
-
-using fetch_callback = std::function<std::span<uint8_t>(const size_t count)>;
-using open_callback  = bool(*)(const fetch_callback &fetch, void *user);
-using read_callback  = bool(*)(const fetch_callback &fetch, void *user);
-
-// The stupiest idea for embedded, so nowhere used. I dedinitely should remove it...
-struct file_callbacks {
-	open_callback on_open{ nullptr };
-	read_callback on_read{ nullptr };
-
-	[[gnu::always_inline]]
-	inline auto empty() const -> bool { return !on_open && !on_read; }
-};
-
 class manager {
 public:
-	static constexpr char   sep{ '/' };
-	static constexpr size_t buffer_length{ 128 };
+	static constexpr char sep{ '/' };
 
 	struct setup_info {
+		const driver                     *backend{ nullptr }; ///< of the partitions and the pack, e.g. backend::spiffs_driver
 		context::garbage_collector_config gc_config{};
+		block_cache::config               cache{};
 	};
 
 	[[nodiscard]]
 	static auto initialize(const setup_info &info) -> bool;
 	static void destroy();
-	static void update();
 
 	[[nodiscard]]
 	static auto mount(const mount_info &info) -> mount_error;
@@ -66,21 +36,141 @@ public:
 	[[nodiscard]]
 	static auto can_open(const std::string_view file) -> bool;
 
+	/// @returns SIZE_MAX if there's no such file
+	[[nodiscard]]
+	static auto file_size(const std::string_view file) -> size_t;
+
+	/// The driver of the file's partition, null if it isn't mounted
+	[[nodiscard]]
+	static auto backend_of(const std::string_view file) -> const driver *;
+
+	/**
+	 * @brief Maps the raw partition with the asset pack (see tools/asset-pack)
+	 * through setup_info::backend
+	 * The assets stay in the flash and are read through the cache, so there
+	 * are no file handles, no path parsing and no copies.
+	 */
+	[[nodiscard]]
+	static auto mount_pack(const std::string_view partition_label) -> mount_error;
+	static void unmount_pack();
+
+	/// Zero-copy view of the packed asset, empty if there's no such one
+	[[nodiscard]]
+	static auto find_asset(const pack::hash_t hash) -> std::span<const uint8_t>;
+
+	/// @param name relative to the packed directory, e.g. "sounds/attack.wav"
+	[[nodiscard]] [[gnu::always_inline]]
+	static inline auto find_asset(const std::string_view name) -> std::span<const uint8_t> {
+		return find_asset(pack::hash(name));
+	}
+
+	/**
+	 * @brief Queues the read for the I/O task and returns right away
+	 * Files are read in default_chunk_size chunks, and the most urgent request
+	 * is picked again after each one, so an audio refill submitted meanwhile
+	 * never waits for the whole texture.
+	 * @returns invalid_request if the file isn't on a mounted partition or
+	 * there are max_io_requests in flight already
+	 */
+	[[nodiscard]]
+	static auto submit(const read_request &request) -> request_id;
+
+	/// Stops the request at the next chunk. It's over once it reports io_status::cancelled
+	static auto cancel(const request_id id) -> bool;
+
+	/// Polling alternative to the callbacks, finished requests are kept till their slot is reused
+	[[nodiscard]]
+	static auto status(const request_id id) -> io_result;
+
+	/**
+	 * @brief Counters of the block cache which read_file(), read_file_loop()
+	 * and the audio and high priority requests read through
+	 */
+	[[nodiscard]]
+	static auto cache_stats() -> fs::cache_stats;
+	static void reset_cache_stats();
+
+	/// Drops the cached blocks of the file, call it after writing the file
+	static void invalidate_cache(const std::string_view file);
+
+	/**
+	 * @brief Call it after writing or removing a file, e.g. a save game
+	 * Drops its cached blocks and counts the bytes towards the churn of its
+	 * partition, which the idle garbage collection keeps up with. Rewrites of
+	 * the same size are invisible to it otherwise.
+	 */
+	static void notify_written(const std::string_view file, const size_t bytes);
+
+	/**
+	 * @brief Opens the file for reading, check it with reader::is_open()
+	 * @param cached reads through the block cache, bulk loads read once
+	 * are better off without it and keep the hot blocks cached
+	 */
+	[[nodiscard]]
+	static auto open(const std::string_view file, const bool cached = true) -> reader;
+
+	/**
+	 * @brief Synchronous, blocks the caller till the whole file is read. See submit()
+	 * @param buffer the chunks are read into, its size is the chunk size
+	 * @param on_chunk `(std::span<uint8_t>) -> bool`, false stops reading
+	 */
+	template<class Callback>
 	static auto read_file(
 		const std::string_view file,
-		const file_callbacks &callbacks,
-		void *user = nullptr
-	) -> bool;
-
+		const std::span<uint8_t> buffer,
+		Callback &&on_chunk
+	) -> bool {
+		auto source{ open(file) };
+		if (!source) {
+			return false;
+		}
+		for (const auto chunk : source.chunks(buffer)) {
+			if (!on_chunk(chunk)) {
+				break;
+			}
+		}
+		return !source.failed();
+	}
+
+	/**
+	 * @brief Reads the file over and over from @p loop_from till on_chunk returns false
+	 * Synchronous, the loop point waits for a seek. fs::stream reads looping
+	 * files ahead on the I/O task instead.
+	 */
+	template<class Callback>
 	static auto read_file_loop(
 		const std::string_view file,
-		const file_callbacks &callbacks,
-		void *user = nullptr
-	) -> bool;
-
+		const std::span<uint8_t> buffer,
+		Callback &&on_chunk,
+		const size_t loop_from = 0
+	) -> bool {
+		auto source{ open(file) };
+		if (!source) {
+			return false;
+		}
+		while (true) {
+			for (const auto chunk : source.chunks(buffer)) {
+				if (!on_chunk(chunk)) {
+					return true;
+				}
+			}
+			if (source.failed() || source.tell() <= loop_from) {
+				return !source.failed(); // nothing to loop
+			}
+			source.seek(loop_from);
+		}
+	}
+
+	/**
+	 * @brief Blocking collection of every deleted page, e.g. on a loading screen
+	 * Otherwise the idle I/O task collects in slices of
+	 * garbage_collector_config::slice_budget_us while the gate allows it.
+	 */
 	static void collect_garbage();
 
 private:
+	friend class reader;
+
 	inline static std::unique_ptr<context> ctx{};
 };
 
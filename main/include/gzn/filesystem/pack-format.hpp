@@ -0,0 +1,75 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace gzn::fs::pack {
+
+using hash_t = uint32_t;
+
+inline constexpr hash_t FNV_OFFSET_BASIS{ 2'166'136'261u };
+inline constexpr hash_t FNV_PRIME       { 16'777'619u };
+
+/**
+ * @brief 32-bit FNV-1a of the asset path relative to the packed directory
+ * Byte by byte, as the standard defines it, unlike core::fnv1a of
+ * dev-null/strhash.hpp: that one takes whole words through unaligned loads
+ * and the tail in reverse, so its value depends on the host's byte order and
+ * the tools couldn't build an index the firmware agrees with.
+ */
+[[nodiscard]]
+constexpr auto hash(const std::string_view name) -> hash_t {
+	hash_t value{ FNV_OFFSET_BASIS };
+	for (const auto c : name) {
+		value = (value ^ static_cast<uint8_t>(c)) * FNV_PRIME;
+	}
+	return value;
+}
+
+inline constexpr std::array<char, 4> MAGIC    { 'G', 'Z', 'P', 'K' };
+inline constexpr uint16_t            VERSION  { 1 };
+inline constexpr uint32_t            ALIGNMENT{ 4 }; ///< of every asset, so int16 samples map as is
+
+/**
+ * @brief Layout: header, entries sorted by hash, then aligned asset data
+ * Little-endian, like both the host and the device.
+ */
+struct header {
+	std::array<char, 4> magic{ MAGIC };
+	uint16_t            version{ VERSION };
+	uint16_t            alignment{ ALIGNMENT };
+	uint32_t            count{};  ///< of entries
+	uint32_t            size{};   ///< of the whole pack
+};
+
+struct entry {
+	hash_t   hash{};
+	uint32_t offset{}; ///< from the pack start
+	uint32_t size{};
+};
+
+static_assert(sizeof(header) == 16 && sizeof(entry) == 12, "The pack layout is fixed");
+
+enum class error : uint8_t {
+	ok,
+	too_small,
+	bad_magic,
+	unsupported_version,
+	corrupted,
+};
+
+/// Checks the header and every entry once, so find() could trust them
+[[nodiscard]]
+auto validate(const std::span<const uint8_t> blob) -> error;
+
+/// Entries of the validated @p blob, in place
+[[nodiscard]]
+auto entries(const std::span<const uint8_t> blob) -> std::span<const entry>;
+
+/// Binary search in the validated @p blob. Empty span if there's no such asset
+[[nodiscard]]
+auto find(const std::span<const uint8_t> blob, const hash_t hash) -> std::span<const uint8_t>;
+
+} // namespace gzn::fs::pack
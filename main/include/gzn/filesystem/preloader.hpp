@@ -0,0 +1,110 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include "gzn/filesystem/pack-format.hpp"
+
+namespace gzn::fs {
+
+inline constexpr size_t   max_manifest_assets    {   64 };
+inline constexpr size_t   preload_pipeline_depth {    3 }; ///< reads in flight while one is decoded
+inline constexpr uint32_t preload_task_stack_size{ 4096 };
+inline constexpr size_t   simd_alignment         {   16 }; ///< of the S3 vector loads and stores
+
+enum class memory_class : uint8_t {
+	internal, ///< fast, DMA-capable
+	simd,     ///< internal, simd_alignment aligned
+	psram,    ///< falls back to internal without PSRAM
+};
+
+struct manifest_entry {
+	std::string_view file{};  ///< null-terminated, outlives the preload
+	memory_class     memory{ memory_class::psram };
+};
+
+enum class preload_state : uint8_t {
+	idle,
+	loading,
+	ready,     ///< waits for commit()
+	failed,
+	cancelled,
+};
+
+struct preload_progress {
+	preload_state state{ preload_state::idle };
+	uint16_t      assets_done{};
+	uint16_t      assets_total{};
+	size_t        bytes_done{};   ///< read from the flash, so compressed ones count compressed
+	size_t        bytes_total{};  ///< 0 till every file of the manifest is found
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto ratio() const -> float {
+		return bytes_total != 0 ? static_cast<float>(bytes_done) / static_cast<float>(bytes_total) : 0.0f;
+	}
+};
+
+struct loaded_asset {
+	pack::hash_t       hash{};
+	std::span<uint8_t> data{};
+};
+
+/// The assets of a manifest, owns their memory
+class asset_set {
+public:
+	[[nodiscard]]
+	auto find(const pack::hash_t hash) const -> std::span<const uint8_t>;
+	auto add(const pack::hash_t hash, const std::span<uint8_t> data) -> bool;
+	void release();
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto size() const -> size_t { return count; }
+
+private:
+	std::array<loaded_asset, max_manifest_assets> assets{};
+	size_t                                        count{};
+};
+
+/**
+ * @brief Loads the assets of a manifest on the I/O core while the game runs
+ * Files are read through the I/O queue with background priority, and the
+ * compressed ones are decoded while the next ones are read. The loaded set
+ * replaces the active one only on commit(), so a level never sees half of
+ * its assets.
+ */
+class preloader {
+public:
+	/// Drops a loaded set which isn't committed, fails while another one loads
+	[[nodiscard]]
+	static auto start(const std::span<const manifest_entry> manifest) -> bool;
+
+	/// Blocks till the reads in flight are over
+	static void cancel();
+
+	[[nodiscard]]
+	static auto progress() -> preload_progress;
+
+	/**
+	 * @brief Makes the loaded set the active one and frees the previous set
+	 * Call it where nothing holds views of the previous assets, e.g. between
+	 * frames of the game loop.
+	 */
+	static auto commit() -> bool;
+
+	/// The asset of the active set, empty if there's no such one
+	[[nodiscard]]
+	static auto find(const pack::hash_t hash) -> std::span<const uint8_t>;
+
+	/// @param file the path as in the manifest
+	[[nodiscard]] [[gnu::always_inline]]
+	static inline auto find(const std::string_view file) -> std::span<const uint8_t> {
+		return find(pack::hash(file));
+	}
+
+	/// Cancels the loading and frees both sets
+	static void destroy();
+};
+
+} // namespace gzn::fs
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <span>
+#include <cstdio>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+
+#include "gzn/filesystem/block-cache.hpp"
+
+namespace gzn::fs {
+
+struct driver;
+
+/**
+ * @brief Sequential reader of a file on a mounted partition, see manager::open()
+ * Doesn't allocate: the data goes straight into the caller's spans, through
+ * the block cache unless it's opened uncached. A cached file is looked up on
+ * open, but the file itself is opened only when a block isn't cached.
+ */
+class reader {
+public:
+	/// Yields the chunks read into the caller's buffer, the last one may be shorter
+	class chunk_iterator {
+	public:
+		using value_type      = std::span<uint8_t>;
+		using difference_type = std::ptrdiff_t;
+
+		chunk_iterator() = default;
+		chunk_iterator(reader &source, const std::span<uint8_t> buffer)
+			: source{ &source }, buffer{ buffer } { next(); }
+
+		[[nodiscard]] [[gnu::always_inline]]
+		inline auto operator*() const -> value_type { return chunk; }
+
+		[[gnu::always_inline]]
+		inline auto operator++() -> chunk_iterator & { next(); return *this; }
+
+		[[gnu::always_inline]]
+		inline void operator++(int) { next(); }
+
+		[[nodiscard]] [[gnu::always_inline]]
+		inline auto operator==(std::default_sentinel_t) const -> bool { return std::empty(chunk); }
+
+	private:
+		[[gnu::always_inline]]
+		inline void next() {
+			chunk = source->eof()
+				? std::span<uint8_t>{}
+				: buffer.first(source->read_into(buffer));
+		}
+
+		reader            *source{};
+		std::span<uint8_t> buffer{};
+		std::span<uint8_t> chunk{};
+	};
+
+	struct chunk_range {
+		reader            &source;
+		std::span<uint8_t> buffer;
+
+		[[nodiscard]] [[gnu::always_inline]]
+		inline auto begin() const -> chunk_iterator { return { source, buffer }; }
+
+		[[nodiscard]] [[gnu::always_inline]]
+		inline auto end() const -> std::default_sentinel_t { return {}; }
+	};
+
+	reader() = default;
+	reader(reader &&other) noexcept;
+	auto operator=(reader &&other) noexcept -> reader &;
+	~reader() { close(); }
+
+	reader(const reader &) = delete;
+	auto operator=(const reader &) -> reader & = delete;
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto is_open() const -> bool { return !std::empty(path) && !error; }
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline explicit operator bool() const { return is_open(); }
+
+	/// Set once a read came out short, cleared by seek() and skip()
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto eof() const -> bool { return end; }
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto failed() const -> bool { return error; }
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto tell() const -> size_t { return position; }
+
+	/// @returns bytes read, less than the size at the end of the file or on errors
+	auto read_into(const std::span<uint8_t> destination) -> size_t;
+
+	/// Reads a trivially copyable value, e.g. a file header
+	template<class T>
+	requires std::is_trivially_copyable_v<T>
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto read(T &value) -> bool {
+		return read_into(std::span{ reinterpret_cast<uint8_t *>(&value), sizeof(T) }) == sizeof(T);
+	}
+
+	/// Lazy, positions past the end show up as eof() on the next read
+	[[gnu::always_inline]]
+	inline void seek(const size_t offset) { position = offset; end = false; }
+
+	[[gnu::always_inline]]
+	inline void skip(const size_t count) { seek(position + count); }
+
+	/// Range over the rest of the file, std::size(buffer) bytes a chunk
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto chunks(const std::span<uint8_t> buffer) -> chunk_range { return { *this, buffer }; }
+
+	void close();
+
+private:
+	friend class manager;
+
+	reader(const std::string_view path, const bool cached, const driver *backend);
+
+	/// Checks the file is there, it's opened by the first block which isn't cached
+	auto open() -> bool;
+	auto ensure_open() -> bool;
+	/// @returns SIZE_MAX on errors
+	auto fill(const size_t offset, const std::span<uint8_t> out) -> size_t;
+
+	std::string_view path{};     ///< null-terminated
+	std::FILE       *file{};
+	const driver    *backend{};  ///< of the partition, null if it isn't mounted
+	size_t           position{};
+	file_key         key{};      ///< of the cached blocks
+	bool             cached{ true };
+	bool             end{ false };
+	bool             error{ false };
+};
+
+} // namespace gzn::fs
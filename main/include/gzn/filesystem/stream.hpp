@@ -0,0 +1,113 @@
+#pragma once
+
+#include <span>
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+#include "gzn/filesystem/io.hpp"
+
+namespace gzn::fs {
+
+inline constexpr size_t default_stream_ahead{ 16 * 1024 };
+inline constexpr size_t default_stream_burst{  4 * 1024 };
+
+struct stream_config {
+	size_t      ahead{ default_stream_ahead };  ///< ring size, rounded down to a power of two
+	size_t      burst{ default_stream_burst };  ///< flash read size, up to a half of the ring
+	size_t      offset{};                       ///< where it starts, e.g. past a header
+	size_t      end{ SIZE_MAX };                ///< exclusive, the file size if it's past it
+	size_t      loop_from{};                    ///< file offset the loop goes back to
+	bool        loop{ false };
+	io_priority priority{ io_priority::high };
+};
+
+/**
+ * @brief Read-ahead ring of a sequentially read file, e.g. music or a cutscene
+ * The I/O task keeps the ring filled in burst-sized reads, which bypass the
+ * block cache, and the consumer copies from RAM only. Looping streams read
+ * past the loop point ahead of time, so the loop is seamless. One producer
+ * (the I/O task) and one consumer, no locks.
+ *
+ * Requests point at the stream, so it isn't movable and has to be closed
+ * before its memory goes away (the destructor does).
+ */
+class stream {
+public:
+	stream() = default;
+	~stream() { close(); }
+
+	stream(const stream &) = delete;
+	stream(stream &&) = delete;
+	auto operator=(const stream &) -> stream & = delete;
+	auto operator=(stream &&) -> stream & = delete;
+
+	/**
+	 * @param file null-terminated, outlives the stream
+	 * @param ring the memory of the ring, allocated (internal RAM) if empty
+	 */
+	[[nodiscard]]
+	auto open(const std::string_view file, const stream_config &config = {}, const std::span<uint8_t> ring = {}) -> bool;
+
+	/// Cancels the read in flight and waits for it
+	void close();
+
+	/// Copies what's buffered, never blocks. Short reads before the end count as underruns
+	auto read_into(std::span<uint8_t> destination) -> size_t;
+
+	/// Blocks till @p bytes (up to the ring size) are buffered or the stream ends
+	auto wait(const size_t bytes, const TickType_t timeout) -> bool;
+
+	/// Queues the next burst if there's room, read_into() calls it
+	void pump();
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto is_open() const -> bool { return capacity_mask != 0; }
+
+	/// Buffered bytes
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto fill_level() const -> size_t {
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto capacity() const -> size_t { return is_open() ? capacity_mask + 1 : 0; }
+
+	/// Nothing is left to read, looping streams never end
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto eof() const -> bool { return ended.load(std::memory_order_acquire) && fill_level() == 0; }
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto failed() const -> bool { return error.load(std::memory_order_relaxed); }
+
+	/// read_into() calls which got less than asked for before the end
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto underruns() const -> uint32_t { return underrun_count; }
+
+private:
+	static void on_read(const io_result &result);
+	/// Only by the owner of busy, false if nothing is queued
+	auto submit_next() -> bool;
+
+	std::string_view        file{};
+	std::span<uint8_t>      ring{};
+	size_t                  capacity_mask{};
+	size_t                  burst{};
+	size_t                  source{};        ///< file offset of the next burst
+	size_t                  source_end{};
+	size_t                  loop_from{};
+	size_t                  requested{};
+	io_priority             priority{ io_priority::high };
+	bool                    loop{ false };
+	bool                    owns_ring{ false };
+	std::atomic<uint32_t>   head{};          ///< consumed bytes, the consumer's
+	std::atomic<uint32_t>   tail{};          ///< buffered bytes, the producer's
+	std::atomic<bool>       busy{ false };   ///< a burst is queued, the one who sets it owns source
+	std::atomic<bool>       ended{ false };  ///< the file is read till source_end
+	std::atomic<bool>       error{ false };
+	std::atomic<bool>       closing{ false };
+	std::atomic<request_id> pending{ invalid_request };
+	uint32_t                underrun_count{};
+};
+
+} // namespace gzn::fs
@@ -60,6 +60,7 @@ public:
 	static auto resolution() noexcept -> gzn::vec2u16;
 	static auto next_buffer_id() noexcept -> uint8_t;
 	static auto current_buffer_id() noexcept -> uint8_t;
+	static auto buffers_count() noexcept -> uint8_t;
 
 	static auto get_next_buffer() noexcept -> std::span<color>;
 	static auto get_current_buffer() noexcept -> std::span<color>;
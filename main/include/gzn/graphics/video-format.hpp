@@ -0,0 +1,95 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <cstdint>
+
+#include "gzn/core/color.hpp"
+
+namespace gzn::graphics::video {
+
+inline constexpr std::array<char, 4> MAGIC      { 'G', 'Z', 'V', 'D' };
+inline constexpr uint16_t            VERSION    { 1 };
+inline constexpr size_t              MAX_PALETTE{ 256 };
+inline constexpr uint8_t             MAX_OP     { 128 }; ///< pixels of a run or a literal
+inline constexpr uint8_t             RUN_BIT    { 0x80 };
+inline constexpr uint8_t             KEY_FRAME  { 0x01 }; ///< frame_header::flags, every pixel is coded
+
+enum class pixel_format : uint8_t {
+	rgb565,   ///< a pixel is a color
+	palette8, ///< a pixel is an index of the palette
+};
+
+/**
+ * @brief Layout: header, palette_size colors, then frame_count frames
+ * A frame is a frame_header and `size` bytes of row records, which code only
+ * the pixels that changed since the previous frame:
+ *   u16 y, u8 ops, then every op is
+ *   u16 skip (unchanged pixels since the previous op of the row),
+ *   u8 code: RUN_BIT with (code & 0x7F) + 1 copies of one pixel, or
+ *            (code + 1) literal pixels,
+ *   the pixels: u16 colors or u8 palette indices.
+ * A row may have several records. Little-endian, like both the host and the device.
+ */
+struct header {
+	std::array<char, 4> magic{ MAGIC };
+	uint16_t            version{ VERSION };
+	pixel_format        format{ pixel_format::rgb565 };
+	uint8_t             reserved{};
+	uint16_t            width{};
+	uint16_t            height{};
+	uint32_t            frame_count{};
+	uint32_t            frame_us{};       ///< how long a frame is shown
+	uint32_t            max_frame_size{}; ///< of the frame data, the player's buffers
+	uint16_t            palette_size{};
+	uint16_t            key_interval{};   ///< 0 if only the first frame is a key one
+	uint32_t            reserved_2{};
+};
+
+struct frame_header {
+	uint32_t size{};   ///< of the row records
+	uint8_t  flags{};
+	uint8_t  reserved[3]{};
+};
+
+static_assert(sizeof(header) == 32 && sizeof(frame_header) == 8, "The video layout is fixed");
+
+enum class error : uint8_t {
+	ok,
+	too_small,
+	bad_magic,
+	unsupported_version,
+	corrupted,
+};
+
+/// Reads and checks the header, @p data has to contain the palette too
+[[nodiscard]]
+auto read_header(const std::span<const uint8_t> data, header &info) -> error;
+
+/// Bytes before the first frame
+[[nodiscard]] [[gnu::always_inline]]
+inline auto frames_offset(const header &info) -> size_t {
+	return sizeof(header) + size_t{ info.palette_size } * sizeof(color);
+}
+
+[[nodiscard]] [[gnu::always_inline]]
+inline auto pixel_size(const pixel_format format) -> size_t {
+	return format == pixel_format::rgb565 ? sizeof(color) : sizeof(uint8_t);
+}
+
+/**
+ * @brief Writes the coded pixels over @p target, the rest stays as it is
+ * @param target the top-left pixel of the video and what follows it
+ * @param stride pixels from a row of @p target to the next one
+ * @returns false if the frame is corrupted or doesn't fit the video size
+ */
+[[nodiscard]]
+auto decode(
+	const std::span<const uint8_t> frame,
+	const header &info,
+	const std::span<const color> palette,
+	std::span<color> target,
+	const size_t stride
+) -> bool;
+
+} // namespace gzn::graphics::video
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "gzn/core/math.hpp"
+#include "gzn/graphics/video-format.hpp"
+
+namespace gzn::graphics::video {
+
+struct play_info {
+	std::string_view file{};        ///< null-terminated, outlives the playback, see tools/video-encode
+	std::string_view soundtrack{};  ///< WAV started with the first frame, optional
+	vec2u16          position{};    ///< of the top-left pixel on the screen
+	int8_t           volume{ 16 };  ///< of the soundtrack, from -16 to 16
+	bool             loop{ false }; ///< restarts the soundtrack with every loop
+};
+
+enum class play_error : uint8_t {
+	ok,
+	already_playing,
+	not_found,
+	invalid_format,
+	too_large,          ///< doesn't fit the screen at the position
+	not_enough_memory,
+};
+
+/**
+ * @brief Streams a video file through fs::stream and decodes it straight
+ * into render::get_next_buffer()
+ * Frames only code the pixels which changed since the previous one, so a
+ * render buffer is brought up to date by replaying the frames it missed: the
+ * last render::buffers_count() frames are kept for it. The video rectangle
+ * belongs to the player while it plays, whatever is drawn over it has to be
+ * drawn after update() every frame.
+ *
+ * Frames are timed by esp_timer_get_time(), the clock audio::manager::play_at()
+ * schedules the soundtrack by, so they stay in sync. Late frames are decoded
+ * but not shown.
+ */
+class player {
+public:
+	[[nodiscard]]
+	static auto play(const play_info &info) -> play_error;
+	static void stop();
+
+	/**
+	 * @brief Draws the frame due now into render::get_next_buffer(), call it
+	 * before render::submit() every frame
+	 * @returns false once the video is over (it's stopped then) or failed
+	 */
+	static auto update() -> bool;
+
+	[[nodiscard]]
+	static auto is_playing() -> bool;
+
+	/// Frames which were decoded but never shown since play()
+	[[nodiscard]]
+	static auto dropped_frames() -> uint32_t;
+
+private:
+	struct context;
+	inline static context *ctx{ nullptr };
+};
+
+} // namespace gzn::graphics::video
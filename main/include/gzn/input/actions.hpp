@@ -1,5 +1,7 @@
 #pragma once
 
+#include <bit>
+#include <array>
 #include <cstdint>
 #include <esp_timer.h>
 
@@ -20,6 +22,12 @@ enum class action_type : uint8_t {
 	COUNT
 };
 
+/// Axis actions carry a value, the others are buttons
+[[nodiscard]]
+constexpr auto is_axis(const action_type action) -> bool {
+	return action == action_type::horizontal_move || action == action_type::vertical_move;
+}
+
 inline constexpr uint64_t ACTION_JUST_THESHOLD_MICROSECONDS{ 50'000u };
 
 struct action_info {
@@ -45,5 +53,70 @@ struct action_info {
 
 using action_array = core::enum_array<action_type, action_info>;
 
+inline constexpr size_t KEYBOARD_USAGES{ 256 };
+
+/// Keyboard keys by HID usage ID, one bit each
+struct key_set {
+	static constexpr size_t WORD_BITS{ 32 };
+
+	std::array<uint32_t, KEYBOARD_USAGES / WORD_BITS> words{};
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto test(const uint8_t usage) const -> bool {
+		return (words[usage / WORD_BITS] >> (usage % WORD_BITS)) & 1u;
+	}
+
+	[[gnu::always_inline]]
+	inline void set(const uint8_t usage) {
+		words[usage / WORD_BITS] |= 1u << (usage % WORD_BITS);
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto any() const -> bool {
+		uint32_t bits{};
+		for (const auto word : words) {
+			bits |= word;
+		}
+		return bits != 0;
+	}
+
+	/// Keys of this set which @p other doesn't have, `this & ~other`
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto without(const key_set &other) const -> key_set {
+		key_set result{};
+		for (size_t i{}; i < std::size(words); ++i) {
+			result.words[i] = words[i] & ~other.words[i];
+		}
+		return result;
+	}
+
+	/// Adds the keys of @p other, `this | other`
+	[[gnu::always_inline]]
+	inline void merge(const key_set &other) {
+		for (size_t i{}; i < std::size(words); ++i) {
+			words[i] |= other.words[i];
+		}
+	}
+
+	/// Calls @p on_key with the usage ID of every key of the set, in order
+	template<class Callback>
+	[[gnu::always_inline]]
+	inline void for_each(Callback &&on_key) const {
+		for (size_t i{}; i < std::size(words); ++i) {
+			for (auto bits{ words[i] }; bits != 0; bits &= bits - 1) {
+				on_key(static_cast<uint8_t>(i * WORD_BITS + std::countr_zero(bits)));
+			}
+		}
+	}
+
+	[[nodiscard]] constexpr bool operator==(const key_set &other) const = default;
+};
+
+/// What the translators keep up to date and the game loop reads a snapshot of
+struct input_state {
+	action_array actions{};
+	key_set      keys{};     ///< held keyboard keys
+};
+
 } // namespace gzn::input
 
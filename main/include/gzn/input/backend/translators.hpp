@@ -3,24 +3,71 @@
 #include <span>
 
 #include "gzn/input/actions.hpp"
+#include "gzn/input/bindings.hpp"
 
 namespace gzn::input::backend {
 
-using translator = void(*)(
-	const std::span<const uint8_t> data,
-	action_array &actions
-);
+/**
+ * @brief What the inputs held in a report drive, applied to the actions at once
+ * Buttons are held while any of their inputs is, axes add their inputs' values
+ * up, so releasing one of two keys of an action keeps it held. The same goes
+ * for the levels of several devices, see merge().
+ */
+struct action_levels {
+	core::enum_array<action_type, int16_t> axes{};
+	core::enum_array<action_type, bool>    held{};
+
+	[[gnu::always_inline]]
+	inline void add(const binding bound) {
+		held[bound.action]  = true;
+		axes[bound.action] += bound.value;
+	}
+
+	[[gnu::always_inline]]
+	inline void add_axis(const action_type action, const int8_t value) {
+		axes[action] += value;
+	}
+
+	/// Adds what another device holds
+	[[gnu::always_inline]]
+	inline void merge(const action_levels &other) {
+		for (size_t i{}; i < std::size(axes); ++i) {
+			const auto type{ static_cast<action_type>(i) };
+			held[type]  = held[type] || other.held[type];
+			axes[type] += other.axes[type];
+		}
+	}
+
+	/// Only the changed actions get the @p timestamp
+	void apply(action_array &actions, const uint64_t timestamp) const;
 
+	[[nodiscard]] bool operator==(const action_levels &other) const = default;
+};
 
-void keyboard_usb_translator(
+/// What a single device holds, the actions are what all the devices hold
+struct device_state {
+	action_levels levels{};
+	key_set       keys{};   ///< held keyboard keys
+};
+
+/// Updates @p state by the report, false if nothing has changed
+using translator = auto(*)(
+	const std::span<const uint8_t> data,
+	const binding_map &bindings,
+	device_state &state
+) -> bool;
+
+auto keyboard_usb_translator(
 	const std::span<const uint8_t> data,
-	action_array &actions
-);
+	const binding_map &bindings,
+	device_state &state
+) -> bool;
 
-void dualsense_usb_translator(
+auto dualsense_usb_translator(
 	const std::span<const uint8_t> data,
-	action_array &actions
-);
+	const binding_map &bindings,
+	device_state &state
+) -> bool;
 
 [[nodiscard]]
 auto select_translator(
@@ -29,4 +76,3 @@ auto select_translator(
 ) -> translator;
 
 } // namespace gzn::input::backend
-
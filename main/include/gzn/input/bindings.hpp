@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+#include "gzn/input/actions.hpp"
+
+namespace gzn::input {
+
+inline constexpr size_t MAX_BINDINGS_FILE{ 2048 };
+
+/// What an input drives. Axis actions add up the values of the held inputs
+struct alignas(uint16_t) binding {
+	action_type action{ action_type::invalid };
+	int8_t      value{};  ///< of an axis action, buttons ignore it
+
+	[[nodiscard]] constexpr bool operator==(const binding &other) const = default;
+};
+
+/// Bit positions of the gamepad button mask the translators build
+enum class gamepad_button : uint8_t {
+	dpad_up,
+	dpad_right,
+	dpad_down,
+	dpad_left,
+	square,
+	cross,
+	circle,
+	triangle,
+	l1,
+	r1,
+	l2,
+	r2,
+	create,
+	option,
+	l3,
+	r3,
+	ps,
+	touchpad,
+	mute,
+
+	COUNT
+};
+
+enum class gamepad_axis : uint8_t {
+	left_x,
+	left_y,
+	right_x,
+	right_y,
+
+	COUNT
+};
+
+/**
+ * @brief Which action every key, gamepad button and stick drives
+ * The HID task reads the tables while the game may rebind, so the entries
+ * of a shared map are only read through key(), button() and axis() and only
+ * written through the bind_*() setters, which access them atomically.
+ */
+struct binding_map {
+	std::array<binding, KEYBOARD_USAGES>            keys{};     ///< by HID usage ID
+	core::enum_array<gamepad_button, binding>      buttons{};
+	core::enum_array<gamepad_axis, action_type>    axes{};
+
+	/// WASD and arrows move, E and space use, Esc pauses. Cross attacks, circle uses
+	[[nodiscard]]
+	static auto defaults() -> binding_map;
+
+	/**
+	 * @brief Reads a bindings config, one binding per line:
+	 *   key <name or HID usage> <action> [axis value]
+	 *   button <gamepad button> <action> [axis value]
+	 *   axis <gamepad axis> <action>
+	 * `#` starts a comment, e.g. `key left horizontal_move -128`. Inputs which
+	 * aren't listed keep their bindings.
+	 * @returns false at the first line which doesn't parse, nothing is changed then
+	 */
+	[[nodiscard]]
+	auto parse(const std::string_view config) -> bool;
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto key(const uint8_t usage) const -> binding {
+		return load(keys[usage]);
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto button(const gamepad_button button) const -> binding {
+		return load(buttons[button]);
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto axis(const gamepad_axis axis) const -> action_type {
+		return load(axes[axis]);
+	}
+
+	[[gnu::always_inline]]
+	inline void bind_key(const uint8_t usage, const binding bound) {
+		store(keys[usage], bound);
+	}
+
+	[[gnu::always_inline]]
+	inline void bind_button(const gamepad_button button, const binding bound) {
+		store(buttons[button], bound);
+	}
+
+	[[gnu::always_inline]]
+	inline void bind_axis(const gamepad_axis axis, const action_type action) {
+		store(axes[axis], action);
+	}
+
+	/// Entry by entry through the setters, a report may see a mix of both maps
+	void assign(const binding_map &other);
+
+private:
+	template<class Entry>
+	[[nodiscard]] [[gnu::always_inline]]
+	static inline auto load(const Entry &entry) -> Entry {
+		// Never written through this reference, atomic_ref just can't take a const one
+		return std::atomic_ref{ const_cast<Entry &>(entry) }.load(std::memory_order_relaxed);
+	}
+
+	template<class Entry>
+	[[gnu::always_inline]]
+	static inline void store(Entry &entry, const Entry value) {
+		std::atomic_ref{ entry }.store(value, std::memory_order_relaxed);
+	}
+};
+
+static_assert(std::atomic_ref<binding>::is_always_lock_free,     "Bindings are read by the HID task");
+static_assert(std::atomic_ref<action_type>::is_always_lock_free, "Bindings are read by the HID task");
+
+} // namespace gzn::input
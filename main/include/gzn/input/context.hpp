@@ -1,19 +1,24 @@
 #pragma once
 
+#include <atomic>
+
 #include "gzn/input/actions.hpp"
 #include "gzn/input/backend.hpp"
+#include "gzn/input/bindings.hpp"
 #include "gzn/input/backend/translators.hpp"
 
 namespace gzn::input {
 
 inline constexpr size_t MAX_EVENT_HANDLERS   { 6 };
 inline constexpr size_t MAX_CONNECTED_DEVICES{ 2 };
+inline constexpr size_t MAX_SNAPSHOT_RETRIES { 4 }; ///< then the frame keeps the previous snapshot
 
 struct device_info {
-	uintptr_t           id{};
-	backend::translator translator{ nullptr };
-	uint16_t            vendor_id{};
-	uint16_t            product_id{};
+	uintptr_t             id{};
+	backend::translator   translator{ nullptr };
+	uint16_t              vendor_id{};
+	uint16_t              product_id{};
+	backend::device_state state{};   ///< what it holds, the HID task's
 };
 
 
@@ -37,9 +42,34 @@ struct event_handler {
 
 
 
+/**
+ * @brief Input state the HID task writes and the game loop reads once a frame
+ * Seqlock: context::publish_devices() fills `pending`, then publish() makes the sequence
+ * odd, copies it into `published` and makes the sequence even again. take()
+ * copies `published` and retries if the sequence was odd or has changed
+ * meanwhile. The HID task never waits and the game loop never locks.
+ */
+struct state_exchange {
+	input_state           pending{};         ///< the HID task's, what all the devices hold
+	input_state           published{};
+	input_state           snapshot{};        ///< the game loop's, see manager::begin_frame()
+	key_set               pressed_keys{};    ///< since the previous snapshot
+	key_set               released_keys{};
+	std::atomic<uint32_t> sequence{};
+	uint32_t              torn_reads{};      ///< copies taken again since the HID task wrote meanwhile
+	uint32_t              stale_frames{};    ///< frames which kept the previous snapshot
+
+	/// HID task only
+	void publish();
+
+	/// Game loop only, false if the snapshot is the previous one
+	auto take() -> bool;
+};
+
 struct context {
 	std::array<event_handler, MAX_EVENT_HANDLERS>  event_handlers{};
-	core::enum_array<action_type, action_info>     actions{};
+	state_exchange                                 input{};
+	binding_map                                    bindings{ binding_map::defaults() };
 	std::array<device_info, MAX_CONNECTED_DEVICES> devices{};
 	backend_mask                                   backends{};
 
@@ -66,6 +96,9 @@ struct context {
 
 	auto push_event_handler(const event_handler &handler) -> bool;
 	auto push_device(const device_info &device) -> bool;
+
+	/// HID task only: merges what the devices hold into the pending state and publishes it
+	void publish_devices();
 };
 
 } // namespace gzn::input
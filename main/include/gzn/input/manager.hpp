@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <string_view>
 
 #include "gzn/input/context.hpp"
 
@@ -21,6 +22,25 @@ public:
 
 	[[nodiscard]] static auto initialized_backends() -> backend_mask;
 
+	/**
+	 * @brief Takes the actions and keys the HID task published, lock-free
+	 * Call it once at the start of a frame: the queries below read this
+	 * snapshot, so they agree with each other during the frame.
+	 */
+	static void begin_frame();
+
+	/// Snapshot copies taken again since the HID task published meanwhile
+	[[nodiscard]] static auto torn_reads() -> uint32_t;
+	/// Frames which kept the previous snapshot after MAX_SNAPSHOT_RETRIES
+	[[nodiscard]] static auto stale_frames() -> uint32_t;
+
+	/// Raw keyboard keys by HID usage ID, whatever they're bound to
+	[[nodiscard]] static auto is_key_pressed(const uint8_t usage) -> bool;
+	/// Pressed or released between the last two begin_frame() calls
+	[[nodiscard]] static auto is_key_just_pressed(const uint8_t usage) -> bool;
+	[[nodiscard]] static auto is_key_just_released(const uint8_t usage) -> bool;
+	[[nodiscard]] static auto held_keys() -> const key_set &;
+
 	[[nodiscard]] static auto get_horizontal_action(const action_type action) -> int8_t;
 	[[nodiscard]] static auto get_vertical_action(const action_type action) -> int8_t;
 
@@ -36,6 +56,16 @@ public:
 		const uint64_t treshold = ACTION_JUST_THESHOLD_MICROSECONDS
 	) -> bool;
 
+	/// Replaces the bindings the config lists, see binding_map::parse()
+	[[nodiscard]] static auto load_bindings(const std::string_view file) -> bool;
+	static void reset_bindings();
+
+	static void bind_key(const uint8_t usage, const binding bound);
+	static void bind_button(const gamepad_button button, const binding bound);
+	static void bind_axis(const gamepad_axis axis, const action_type action);
+
+	[[nodiscard]] static auto bindings() -> const binding_map &;
+
 	[[nodiscard]] auto follow_connection_events(
 		connection_event_handler connection_handler,
 		disconnection_event_handler disconnection_handler,
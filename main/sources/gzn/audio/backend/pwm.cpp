@@ -6,6 +6,8 @@
 #include <algorithm>
 
 #include <esp_log.h>
+#include <esp_cpu.h>
+#include <esp_timer.h>
 #include <driver/ledc.h>
 #include <driver/gptimer.h>
 #include <soc/ledc_struct.h>
@@ -39,65 +41,93 @@ inline constexpr auto TIMER_NUM_ERROR { "PWM AUDIO TIMER NUMBER ERROR" };
 
 
 
-inline constexpr uint8_t    SPEAKER_PIN      {   41 };
-inline constexpr uint32_t   RINGBUFFER_LENGTH{ 4096 };
+inline constexpr auto       TIMER_ID         { LEDC_TIMER_0 };
+inline constexpr uint32_t   FRAME_BYTES      { BYTES_PER_SAMPLE * OUTPUT_CHANNELS };
+inline constexpr uint32_t   BLOCK_BYTES      { SAMPLE_BATCH_SIZE * FRAME_BYTES };
+inline constexpr uint32_t   RINGBUFFER_LENGTH{ BLOCK_BYTES * 4 }; ///< the same latency at any rate
 inline constexpr TickType_t SEND_TICKS{ portMAX_DELAY };
 
+#if defined(GZN_AUDIO_STEREO)
+inline constexpr std::array<int16_t,        OUTPUT_CHANNELS> SPEAKER_PINS    { 41, 42 };
+inline constexpr std::array<ledc_channel_t, OUTPUT_CHANNELS> SPEAKER_CHANNELS{
+	LEDC_CHANNEL_0, LEDC_CHANNEL_1
+};
+#else
+inline constexpr std::array<int16_t,        OUTPUT_CHANNELS> SPEAKER_PINS    { 41 };
+inline constexpr std::array<ledc_channel_t, OUTPUT_CHANNELS> SPEAKER_CHANNELS{ LEDC_CHANNEL_0 };
+#endif // defined(GZN_AUDIO_STEREO)
+
+// The ISR takes whole frames, so they must never be split by the wrap around
+static_assert(RINGBUFFER_LENGTH % FRAME_BYTES == 0);
+
 inline constexpr uint32_t BUFFER_MIN_SIZE    {  256 };
-inline constexpr uint32_t CHANNEL_LEFT_MASK  { 0x01 };
-inline constexpr uint32_t CHANNEL_RIGHT_MASK { 0x02 };
 
-inline constexpr uint32_t TIMER_RESOLUTION{ 80000000 / 16 };
+// The smallest prescaler, so the alarm period is close to the rate at 44.1 kHz too
+inline constexpr uint32_t TIMER_RESOLUTION{ APB_CLK_FREQ / 2 };
 inline constexpr uint32_t FREQUENCY{
 	APB_CLK_FREQ / static_cast<uint32_t>(1 << DUTY_RESOLUTION)
 };
 
-inline constexpr int8_t  SHIFT{ BITS_PER_SAMPLE / DUTY_RESOLUTION };
-inline constexpr int32_t NORMALIZE{ 0x7FFF };
+static_assert(APB_CLK_FREQ == PWM_SOURCE_CLOCK_HZ, "DUTY_RESOLUTION is derived from the wrong clock");
 
 portMUX_TYPE ringbuf_crit portMUX_INITIALIZER_UNLOCKED;
 
-using volumes_array = std::array<uint16_t, MAX_SOUND_TRACKS>;
-
 struct static_ringbuffer {
 	RingbufHandle_t     handle{};
 	StaticRingbuffer_t *info{};
 	uint8_t            *data{};
 };
 
+/// The block the ISR drains, borrowed from the ring till it's over
+struct isr_cursor {
+	void           *item{};
+	const uint16_t *duties{};
+	size_t          frames{};      ///< of the whole item
+	size_t          frames_left{};
+};
+
 struct data_t {
 	static_ringbuffer   ringbuf_info{};
 	ledc_timer_config_t ledc_timer{};      ///< ledc timer config
 	gptimer_handle_t    gptimer{};
 	uint32_t            framerate{};       ///< frame rates in Hz
 
-	volumes_array       volumes{};
-	int16_t             gpio{};
-	ledc_channel_t      channel{};
+	duty_array          duties{};
+	isr_cursor          cursor{};
+	backend_telemetry   telemetry{};
+	uint32_t            isr_calls{};
+	std::array<int16_t,        OUTPUT_CHANNELS> gpios{ SPEAKER_PINS };
+	std::array<ledc_channel_t, OUTPUT_CHANNELS> channels{ SPEAKER_CHANNELS };
 	status_t            status{ status_t::un_init };
+	volatile bool       streaming{ false }; ///< the mixer sends blocks, the ISR must not starve
 };
 
 data_t *g_pwm_audio_handle{};
 
 
-/**< ledc some register pointer */
-volatile uint32_t *g_ledc_conf0_val { nullptr };
-volatile uint32_t *g_ledc_conf1_val { nullptr };
-volatile uint32_t *g_ledc_duty_val  { nullptr };
+/**< ledc some register pointers, one set per output channel */
+struct ledc_registers {
+	volatile uint32_t *conf0_val{ nullptr };
+	volatile uint32_t *conf1_val{ nullptr };
+	volatile uint32_t *duty_val { nullptr };
+};
+
+std::array<ledc_registers, OUTPUT_CHANNELS> g_ledc_registers{};
 
 [[gnu::always_inline]]
-inline void load_registers(const size_t speed_mode, const size_t channel_id) {
+inline void load_registers(const size_t speed_mode, const size_t output, const size_t channel_id) {
 	auto &channel_group{ LEDC.channel_group[speed_mode] };
 	auto &channel{ channel_group.channel[channel_id] };
+	auto &registers{ g_ledc_registers[output] };
 
 #if defined(CONFIG_IDF_TARGET_ESP32P4) || defined(CONFIG_IDF_TARGET_ESP32C5) || defined(CONFIG_IDF_TARGET_ESP32C61)
-	g_ledc_left_duty_val = &channel.duty_init.val;
+	registers.duty_val = &channel.duty_init.val;
 #else
-	g_ledc_duty_val = &channel.duty.val;
+	registers.duty_val = &channel.duty.val;
 #endif // defined(CONFIG_IDF_TARGET_ESP32P4) || defined(CONFIG_IDF_TARGET_ESP32C5) || defined(CONFIG_IDF_TARGET_ESP32C61)
 
-	g_ledc_conf0_val = &channel.conf0.val;
-	g_ledc_conf1_val = &channel.conf1.val;
+	registers.conf0_val = &channel.conf0.val;
+	registers.conf1_val = &channel.conf1.val;
 }
 
 /*
@@ -105,32 +135,68 @@ inline void load_registers(const size_t speed_mode, const size_t channel_id) {
  * In order to improve efficiency, register is operated directly
  */
 [[gnu::always_inline]]
-inline void ledc_set_duty_fast(const uint32_t duty_val) {
-	*g_ledc_duty_val = (duty_val) << 4; /* Discard decimal part */
-	*g_ledc_conf0_val |= 0x00000014;
-	*g_ledc_conf1_val |= 0x80000000;
+inline void ledc_set_duty_fast(const ledc_registers &registers, const uint32_t duty_val) {
+	*registers.duty_val = (duty_val) << 4; /* Discard decimal part */
+	*registers.conf0_val |= 0x00000014;
+	*registers.conf1_val |= 0x80000000;
 }
 
+[[gnu::always_inline]]
+inline void ledc_set_frame_fast(const uint16_t *duties) {
+	for (size_t output{}; output < OUTPUT_CHANNELS; ++output) {
+		ledc_set_duty_fast(g_ledc_registers[output], duties[output]);
+	}
+}
+
+/**
+ * Takes a whole contiguous block from the ring at once and then outputs one
+ * frame per call, so the ring is touched once per block instead of per sample.
+ */
 bool IRAM_ATTR timer_group_isr(
 	gptimer_handle_t, const gptimer_alarm_event_data_t *, void *
 ) {
-	auto rb{ g_pwm_audio_handle->ringbuf_info.handle };
-	size_t received{};
-	const auto item{ xRingbufferReceiveUpToFromISR(rb, &received, BYTES_PER_SAMPLE) };
-	if (item == nullptr) {
-		ledc_set_duty_fast(0u);
-		return true;
+	auto &handle{ *g_pwm_audio_handle };
+	const auto sampled{ handle.isr_calls++ % ISR_SAMPLING_PERIOD == 0 };
+	const auto begin{ sampled ? esp_cpu_get_cycle_count() : 0u };
+
+	auto &cursor{ handle.cursor };
+	auto higher_priority_task_woken{ pdFALSE };
+	if (cursor.frames_left == 0) [[unlikely]] {
+		auto rb{ handle.ringbuf_info.handle };
+		if (cursor.item != nullptr) {
+			vRingbufferReturnItemFromISR(rb, std::exchange(cursor.item, nullptr), &higher_priority_task_woken);
+		}
+
+		size_t received{};
+		cursor.item        = xRingbufferReceiveUpToFromISR(rb, &received, BLOCK_BYTES);
+		cursor.duties      = static_cast<const uint16_t *>(cursor.item);
+		cursor.frames      = received / FRAME_BYTES;
+		cursor.frames_left = cursor.frames;
 	}
-	/// @todo What if we received less amount?
 
-	ledc_set_duty_fast(*reinterpret_cast<int16_t*>(item));
+	if (cursor.frames_left == 0) [[unlikely]] {
+		static constexpr std::array<uint16_t, OUTPUT_CHANNELS> silence{ [] {
+			std::array<uint16_t, OUTPUT_CHANNELS> frame{};
+			frame.fill(SILENCE_DUTY);
+			return frame;
+		}() };
+		ledc_set_frame_fast(std::data(silence));
+		if (handle.streaming) {
+			handle.streaming = false; // once per starvation, send_block() re-arms it
+			handle.telemetry.add_underrun(esp_timer_get_time());
+		}
+		return pdTRUE == higher_priority_task_woken;
+	}
 
-	auto higher_priority_task_woken{ pdFALSE };
-	vRingbufferReturnItemFromISR(rb, item, &higher_priority_task_woken);
-	if (pdTRUE == higher_priority_task_woken) {
-		portYIELD_FROM_ISR();
+	ledc_set_frame_fast(cursor.duties);
+	cursor.duties += OUTPUT_CHANNELS;
+	--cursor.frames_left;
+
+	if (sampled) {
+		handle.telemetry.isr_cycles.add(esp_cpu_get_cycle_count() - begin);
 	}
-	return true;
+	// The driver yields on true, so never ask for it without a reason
+	return pdTRUE == higher_priority_task_woken;
 }
 
 esp_err_t set_sample_rate(const sample_rate rate) {
@@ -192,15 +258,14 @@ auto pwm::startup() -> startup_result {
 			.data{ ringbuffer_storage }
 		},
 		.ledc_timer{
-			.duty_resolution{ DUTY_RESOLUTION },
+			.duty_resolution{ static_cast<ledc_timer_bit_t>(DUTY_RESOLUTION) },
 			.timer_num      { TIMER_ID },
 			.freq_hz        { FREQUENCY - (FREQUENCY % 1000) }, // fixed PWM frequency, It's a multiple of 1000
 #if defined(CONFIG_IDF_TARGET_ESP32S2)
 			.clk_cfg        { LEDC_USE_APB_CLK },
 #endif // defined(CONFIG_IDF_TARGET_ESP32S2)
 		},
-		.gpio{ SPEAKER_PIN },
-		.channel{ LEDC_CHANNEL_0 },
+		.telemetry{ .ring_size{ RINGBUFFER_LENGTH } },
 	} };
 
 	g_pwm_audio_handle = handle;
@@ -211,29 +276,31 @@ auto pwm::startup() -> startup_result {
 
 
 	/**
-	 * config ledc to generate pwm
+	 * config ledc to generate pwm, both channels share the timer
 	 */
-	const auto gpio_num{ handle->gpio };
-	if (gpio_num < GPIO_NUM_0 || gpio_num > GPIO_NUM_MAX) {
-		return startup_result::invalid_arguments;
-	}
-
-	const ledc_channel_config_t channel_config{
-		.gpio_num  { static_cast<int>(gpio_num) },
-		.speed_mode{ handle->ledc_timer.speed_mode },
-		.channel   { handle->channel },
-		.intr_type { LEDC_INTR_DISABLE },
-		.timer_sel { TIMER_ID }
-	};
-	PWMA_CHECK(ESP_OK == ledc_channel_config(&channel_config),
-		"LEDC channel left configuration failed",
-		startup_result::invalid_arguments
-	);
+	for (size_t output{}; output < OUTPUT_CHANNELS; ++output) {
+		const auto gpio_num{ handle->gpios[output] };
+		if (gpio_num < GPIO_NUM_0 || gpio_num > GPIO_NUM_MAX) {
+			return startup_result::invalid_arguments;
+		}
 
-	/**
-	 * Get the address of LEDC register to reduce the addressing time
-	 */
-	load_registers(handle->ledc_timer.speed_mode, handle->channel);
+		const ledc_channel_config_t channel_config{
+			.gpio_num  { static_cast<int>(gpio_num) },
+			.speed_mode{ handle->ledc_timer.speed_mode },
+			.channel   { handle->channels[output] },
+			.intr_type { LEDC_INTR_DISABLE },
+			.timer_sel { TIMER_ID }
+		};
+		PWMA_CHECK(ESP_OK == ledc_channel_config(&channel_config),
+			"LEDC channel configuration failed",
+			startup_result::invalid_arguments
+		);
+
+		/**
+		 * Get the address of LEDC register to reduce the addressing time
+		 */
+		load_registers(handle->ledc_timer.speed_mode, output, handle->channels[output]);
+	}
 
 	const gptimer_config_t timer_config{
 		.clk_src      { GPTIMER_CLK_SRC_DEFAULT },
@@ -250,10 +317,6 @@ auto pwm::startup() -> startup_result {
 	res = gptimer_register_event_callbacks(handle->gptimer, &cbs, nullptr);
 	// PWMA_CHECK(ESP_OK == res, "gptimer register event callback failed", res);
 
-	for (size_t i{}; i < std::size(handle->volumes); ++i) {
-		set_track_volume(i, 0);
-	}
-
 	/**< set a initial parameter */
 	res = set_sample_rate(SAMPLE_RATE);
 	// PWMA_CHECK(ESP_OK == res, "Set parameter failed", ESP_FAIL);
@@ -272,10 +335,12 @@ void pwm::shutdown() {
 	const auto res{ gptimer_del_timer(handle->gptimer) };
 	// PWMA_CHECK(ESP_OK == res, "gptimer del failed", res);
 
-	const auto gpio_num{ handle->gpio };
-	if (gpio_num < GPIO_NUM_0 || gpio_num > GPIO_NUM_MAX) {
-		ledc_stop(handle->ledc_timer.speed_mode, handle->channel, 0);
-		gpio_set_direction(static_cast<gpio_num_t>(gpio_num), GPIO_MODE_INPUT);
+	for (size_t output{}; output < OUTPUT_CHANNELS; ++output) {
+		const auto gpio_num{ handle->gpios[output] };
+		if (gpio_num < GPIO_NUM_0 || gpio_num > GPIO_NUM_MAX) {
+			ledc_stop(handle->ledc_timer.speed_mode, handle->channels[output], 0);
+			gpio_set_direction(static_cast<gpio_num_t>(gpio_num), GPIO_MODE_INPUT);
+		}
 	}
 
 	portENTER_CRITICAL(&ringbuf_crit);
@@ -317,6 +382,10 @@ void pwm::stop() {
 	// Flushing buffer
 	UBaseType_t items;
 	auto &rb{ handle->ringbuf_info.handle };
+	if (handle->cursor.item != nullptr) {
+		vRingbufferReturnItem(rb, std::exchange(handle->cursor.item, nullptr));
+	}
+	handle->cursor = {};
 	vRingbufferGetInfo(rb, nullptr, nullptr, nullptr, nullptr, &items);
 
 	size_t len{};
@@ -336,53 +405,46 @@ auto pwm::status() -> status_t {
 	return g_pwm_audio_handle->status;
 }
 
-void pwm::set_track_volume(const track_id track, const uint8_t value) {
-	if (track >= MAX_SOUND_TRACKS) {
-		return;
+void pwm::send_block(std::span<const int16_t> samples) {
+	auto &handle{ *g_pwm_audio_handle };
+
+	const auto count{ std::min(std::size(samples), std::size(handle.duties)) };
+	format(samples.first(count), handle.duties);
+
+	auto &stats{ handle.telemetry };
+	const auto rb{ handle.ringbuf_info.handle };
+	if (handle.streaming) { // the first block after the idle always finds it empty
+		stats.ring_low = std::min<uint32_t>(stats.ring_low,
+			RINGBUFFER_LENGTH - xRingbufferGetCurFreeSize(rb)
+		);
 	}
 
-	const auto clamped_volume{ std::clamp<int16_t>(value, -VOLUME_0DB, VOLUME_0DB) };
-	g_pwm_audio_handle->volumes[track] = (clamped_volume + VOLUME_0DB) / VOLUME_0DB;
-}
+	xRingbufferSend(rb, std::data(handle.duties), count * sizeof(handle.duties[0]), SEND_TICKS);
+	handle.streaming = true;
 
-void pwm::send_sample(std::span<const int16_t> samples) {
-	auto &rb{ g_pwm_audio_handle->ringbuf_info.handle };
+	stats.ring_high = std::max<uint32_t>(stats.ring_high,
+		RINGBUFFER_LENGTH - xRingbufferGetCurFreeSize(rb)
+	);
+}
 
-	const auto volume{ g_pwm_audio_handle->volumes.front() };
-	for (size_t i{}; i < std::size(samples); ++i) {
-		const auto value{ static_cast<uint16_t>(
-			(samples[i] * volume + NORMALIZE) >> SHIFT
-		) };
+void pwm::idle() {
+	g_pwm_audio_handle->streaming = false;
+}
 
-		xRingbufferSend(rb, &value, sizeof(value), SEND_TICKS);
-	}
+auto pwm::queued_frames() -> uint32_t {
+	const auto &handle{ *g_pwm_audio_handle };
+	// The item borrowed by the ISR isn't free till it's over, its played part is
+	const auto used_bytes{ RINGBUFFER_LENGTH - xRingbufferGetCurFreeSize(handle.ringbuf_info.handle) };
+	const auto played{ handle.cursor.frames - handle.cursor.frames_left };
+	return static_cast<uint32_t>(used_bytes / FRAME_BYTES - std::min(played, used_bytes / FRAME_BYTES));
 }
 
-void pwm::send_samples(
-	const std::array<samples_array, MAX_SOUND_TRACKS> &samples_batch,
-	const std::array<size_t,        MAX_SOUND_TRACKS> &batch_sizes,
-	const size_t max_batch_size,
-	const uint16_t active_batches_count
-) {
-	const auto &volumes{ g_pwm_audio_handle->volumes };
-	auto &rb{ g_pwm_audio_handle->ringbuf_info.handle };
-
-	uint16_t value;
-	int16_t mixed_sample{};
-	for (size_t i{}; i < max_batch_size; ++i) {
-		for (size_t batch_id{}; batch_id < std::size(samples_batch); ++batch_id) {
-			if (i >= batch_sizes[batch_id]) {
-				continue;
-			}
-
-			mixed_sample += (samples_batch[batch_id][i] / active_batches_count)
-				* volumes[batch_id];
-		}
+auto pwm::telemetry() -> backend_telemetry {
+	return g_pwm_audio_handle->telemetry;
+}
 
-		value = static_cast<uint16_t>((mixed_sample + NORMALIZE) >> SHIFT);
-		xRingbufferSend(rb, &value, sizeof(value), SEND_TICKS);
-	}
+void pwm::reset_telemetry() {
+	g_pwm_audio_handle->telemetry = backend_telemetry{ .ring_size{ RINGBUFFER_LENGTH } };
 }
 
 } // namespace gzn::audio
-
@@ -1,14 +1,18 @@
 #include <span>
+#include <atomic>
 #include <cstdio>
 #include <cerrno>
 #include <cstring>
 #include <utility>
+#include <algorithm>
 #include <esp_log.h>
+#include <sdkconfig.h>
+#include <esp_timer.h>
 
 #include "gzn/audio/manager.hpp"
 
 #include "gzn/utils.hpp"
-#include "gzn/audio/wav-format.hpp"
+#include "gzn/audio/mixer.hpp"
 #include "gzn/audio/backend/pwm.hpp"
 
 namespace gzn::audio {
@@ -17,38 +21,68 @@ namespace {
 
 inline constexpr auto TAG{ "gzn::audio" };
 
-struct file_info {
-	std::FILE        *file_descr{ nullptr };
-	SemaphoreHandle_t file_guard{};
-	size_t            content_offset{}; ///< if not 0, then it's looping file
+inline constexpr uint64_t CPU_FREQUENCY_HZ{ CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1'000'000ull };
+inline constexpr int64_t  MAX_SCHEDULE_AHEAD_US{ 10'000'000 }; ///< keeps the frames wrap-safe
+#if defined(GZN_AUDIO_MEASURE)
+inline constexpr int64_t  MEASURE_PERIOD_US{ 5'000'000 };
+#endif // defined(GZN_AUDIO_MEASURE)
+
+struct sound_streaming_task_context {
+	std::array<voice_state,       MAX_SOUND_TRACKS> voices{};
+	std::array<SemaphoreHandle_t, MAX_SOUND_TRACKS> file_guards{};
+	audio::mixer                                    mixer{};
+	tracker                                         music{};
+	SemaphoreHandle_t                               music_guard{};
+	uint8_t                                        *music_data{};
+	int8_t                                          music_volume{};
+	output_array                                    output{};
+	audio::telemetry                                telemetry{};
+	uint32_t                                        mixed_blocks{};
+	uint32_t                                        output_frames{}; ///< sent to the backend, the timeline
+	uint8_t                                         voices_count{ MAX_SOUND_TRACKS };
 
 	[[gnu::always_inline]]
-	inline void close(const BaseType_t delay = portMAX_DELAY) {
-		xSemaphoreTake(file_guard, delay);
-		content_offset = 0;
-		std::fclose(std::exchange(file_descr, nullptr));
-		xSemaphoreGive(file_guard);
+	inline auto active_voices() const -> std::span<const voice_state> {
+		return std::span{ std::data(voices), voices_count };
+	}
+
+	[[gnu::always_inline]]
+	inline void close(const size_t index, const BaseType_t delay = portMAX_DELAY) {
+		xSemaphoreTake(file_guards[index], delay);
+		voices[index].close();
+		xSemaphoreGive(file_guards[index]);
 	}
 };
 
-struct sound_streaming_task_context {
-	std::array<file_info,     MAX_SOUND_TRACKS> streams{};
-	std::array<samples_array, MAX_SOUND_TRACKS> batches{};
-	std::array<size_t,        MAX_SOUND_TRACKS> batches_sizes{};
+struct sound_event {
+	sound_event_info                        info{};
+	wav::layout                             layout{}; ///< parsed on the first play
+	std::array<track_id, MAX_SOUND_TRACKS>  instances{};
+	track_id                                last_track{ INVALID_TRACK_ID };
+	int64_t                                 last_trigger_us{};
+};
+
+struct sound_effect {
+	sfx_params         params{};
+	std::span<int16_t> samples{}; ///< empty till rendered
 };
 
 struct pwm_context {
 	sound_streaming_task_context sound_streaming_context{};
 	portMUX_TYPE                 file_guard_lock portMUX_INITIALIZER_UNLOCKED;
 	TaskHandle_t                 sound_streaming_handle{};
+	TaskHandle_t                 prefetch_handle{};
+	std::array<sound_event, MAX_SOUND_EVENTS> events{};
+	uint8_t                      events_count{};
+	std::array<sound_effect, MAX_SFX> effects{};
+	uint8_t                      effects_count{};
 	uint32_t                     tracks_bitset{};
+	std::atomic<bool>            mixer_idle{ false }; ///< waits for the prefetcher to push something
+	uint32_t                     reported_underruns{};
+	uint32_t                     reported_backend_underruns{};
+	int64_t                      measured_at{};
 	bool                         running{ true };
 
-	[[gnu::always_inline]]
-	inline auto can_add_track() const -> bool {
-		return (tracks_bitset & SOUND_TRACKS_MASK) != SOUND_TRACKS_MASK;
-	}
-
 	[[gnu::always_inline]]
 	inline auto is_track_booked(const size_t index) const -> bool {
 		return static_cast<bool>(tracks_bitset & (1 << index));
@@ -65,13 +99,11 @@ struct pwm_context {
 	}
 
 	[[gnu::always_inline]]
-	inline auto get_available_track_id() const -> size_t {
-		for (size_t i{}; i < MAX_SOUND_TRACKS; ++i) {
-			if (!(tracks_bitset & (1 << i))) {
-				return i;
-			}
-		}
-		return MAX_SOUND_TRACKS;
+	inline auto is_valid(const track_id track) const -> bool {
+		const auto index{ track_index(track) };
+		return index < sound_streaming_context.voices_count
+			&& is_track_booked(index)
+			&& sound_streaming_context.voices[index].generation == track_generation(track);
 	}
 };
 
@@ -84,52 +116,50 @@ void IRAM_ATTR sound_streaming_task(void *user) {
 
 	auto &ctx{ *reinterpret_cast<sound_streaming_task_context *>(user) };
 
-	auto &batches_sizes{ ctx.batches_sizes };
-	auto &batches{ ctx.batches };
-
 	while (backend_ctx->running) {
-		// STEP 0. Fetch data from files & manage their EOFs
-
-		size_t max_batch_size{};
-		size_t active_batches_count{};
-		size_t last_batch_id{};
-		for (size_t i{}; i < std::size(batches); ++i) {
-			auto &stream{ ctx.streams[i] };
-
-			if (stream.file_descr == nullptr) {
-				batches_sizes[i] = 0;
+		const auto begin{ esp_timer_get_time() };
+
+		// STEP 0. Take prefetched data, the files are read by prefetch_task
+		bool scheduled{ false };
+		for (size_t i{}; i < ctx.voices_count; ++i) {
+			auto &voice{ ctx.voices[i] };
+			if (!voice.busy()) {
+				ctx.mixer.skip(i);
 				continue;
 			}
-			if (pdFALSE == xSemaphoreTake(stream.file_guard, file_guard_timeout)) {
-				continue;
-			}
-			const utils::defer_semaphore_giver defer{ stream.file_guard };
 
-			last_batch_id = i;
-			++active_batches_count;
-			batches_sizes[i] = std::fread(
-				std::data(batches[i]), sizeof(batches[i][0]),
-				std::size(batches[i]), stream.file_descr
-			);
-			if (max_batch_size < batches_sizes[i]) {
-				max_batch_size = batches_sizes[i];
-			}
+			ctx.mixer.fetch(i, voice, ctx.output_frames);
+			scheduled |= voice.scheduled;
 
-			if (!std::feof(stream.file_descr)) {
-				continue;
-			}
-
-			if (0 != stream.content_offset
-			&&  0 == std::fseek(stream.file_descr, stream.content_offset, SEEK_SET)
-			) [[likely]] {
-				continue;
+			// Never wait for the reader here, just try again the next block
+			if (voice.swap_due() && pdTRUE == xSemaphoreTake(ctx.file_guards[i], 0)) {
+				voice.swap();
+				xSemaphoreGive(ctx.file_guards[i]);
 			}
-
-			std::fclose(std::exchange(stream.file_descr, nullptr));
+		}
+		xTaskNotifyGive(backend_ctx->prefetch_handle);
+
+		// STEP 1. Synthesise the music
+		if (ctx.music.is_playing() && pdTRUE == xSemaphoreTake(ctx.music_guard, file_guard_timeout)) {
+			const utils::defer_semaphore_giver defer{ ctx.music_guard };
+			ctx.mixer.fetch_music(ctx.music, ctx.music_volume);
+		} else {
+			ctx.mixer.skip(MUSIC_TRACK);
 		}
 
-		if (active_batches_count == 0 || max_batch_size == 0) {
-			vTaskDelay(100_ms);
+		// STEP 2. Mix & send
+		auto mixed{ ctx.mixer.mix(ctx.output) };
+		if (mixed == 0 && scheduled) {
+			// Silence keeps the timeline going till the scheduled voices start
+			std::ranges::fill(ctx.output, int16_t{});
+			mixed = SAMPLE_BATCH_SIZE;
+		}
+		if (mixed == 0) {
+			backend::idle();
+			// The prefetcher wakes us up once a started voice has its first batch
+			backend_ctx->mixer_idle.store(true, std::memory_order_release);
+			ulTaskNotifyTake(pdTRUE, 100_ms);
+			backend_ctx->mixer_idle.store(false, std::memory_order_relaxed);
 			// if (backend::status() == status_t::busy) {
 			// 	backend::stop();
 			// }
@@ -139,22 +169,182 @@ void IRAM_ATTR sound_streaming_task(void *user) {
 		// 	backend::start();
 		// }
 
+		ctx.telemetry.add_block(ctx.mixer.batches_sizes,
+			static_cast<uint32_t>(esp_timer_get_time() - begin)
+		);
+		++ctx.mixed_blocks;
+		backend::send_block(std::span{ std::data(ctx.output), mixed * OUTPUT_CHANNELS });
+		ctx.output_frames += static_cast<uint32_t>(mixed);
+	}
+}
 
-		if (active_batches_count == 1) {
-			backend::send_sample(std::span{
-				std::data(batches[last_batch_id]),
-				batches_sizes[last_batch_id]
-			});
-			continue;
+void prefetch_task(void *user) {
+	using namespace utils::literals;
+
+	constexpr auto file_guard_timeout{ 100 };
+
+	auto &ctx{ *reinterpret_cast<sound_streaming_task_context *>(user) };
+
+	while (backend_ctx->running) {
+		bool prefetched{ false };
+		for (size_t i{}; i < ctx.voices_count; ++i) {
+			const auto guard{ ctx.file_guards[i] };
+			if (pdFALSE == xSemaphoreTake(guard, file_guard_timeout)) {
+				continue;
+			}
+			const utils::defer_semaphore_giver defer{ guard };
+
+			prefetched |= ctx.voices[i].prefetch();
+		}
+		if (prefetched && backend_ctx->mixer_idle.exchange(false, std::memory_order_acq_rel)) {
+			xTaskNotifyGive(backend_ctx->sound_streaming_handle);
 		}
 
-		backend::send_samples(
-			batches,
-			batches_sizes,
-			max_batch_size,
-			active_batches_count
+		// All rings are full (or idle), sleep till the mixer takes something
+		if (!prefetched) {
+			ulTaskNotifyTake(pdTRUE, 20_ms);
+		}
+	}
+}
+
+void log_open_error(const track_info &info, const open_result result) {
+	const auto length{ static_cast<int>(std::size(info.filename)) };
+	const auto name{ std::data(info.filename) };
+
+	switch (result) {
+		case open_result::cannot_open:
+			ESP_LOGW(TAG, R"(Cannot open "%.*s" audio file: %s)",
+				length, name, std::strerror(errno)
+			);
+			break;
+
+		case open_result::too_small:
+			ESP_LOGW(TAG, R"(File "%.*s" has no samples)",
+				length, name
+			);
+			break;
+
+		case open_result::corrupted:
+			ESP_LOGW(TAG, R"(File "%.*s" is not a valid WAV file)",
+				length, name
+			);
+			break;
+
+		case open_result::unsupported_format:
+			ESP_LOGE(TAG, R"(Sound "%.*s" has to be %u Hz %u BPS PCM of up to %u channels.)",
+				length, name, static_cast<unsigned>(std::to_underlying(SAMPLE_RATE)),
+				BITS_PER_SAMPLE, MAX_SOURCE_CHANNELS
+			);
+			break;
+
+		default: break;
+	}
+}
+
+/// Reads the whole file into the heap. The caller owns the memory
+auto load_file(const std::string_view filename) -> std::span<uint8_t> {
+	auto file{ std::fopen(std::data(filename), "rb") };
+	if (!file) {
+		ESP_LOGW(TAG, R"(Cannot open "%.*s" file: %s)",
+			static_cast<int>(std::size(filename)), std::data(filename), std::strerror(errno)
+		);
+		return {};
+	}
+
+	std::fseek(file, 0, SEEK_END);
+	const auto size{ std::ftell(file) };
+	std::fseek(file, 0, SEEK_SET);
+
+	auto data{ size > 0 ? static_cast<uint8_t *>(heap_caps_malloc(size, MALLOC_CAP_8BIT)) : nullptr };
+	if (data == nullptr || std::fread(data, 1, size, file) != static_cast<size_t>(size)) {
+		ESP_LOGW(TAG, R"(Cannot load %ld bytes of "%.*s" file)", size,
+			static_cast<int>(std::size(filename)), std::data(filename)
 		);
+		heap_caps_free(data);
+		std::fclose(file);
+		return {};
 	}
+
+	std::fclose(file);
+	return std::span{ data, static_cast<size_t>(size) };
+}
+
+/**
+ * @brief Selects a voice and starts the stream on it
+ * @param open `(stream_info &) -> open_result`, called once the voice is found
+ */
+template<class Opener>
+auto play_stream(const track_info &info, Opener &&open) -> track_id {
+	auto &ctx{ backend_ctx->sound_streaming_context };
+
+	const auto index{ select_voice(ctx.active_voices(), backend_ctx->tracks_bitset, info.priority) };
+	if (index == NO_VOICE) [[unlikely]] {
+		ESP_LOGW(TAG, R"(No voice with priority <= %u to play "%.*s" sound)",
+			info.priority,
+			static_cast<int>(std::size(info.filename)), std::data(info.filename)
+		);
+		return INVALID_TRACK_ID;
+	}
+
+	stream_info stream{};
+	if (const auto result{ open(stream) }; result != open_result::ok) [[unlikely]] {
+		log_open_error(info, result);
+		return INVALID_TRACK_ID;
+	}
+
+	using namespace utils::literals;
+	constexpr auto file_guard_timeout{ 50_ms };
+
+	const auto guard{ ctx.file_guards[index] };
+	if (pdFALSE == xSemaphoreTake(guard, file_guard_timeout)) [[unlikely]] {
+		stream.close();
+		return INVALID_TRACK_ID;
+	}
+	const utils::defer_semaphore_giver defer{ guard };
+
+	auto &voice{ ctx.voices[index] };
+	voice.start(std::move(stream), ctx.mixed_blocks);
+	backend_ctx->book_track(index);
+	xTaskNotifyGive(backend_ctx->prefetch_handle);
+	return make_track_id(index, voice.generation);
+}
+
+/// Parses the file if @p layout is empty
+auto play_stream(const track_info &info, wav::layout &layout) -> track_id {
+	return play_stream(info, [&](stream_info &stream) {
+		return open_stream(info, stream, layout);
+	});
+}
+
+/// Output timeline frame which reaches the speaker at @p timestamp_us
+auto frame_at(const int64_t timestamp_us) -> uint32_t {
+	const auto &ctx{ backend_ctx->sound_streaming_context };
+	const auto ahead_us{ std::clamp<int64_t>(
+		timestamp_us - esp_timer_get_time(), 0, MAX_SCHEDULE_AHEAD_US
+	) };
+	// The queued frames play first, the frame after them is on the speaker right now
+	const auto playing{ ctx.output_frames - backend::queued_frames() };
+	return playing + static_cast<uint32_t>(ahead_us * std::to_underlying(SAMPLE_RATE) / 1'000'000);
+}
+
+auto render_effect(sound_effect &effect) -> bool {
+	const auto length{ sfx_length(effect.params) };
+	auto data{ length != 0
+		? static_cast<int16_t *>(heap_caps_malloc(length * sizeof(int16_t), MALLOC_CAP_8BIT))
+		: nullptr
+	};
+	if (data == nullptr) [[unlikely]] {
+		ESP_LOGW(TAG, "Cannot allocate %zu samples of the sound effect", length);
+		return false;
+	}
+
+	const auto begin{ esp_timer_get_time() };
+	const auto rendered{ render_sfx(effect.params, std::span{ data, length }) };
+	effect.samples = std::span{ data, rendered };
+	ESP_LOGD(TAG, "Rendered %zu samples of the sound effect in %lld us",
+		rendered, esp_timer_get_time() - begin
+	);
+	return true;
 }
 
 } // namespace
@@ -171,6 +361,11 @@ auto manager::initialize(const setup_info &info) -> startup_result {
 		return startup_result::already_started;
 	}
 
+	if (info.voices == 0) {
+		ESP_LOGE(TAG, "At least one voice is required!");
+		return startup_result::invalid_arguments;
+	}
+
 	auto backend_storage{ heap_caps_malloc(sizeof(pwm_context),
 		MALLOC_CAP_8BIT | MALLOC_CAP_SIMD
 	) };
@@ -181,15 +376,32 @@ auto manager::initialize(const setup_info &info) -> startup_result {
 		return startup_result::not_enough_memory;
 	}
 
-	for (auto &info : backend_ctx->sound_streaming_context.streams) {
+	auto &ctx{ backend_ctx->sound_streaming_context };
+	ctx.voices_count       = static_cast<uint8_t>(std::clamp<size_t>(info.voices, 1, MAX_VOICES));
+	ctx.telemetry.since_us = esp_timer_get_time();
+
+	for (auto &guard : ctx.file_guards) {
 		portENTER_CRITICAL(&backend_ctx->file_guard_lock);
-		info.file_guard = xSemaphoreCreateMutex();
+		guard = xSemaphoreCreateMutex();
 		portEXIT_CRITICAL(&backend_ctx->file_guard_lock);
 	}
+	ctx.music_guard = xSemaphoreCreateMutex();
+
+	// The reader goes first, the mixer notifies it from the very first block
+	const auto prefetch_status{ xTaskCreatePinnedToCore(
+		prefetch_task, "audio_prefetch_task",
+		PREFETCH_TASK_STACK_DEPTH, &ctx,
+		PREFETCH_TASK_PRIORITY, &backend_ctx->prefetch_handle,
+		PREFETCH_TASK_CORE_ID
+	) };
+	if (prefetch_status != pdPASS) {
+		destroy();
+		return startup_result::cannot_create_task;
+	}
 
 	const auto status{ xTaskCreatePinnedToCore(
 		sound_streaming_task, "sound_streaming_task",
-		SOUND_TASK_STACK_DEPTH, &backend_ctx->sound_streaming_context,
+		SOUND_TASK_STACK_DEPTH, &ctx,
 		SOUND_TASK_PRIORITY, &backend_ctx->sound_streaming_handle,
 		SOUND_TASK_CORE_ID
 	) };
@@ -206,21 +418,33 @@ void manager::destroy() {
 
 	backend_ctx->running = false;
 
-	for (auto &info : backend_ctx->sound_streaming_context.streams) {
-		if (info.file_descr) {
-			info.close(1000_ms);
-		}
+	auto &ctx{ backend_ctx->sound_streaming_context };
+	for (size_t i{}; i < std::size(ctx.voices); ++i) {
+		ctx.close(i, 1000_ms);
 	}
 
+	stop_music();
+
 	vTaskDelay(100_ms);
 
-	for (auto &info : backend_ctx->sound_streaming_context.streams) {
+	// The voices are closed, nothing streams the effects anymore
+	for (auto &effect : std::span{ backend_ctx->effects }.first(backend_ctx->effects_count)) {
+		heap_caps_free(std::data(effect.samples));
+	}
+
+	for (auto &guard : ctx.file_guards) {
 		portENTER_CRITICAL(&backend_ctx->file_guard_lock);
-		vSemaphoreDelete(info.file_guard);
+		vSemaphoreDelete(guard);
 		portEXIT_CRITICAL(&backend_ctx->file_guard_lock);
 	}
+	vSemaphoreDelete(ctx.music_guard);
 
-	vTaskDelete(backend_ctx->sound_streaming_handle);
+	if (backend_ctx->sound_streaming_handle) {
+		vTaskDelete(backend_ctx->sound_streaming_handle);
+	}
+	if (backend_ctx->prefetch_handle) {
+		vTaskDelete(backend_ctx->prefetch_handle);
+	}
 
 	heap_caps_free(std::exchange(backend_ctx, nullptr));
 
@@ -229,117 +453,295 @@ void manager::destroy() {
 
 
 void manager::update() {
-	const auto &streams{ backend_ctx->sound_streaming_context.streams };
-	for (size_t i{}; i < std::size(streams); ++i) {
-		if (streams[i].file_descr == nullptr) {
+	const auto &ctx{ backend_ctx->sound_streaming_context };
+	for (size_t i{}; i < ctx.voices_count; ++i) {
+		if (!ctx.voices[i].busy()) {
 			backend_ctx->unbook_track(i);
 		}
 	}
+
+	if (const auto underruns{ prefetch_underruns() }; underruns != backend_ctx->reported_underruns) {
+		ESP_LOGW(TAG, "Audio prefetch underruns: %lu (+%lu)",
+			underruns, underruns - backend_ctx->reported_underruns
+		);
+		backend_ctx->reported_underruns = underruns;
+	}
+
+	if (const auto underruns{ backend::telemetry().underruns }; underruns != backend_ctx->reported_backend_underruns) {
+		ESP_LOGW(TAG, "Audio output underruns: %lu (+%lu)",
+			underruns, underruns - backend_ctx->reported_backend_underruns
+		);
+		backend_ctx->reported_backend_underruns = underruns;
+	}
+
+#if defined(GZN_AUDIO_MEASURE)
+	if (const auto now{ esp_timer_get_time() }; now - backend_ctx->measured_at >= MEASURE_PERIOD_US) {
+		backend_ctx->measured_at = now;
+		const auto usage{ query_cpu_usage() };
+		ESP_LOGI(TAG, "%lu Hz, %u-bit duty, %u frames/block: ISR %u.%u%%, mixer %u.%u%%",
+			usage.sample_rate, DUTY_RESOLUTION, static_cast<unsigned>(SAMPLE_BATCH_SIZE),
+			usage.isr_permille   / 10, usage.isr_permille   % 10,
+			usage.mixer_permille / 10, usage.mixer_permille % 10
+		);
+	}
+#endif // defined(GZN_AUDIO_MEASURE)
 }
 
 auto manager::play(const track_info &info) -> track_id {
-	if (!backend_ctx->can_add_track()) [[unlikely]] {
-		ESP_LOGW(TAG, R"(No available space to load "%.*s" sound)",
-			static_cast<int>(std::size(info.filename)), std::data(info.filename)
+	wav::layout layout{};
+	return play_stream(info, layout);
+}
+
+auto manager::play_at(const track_info &info, const int64_t timestamp_us) -> track_id {
+	wav::layout layout{};
+	return play_stream(info, [&](stream_info &stream) {
+		const auto result{ open_stream(info, stream, layout) };
+		// Opening took a while, so the timeline is read afterwards
+		const auto frame{ frame_at(timestamp_us) };
+		const auto &ctx{ backend_ctx->sound_streaming_context };
+		if (result == open_result::ok && static_cast<int32_t>(frame - ctx.output_frames) >= 0) {
+			stream.schedule(frame);
+		}
+		return result;
+	});
+}
+
+auto manager::output_latency_us() -> uint32_t {
+	// The block being mixed and then everything queued before it
+	const auto frames{ uint64_t{ backend::queued_frames() } + SAMPLE_BATCH_SIZE };
+	return static_cast<uint32_t>(frames * 1'000'000u / std::to_underlying(SAMPLE_RATE));
+}
+
+auto manager::register_event(const sound_event_info &info) -> sound_event_id {
+	if (backend_ctx->events_count >= MAX_SOUND_EVENTS) [[unlikely]] {
+		ESP_LOGW(TAG, R"(Cannot register "%.*s" sound event, %zu is max)",
+			static_cast<int>(std::size(info.track.filename)), std::data(info.track.filename),
+			MAX_SOUND_EVENTS
 		);
-		return INVALID_TRACK_ID;
+		return INVALID_SOUND_EVENT;
 	}
 
-	using namespace utils::literals;
-	constexpr auto file_guard_timeout{ 50_ms };
+	auto &event{ backend_ctx->events[backend_ctx->events_count] };
+	event = sound_event{ .info{ info } };
+	event.info.max_instances = std::clamp<uint8_t>(info.max_instances, 1, MAX_VOICES);
+	event.instances.fill(INVALID_TRACK_ID);
+	event.last_trigger_us = esp_timer_get_time() - info.window_ms * 1000ll;
+	return backend_ctx->events_count++;
+}
+
+auto manager::trigger(const sound_event_id id) -> track_id {
+	if (id >= backend_ctx->events_count) [[unlikely]] {
+		ESP_LOGW(TAG, "Unknown %u sound event", id);
+		return INVALID_TRACK_ID;
+	}
 
-	static std::array<uint8_t, sizeof(wav::header)> header_data{};
 	auto &ctx{ backend_ctx->sound_streaming_context };
-	while (backend_ctx->can_add_track()) {
-		const auto id{ backend_ctx->get_available_track_id() };
-		auto &stream{ ctx.streams[id] };
+	auto &event{ backend_ctx->events[id] };
 
-		if (pdFALSE == xSemaphoreTake(stream.file_guard, file_guard_timeout)) {
-			continue;
+	const auto now{ esp_timer_get_time() };
+	if (now - event.last_trigger_us < event.info.window_ms * 1000ll) {
+		++ctx.telemetry.events_coalesced;
+		return event.last_track;
+	}
+	event.last_trigger_us = now;
+
+	// A free slot, or the oldest instance to rewind
+	const auto instances{ std::span{ event.instances }.first(event.info.max_instances) };
+	size_t slot{ std::size(instances) };
+	for (size_t i{}; i < std::size(instances); ++i) {
+		if (!backend_ctx->is_valid(instances[i])) {
+			instances[i] = INVALID_TRACK_ID;
+			slot = i;
+			break;
 		}
-
-		const utils::defer_semaphore_giver defer{ stream.file_guard };
-
-		if (stream.file_descr) [[unlikely]] {
-			backend_ctx->book_track(id);
-			continue;
+		if (slot == std::size(instances)
+		||  ctx.voices[track_index(instances[i])].started_at < ctx.voices[track_index(instances[slot])].started_at
+		) {
+			slot = i;
 		}
+	}
 
-		stream.file_descr = std::fopen(std::data(info.filename), "rb");
-		if (!stream.file_descr) [[unlikely]] {
-			ESP_LOGW(TAG, R"(Cannot open "%.*s" audio file: %s)",
-				static_cast<int>(std::size(info.filename)),
-				std::data(info.filename), std::strerror(errno)
-			);
-			break;
+	if (auto &instance{ instances[slot] }; instance != INVALID_TRACK_ID) {
+		if (!event.info.retrigger) {
+			++ctx.telemetry.events_dropped;
+			return event.last_track;
 		}
 
-		const auto read{ std::fread(
-			std::data(header_data), sizeof(uint8_t), std::size(header_data),
-			stream.file_descr
-		) };
-		if (read < std::size(header_data)) [[unlikely]] {
-			std::fclose(std::exchange(stream.file_descr, nullptr));
-			ESP_LOGW(TAG, R"(File size of "%.*s" is less than WAV file header)",
-				static_cast<int>(std::size(info.filename)),
-				std::data(info.filename)
-			);
-			break;
+		using namespace utils::literals;
+		constexpr auto file_guard_timeout{ 50_ms };
+
+		const auto index{ track_index(instance) };
+		const auto guard{ ctx.file_guards[index] };
+		if (pdTRUE == xSemaphoreTake(guard, file_guard_timeout)) {
+			const auto restarted{ ctx.voices[index].restart(ctx.mixed_blocks) };
+			xSemaphoreGive(guard);
+			if (restarted) {
+				++ctx.telemetry.events_retriggered;
+				xTaskNotifyGive(backend_ctx->prefetch_handle);
+				return event.last_track = instance;
+			}
 		}
+		// The file is over already (its tail is still playing), so start anew
+	}
 
-		const auto header{ wav::header::make_view(header_data) };
-#if defined(GZN_DEBUG)
-		header->dump();
-#endif // defined(GZN_DEBUG)
+	instances[slot] = play_stream(event.info.track, event.layout);
+	return event.last_track = instances[slot];
+}
 
-		if (BITS_PER_SAMPLE != header->format.bits_per_sample) [[unlikely]] {
-			std::fclose(std::exchange(stream.file_descr, nullptr));
-			ESP_LOGE(TAG, "Sound has %zu BPS, but %zu required.",
-				header->format.bits_per_sample, BITS_PER_SAMPLE
-			);
-			break;
-		}
+auto manager::load_sfx(const sfx_params &params, const bool lazy) -> sfx_id {
+	if (backend_ctx->effects_count >= MAX_SFX) [[unlikely]] {
+		ESP_LOGW(TAG, "Cannot load the sound effect, %zu is max", MAX_SFX);
+		return INVALID_SFX;
+	}
 
-		backend::set_track_volume(id, info.volume);
+	auto &effect{ backend_ctx->effects[backend_ctx->effects_count] };
+	effect = sound_effect{ .params{ params } };
+	if (!lazy && !render_effect(effect)) [[unlikely]] {
+		return INVALID_SFX;
+	}
+	return backend_ctx->effects_count++;
+}
 
-		if (info.loop) {
-			stream.content_offset = read + 1;
-		}
+auto manager::play_sfx(const sfx_id id, const track_info &info) -> track_id {
+	if (id >= backend_ctx->effects_count) [[unlikely]] {
+		ESP_LOGW(TAG, "Unknown %u sound effect", id);
+		return INVALID_TRACK_ID;
+	}
 
-		backend_ctx->book_track(id);
-		return id;
+	auto &effect{ backend_ctx->effects[id] };
+	if (std::data(effect.samples) == nullptr && !render_effect(effect)) [[unlikely]] {
+		return INVALID_TRACK_ID;
 	}
 
-	return INVALID_TRACK_ID;
+	return play_stream(info, [&](stream_info &stream) {
+		return open_stream(effect.samples, info, stream);
+	});
 }
 
 auto manager::stop(const track_id track) -> bool {
-	if (!backend_ctx->is_track_booked(track)) {
+	if (!backend_ctx->is_valid(track)) {
 		ESP_LOGW(TAG, "Failed to unload %zu track. Not found", track);
 		return false;
 	}
 
-	auto &stream{ backend_ctx->sound_streaming_context.streams[track] };
-	if (stream.file_descr != nullptr) {
-		stream.close();
-	}
-
-	backend_ctx->unbook_track(track);
+	const auto index{ track_index(track) };
+	backend_ctx->sound_streaming_context.close(index);
+	backend_ctx->unbook_track(index);
 	return true;
 }
 
 auto manager::stop_all() -> size_t {
+	const auto &ctx{ backend_ctx->sound_streaming_context };
+
 	size_t count{};
-	for (track_id track{}; track < MAX_SOUND_TRACKS; ++track) {
-		count += static_cast<size_t>(stop(track));
+	for (size_t index{}; index < ctx.voices_count; ++index) {
+		count += static_cast<size_t>(stop(make_track_id(index, ctx.voices[index].generation)));
 	}
 	return count;
 }
 
+auto manager::play_music(const music_info &info) -> bool {
+	stop_music();
+
+	const auto module{ load_file(info.filename) };
+	if (std::empty(module)) {
+		return false;
+	}
+
+	auto &ctx{ backend_ctx->sound_streaming_context };
+	xSemaphoreTake(ctx.music_guard, portMAX_DELAY);
+	const utils::defer_semaphore_giver defer{ ctx.music_guard };
+
+	if (const auto err{ ctx.music.load(module) }; err != tracker_error::ok) {
+		ESP_LOGW(TAG, R"(Cannot load "%.*s" module: %u)",
+			static_cast<int>(std::size(info.filename)), std::data(info.filename),
+			std::to_underlying(err)
+		);
+		heap_caps_free(std::data(module));
+		return false;
+	}
+
+	ctx.music.loop   = info.loop;
+	ctx.music_volume = info.volume;
+	ctx.music_data   = std::data(module);
+	return true;
+}
+
+void manager::stop_music() {
+	auto &ctx{ backend_ctx->sound_streaming_context };
+	xSemaphoreTake(ctx.music_guard, portMAX_DELAY);
+	const utils::defer_semaphore_giver defer{ ctx.music_guard };
+
+	ctx.music.unload();
+	heap_caps_free(std::exchange(ctx.music_data, nullptr));
+}
+
+auto manager::is_music_playing() -> bool {
+	return backend_ctx->sound_streaming_context.music.is_playing();
+}
+
+auto manager::is_streaming() -> bool {
+	if (backend_ctx == nullptr) {
+		return false;
+	}
+	const auto &ctx{ backend_ctx->sound_streaming_context };
+	for (size_t i{}; i < ctx.voices_count; ++i) {
+		const auto &voice{ ctx.voices[i] };
+		if (voice.current.file_descr != nullptr || voice.pending.file_descr != nullptr) {
+			return true;
+		}
+	}
+	return false;
+}
+
+auto manager::prefetch_underruns() -> uint32_t {
+	const auto &ctx{ backend_ctx->sound_streaming_context };
+
+	uint32_t underruns{};
+	for (size_t i{}; i < ctx.voices_count; ++i) {
+		underruns += ctx.voices[i].underruns;
+	}
+	return underruns;
+}
+
+auto manager::query_telemetry() -> telemetry {
+	auto snapshot{ backend_ctx->sound_streaming_context.telemetry };
+	snapshot.backend            = backend::telemetry();
+	snapshot.prefetch_underruns = prefetch_underruns();
+	return snapshot;
+}
+
+void manager::reset_telemetry() {
+	auto &ctx{ backend_ctx->sound_streaming_context };
+	ctx.telemetry = { .since_us{ esp_timer_get_time() } };
+	for (size_t i{}; i < ctx.voices_count; ++i) {
+		ctx.voices[i].underruns = 0;
+	}
+	backend::reset_telemetry();
+	backend_ctx->reported_underruns         = 0;
+	backend_ctx->reported_backend_underruns = 0;
+}
+
+auto manager::query_cpu_usage() -> cpu_usage {
+	const auto stats{ query_telemetry() };
+	const auto elapsed{ esp_timer_get_time() - stats.since_us };
+	const auto rate{ std::to_underlying(SAMPLE_RATE) };
+
+	return {
+		.sample_rate{ rate },
+		.isr_permille{ static_cast<uint16_t>(
+			uint64_t{ stats.backend.isr_cycles.average() } * rate * 1000u / CPU_FREQUENCY_HZ
+		) },
+		.mixer_permille{ static_cast<uint16_t>(elapsed > 0
+			? stats.mix_time_us.sum * 1000u / static_cast<uint64_t>(elapsed)
+			: 0
+		) },
+	};
+}
+
 [[gnu::always_inline]]
 inline auto manager::is_playing(const track_id track) -> bool {
-	return backend_ctx->is_track_booked(track);
+	return backend_ctx->is_valid(track);
 }
 
 } // namespace gzn::audio
-
@@ -0,0 +1,88 @@
+#include <utility>
+#include <algorithm>
+
+#include "gzn/audio/mixer.hpp"
+
+namespace gzn::audio {
+
+namespace {
+
+/// Balance law: the center keeps both sides at the full gain
+[[nodiscard]] [[gnu::always_inline]]
+inline auto pan_gains(const int32_t gain, const int8_t pan) -> std::pair<int32_t, int32_t> {
+	const auto clamped{ std::clamp<int32_t>(pan, PAN_LEFT, PAN_RIGHT) };
+	return {
+		(gain * (PAN_RIGHT - std::max(clamped, 0))) / PAN_RIGHT,
+		(gain * (PAN_RIGHT + std::min(clamped, 0))) / PAN_RIGHT,
+	};
+}
+
+} // namespace
+
+auto mixer::fetch(const size_t index, voice_state &voice, const uint32_t frame) -> size_t {
+	batches_sizes[index] = voice.consume(batches[index], frame);
+	volumes[index]       = voice.volume;
+	pans[index]          = voice.pan;
+	channels[index]      = voice.channels;
+	return batches_sizes[index];
+}
+
+auto mixer::fetch_music(tracker &music, const int8_t volume) -> size_t {
+	volumes[MUSIC_TRACK]  = volume;
+	pans[MUSIC_TRACK]     = PAN_CENTER;
+	channels[MUSIC_TRACK] = 1;
+	return batches_sizes[MUSIC_TRACK] = music.render(
+		std::span{ batches[MUSIC_TRACK] }.first(SAMPLE_BATCH_SIZE)
+	);
+}
+
+auto mixer::mix(std::span<int16_t, SAMPLE_BATCH_SIZE * OUTPUT_CHANNELS> out) -> size_t {
+	const auto active_batches_count{ static_cast<int32_t>(std::ranges::count_if(
+		batches_sizes, [](const size_t size) { return size != 0; }
+	)) };
+	if (active_batches_count == 0) {
+		return 0;
+	}
+
+	std::ranges::fill(accumulator, 0);
+	for (size_t batch_id{}; batch_id < std::size(batches); ++batch_id) {
+		const auto size{ batches_sizes[batch_id] };
+		if (size == 0) {
+			continue;
+		}
+
+		const auto volume{ std::clamp<int32_t>(volumes[batch_id], -VOLUME_0DB, VOLUME_0DB) };
+		const int32_t gain{
+			((volume + VOLUME_0DB) << (MIX_GAIN_SHIFT - 4)) / active_batches_count
+		};
+		const auto &batch{ batches[batch_id] };
+
+		if constexpr (OUTPUT_CHANNELS == 1) {
+			for (size_t i{}; i < size; ++i) {
+				accumulator[i] += batch[i] * gain;
+			}
+		} else {
+			const auto [left, right]{ pan_gains(gain, pans[batch_id]) };
+			if (channels[batch_id] == 1) {
+				for (size_t i{}; i < size; ++i) {
+					accumulator[i * 2    ] += batch[i] * left;
+					accumulator[i * 2 + 1] += batch[i] * right;
+				}
+			} else {
+				for (size_t i{}; i < size; i += 2) {
+					accumulator[i    ] += batch[i    ] * left;
+					accumulator[i + 1] += batch[i + 1] * right;
+				}
+			}
+		}
+	}
+
+	for (size_t i{}; i < std::size(out); ++i) {
+		out[i] = static_cast<int16_t>(std::clamp<int32_t>(
+			accumulator[i] >> MIX_GAIN_SHIFT, INT16_MIN, INT16_MAX
+		));
+	}
+	return SAMPLE_BATCH_SIZE;
+}
+
+} // namespace gzn::audio
@@ -0,0 +1,176 @@
+#include <array>
+#include <algorithm>
+
+#include "gzn/audio/synth.hpp"
+
+namespace gzn::audio {
+
+namespace {
+
+inline constexpr size_t   SINE_TABLE_SIZE  { 256 };
+inline constexpr uint32_t NOISE_STEP_SHIFT { 29 };        ///< new noise value 8 times per period
+inline constexpr uint32_t MAX_PHASE_STEP   { 0x7FFF'FFFF }; ///< Nyquist
+inline constexpr uint64_t MAX_FREQUENCY_Q16{ uint64_t{ UINT16_MAX } << 16 };
+inline constexpr int64_t  UNITY_Q16        { 1 << 16 };
+
+/// Bhaskara I approximation, within 0.2% of the real sine
+consteval auto make_sine_table() -> std::array<int16_t, SINE_TABLE_SIZE> {
+	constexpr int64_t half{ SINE_TABLE_SIZE / 2 };
+
+	std::array<int16_t, SINE_TABLE_SIZE> table{};
+	for (int64_t i{}; i < half; ++i) {
+		const auto u{ i * (half - i) };
+		const auto value{ static_cast<int16_t>(INT16_MAX * 16 * u / (5 * half * half - 4 * u)) };
+		table[i]        = value;
+		table[i + half] = static_cast<int16_t>(-value);
+	}
+	return table;
+}
+
+inline constexpr auto SINE_TABLE{ make_sine_table() };
+
+[[nodiscard]] [[gnu::always_inline]]
+inline auto sine(const uint32_t phase) -> int32_t {
+	return SINE_TABLE[phase >> 24];
+}
+
+[[nodiscard]] [[gnu::always_inline]]
+inline auto xorshift(uint32_t &state) -> uint32_t {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+[[nodiscard]] [[gnu::always_inline]]
+inline auto ms_to_samples(const uint32_t ms, const uint32_t rate) -> size_t {
+	return static_cast<size_t>(uint64_t{ ms } * rate / 1000u);
+}
+
+/// Q16 envelope: linear attack, sustain with the fading punch, linear decay
+[[nodiscard]] [[gnu::always_inline]]
+inline auto envelope(
+	const size_t sample,
+	const std::array<size_t, 3> &ends,
+	const uint8_t punch
+) -> int64_t {
+	const auto [attack_end, sustain_end, decay_end]{ ends };
+	if (sample < attack_end) {
+		return UNITY_Q16 * static_cast<int64_t>(sample) / static_cast<int64_t>(attack_end);
+	}
+	if (sample < sustain_end) {
+		return UNITY_Q16 + (int64_t{ punch } << 8) * static_cast<int64_t>(sustain_end - sample)
+			/ static_cast<int64_t>(sustain_end - attack_end);
+	}
+	return UNITY_Q16 * static_cast<int64_t>(decay_end - sample)
+		/ static_cast<int64_t>(decay_end - sustain_end);
+}
+
+} // namespace
+
+auto sfx_length(const sfx_params &params, const uint32_t rate) -> size_t {
+	return ms_to_samples(uint32_t{ params.attack_ms } + params.sustain_ms + params.decay_ms, rate);
+}
+
+auto render_sfx(
+	const sfx_params &params,
+	std::span<int16_t> out,
+	const uint32_t rate,
+	const uint32_t seed
+) -> size_t {
+	if (rate == 0) [[unlikely]] {
+		return 0;
+	}
+
+	const auto length{ std::min(std::size(out), sfx_length(params, rate)) };
+	const std::array<size_t, 3> ends{
+		ms_to_samples(params.attack_ms, rate),
+		ms_to_samples(uint32_t{ params.attack_ms } + params.sustain_ms, rate),
+		ms_to_samples(uint32_t{ params.attack_ms } + params.sustain_ms + params.decay_ms, rate),
+	};
+
+	const uint64_t min_frequency{ uint64_t{ params.min_frequency } << 16 };
+	const auto     vibrato_step { static_cast<uint32_t>((uint64_t{ params.vibrato_speed } << 32) / 1000u) };
+
+	uint64_t frequency{ uint64_t{ params.frequency } << 16 }; ///< Q16 Hz
+	int32_t  slide{ params.slide * 256 };                      ///< Q24 per ms
+	int32_t  duty{ params.duty * 256 };                        ///< Q16 of the period
+	uint32_t phase{};
+	uint32_t step{};                                           ///< Q32 of the period per sample
+	uint32_t vibrato_phase{};
+	uint32_t noise_state{ seed != 0 ? seed : 1 };
+	int32_t  noise{};
+	uint32_t ms_accumulator{};
+	uint32_t elapsed_ms{};
+
+	const auto update_step{ [&] {
+		auto effective{ static_cast<int64_t>(frequency) };
+		if (params.vibrato_depth != 0) {
+			effective += (effective * params.vibrato_depth * sine(vibrato_phase)) >> 23;
+		}
+		step = static_cast<uint32_t>(std::min<uint64_t>(
+			(static_cast<uint64_t>(effective) << 16) / rate, MAX_PHASE_STEP
+		));
+	} };
+	update_step();
+
+	for (size_t i{}; i < length; ++i) {
+		// Control rate: slides, sweeps and the arpeggio change once per ms
+		if (ms_accumulator += 1000; ms_accumulator >= rate) {
+			ms_accumulator -= rate;
+			++elapsed_ms;
+
+			slide += params.delta_slide;
+			frequency = std::min(
+				frequency * static_cast<uint64_t>(std::max<int64_t>(UNITY_Q16 + (slide >> 8), 0)) >> 16,
+				MAX_FREQUENCY_Q16
+			);
+			if (elapsed_ms == params.arpeggio_ms) {
+				frequency = std::min((frequency * params.arpeggio) >> 8, MAX_FREQUENCY_Q16);
+			}
+			if (frequency < min_frequency) {
+				return i;
+			}
+
+			duty = std::clamp<int32_t>(duty + params.duty_sweep, 0, UINT16_MAX);
+			vibrato_phase += vibrato_step;
+			update_step();
+		}
+
+		const auto previous{ phase };
+		phase += step;
+
+		int32_t wave{};
+		switch (params.shape) {
+			case wave_shape::square:
+				wave = static_cast<int32_t>(phase >> 16) < duty ? INT16_MAX : -INT16_MAX;
+				break;
+
+			case wave_shape::sawtooth:
+				wave = static_cast<int32_t>(phase >> 16) - 0x8000;
+				break;
+
+			case wave_shape::triangle: {
+				const auto position{ static_cast<int32_t>(phase >> 16) };
+				wave = position < 0x8000 ? position * 2 - 0x8000 : 0x17FFF - position * 2;
+			} break;
+
+			case wave_shape::sine:
+				wave = sine(phase);
+				break;
+
+			case wave_shape::noise:
+				if ((phase >> NOISE_STEP_SHIFT) != (previous >> NOISE_STEP_SHIFT)) {
+					noise = static_cast<int16_t>(xorshift(noise_state) >> 16);
+				}
+				wave = noise;
+				break;
+		}
+
+		const auto sample{ (wave * envelope(i, ends, params.punch) >> 16) * params.volume >> 8 };
+		out[i] = static_cast<int16_t>(std::clamp<int64_t>(sample, INT16_MIN, INT16_MAX));
+	}
+	return length;
+}
+
+} // namespace gzn::audio
@@ -0,0 +1,359 @@
+#include <cstring>
+#include <algorithm>
+
+#include "gzn/audio/tracker.hpp"
+
+namespace gzn::audio {
+
+namespace {
+
+inline constexpr size_t   TITLE_SIZE        {   20 };
+inline constexpr size_t   INSTRUMENT_SIZE   {   30 };
+inline constexpr size_t   SONG_LENGTH_OFFSET{  950 };
+inline constexpr size_t   ORDERS_OFFSET     {  952 };
+inline constexpr size_t   SIGNATURE_OFFSET  { 1080 };
+inline constexpr size_t   PATTERNS_OFFSET   { 1084 };
+inline constexpr size_t   NOTE_SIZE         {    4 };
+inline constexpr size_t   ROW_SIZE          { NOTE_SIZE * TRACKER_CHANNELS };
+inline constexpr size_t   PATTERN_SIZE      { ROW_SIZE * TRACKER_ROWS };
+
+inline constexpr uint64_t PAL_CLOCK { 3'546'895 };
+inline constexpr uint16_t MIN_PERIOD{ 113 };
+inline constexpr uint16_t MAX_PERIOD{ 856 };
+
+inline constexpr std::array<uint16_t, 36> PERIODS{
+	856, 808, 762, 720, 678, 640, 604, 570, 538, 508, 480, 453,
+	428, 404, 381, 360, 339, 320, 302, 285, 269, 254, 240, 226,
+	214, 202, 190, 180, 170, 160, 151, 143, 135, 127, 120, 113,
+};
+
+/// 2^(finetune / 96) in Q16 indexed by the raw finetune nibble
+inline constexpr std::array<uint32_t, 16> FINETUNES{
+	65536, 66011, 66489, 66971, 67456, 67945, 68438, 68933,
+	61858, 62306, 62757, 63212, 63670, 64132, 64596, 65065,
+};
+
+inline constexpr std::array<std::array<char, 4>, 4> SIGNATURES{ {
+	{ 'M', '.', 'K', '.' },
+	{ 'M', '!', 'K', '!' },
+	{ '4', 'C', 'H', 'N' },
+	{ 'F', 'L', 'T', '4' },
+} };
+
+[[gnu::always_inline]]
+inline auto read_word(const uint8_t *data) -> uint32_t {
+	return (static_cast<uint32_t>(data[0]) << 8) | data[1];
+}
+
+[[gnu::always_inline]]
+inline auto arpeggio_period(const uint16_t period, const uint8_t semitones) -> uint16_t {
+	for (size_t i{}; i < std::size(PERIODS); ++i) {
+		if (PERIODS[i] <= period) {
+			return PERIODS[std::min(i + semitones, std::size(PERIODS) - 1)];
+		}
+	}
+	return period;
+}
+
+} // namespace
+
+auto tracker::load(const std::span<const uint8_t> module, const uint32_t rate) -> tracker_error {
+	unload();
+
+	if (std::size(module) < PATTERNS_OFFSET) {
+		return tracker_error::too_small;
+	}
+
+	const auto signature{ std::data(module) + SIGNATURE_OFFSET };
+	if (std::ranges::none_of(SIGNATURES, [signature](const auto &expected) {
+		return 0 == std::memcmp(signature, std::data(expected), std::size(expected));
+	})) {
+		return tracker_error::unsupported_format;
+	}
+
+	song_length      = module[SONG_LENGTH_OFFSET];
+	restart_position = module[SONG_LENGTH_OFFSET + 1];
+	orders           = std::data(module) + ORDERS_OFFSET;
+	if (song_length == 0 || song_length > TRACKER_ORDERS) {
+		return tracker_error::corrupted;
+	}
+
+	const auto patterns_count{ static_cast<size_t>(
+		*std::max_element(orders, orders + TRACKER_ORDERS)
+	) + 1u };
+	size_t offset{ PATTERNS_OFFSET + patterns_count * PATTERN_SIZE };
+	if (offset > std::size(module)) {
+		return tracker_error::corrupted;
+	}
+	patterns = std::data(module) + PATTERNS_OFFSET;
+
+	for (size_t i{}; i < std::size(instruments); ++i) {
+		const auto header{ std::data(module) + TITLE_SIZE + i * INSTRUMENT_SIZE };
+		auto &inst{ instruments[i] };
+
+		inst.length   = read_word(header + 22) * 2u;
+		inst.finetune = header[24] & 0x0F;
+		inst.volume   = std::min(header[25], TRACKER_MAX_VOLUME);
+
+		// Some modules are cut right in the middle of the last sample
+		inst.length = static_cast<uint32_t>(std::min<size_t>(inst.length, std::size(module) - offset));
+		inst.data   = reinterpret_cast<const int8_t *>(std::data(module) + offset);
+		offset     += inst.length;
+
+		const auto loop_start { read_word(header + 26) * 2u };
+		const auto loop_length{ read_word(header + 28) * 2u };
+		if (loop_length > 2 && loop_start < inst.length) {
+			inst.loop_start  = loop_start;
+			inst.loop_length = std::min(loop_length, inst.length - loop_start);
+		}
+	}
+
+	song        = module;
+	output_rate = rate;
+	restart();
+	return tracker_error::ok;
+}
+
+void tracker::unload() {
+	song     = {};
+	orders   = nullptr;
+	patterns = nullptr;
+	playing  = false;
+}
+
+void tracker::restart() {
+	channels          = {};
+	order             = 0;
+	row               = 0;
+	tick              = 0;
+	speed             = 6;
+	tempo             = 125;
+	jump_order        = -1;
+	break_row         = -1;
+	tick_samples_left = 0;
+	playing           = !std::empty(song);
+}
+
+auto tracker::render(std::span<int16_t> out) -> size_t {
+	size_t rendered{};
+	while (rendered < std::size(out) && playing) {
+		if (tick_samples_left == 0) {
+			if (tick == 0) {
+				process_row();
+			} else {
+				process_tick();
+			}
+			tick_samples_left = (output_rate * 5u) / (2u * tempo);
+		}
+
+		const auto count{ std::min<size_t>(std::size(out) - rendered, tick_samples_left) };
+		for (size_t i{ rendered }; i < rendered + count; ++i) {
+			int32_t mixed{};
+			for (auto &ch : channels) {
+				if (!ch.active) {
+					continue;
+				}
+
+				const auto &inst{ *ch.sample };
+				mixed += inst.data[ch.position] * ch.volume;
+
+				const uint32_t fraction{ ch.fraction + (ch.step & 0xFFFFu) };
+				ch.position += (ch.step >> 16) + (fraction >> 16);
+				ch.fraction  = static_cast<uint16_t>(fraction);
+
+				if (inst.loop_length != 0) {
+					const auto loop_end{ inst.loop_start + inst.loop_length };
+					while (ch.position >= loop_end) {
+						ch.position -= inst.loop_length;
+					}
+				} else if (ch.position >= inst.length) {
+					ch.active = false;
+				}
+			}
+			out[i] = static_cast<int16_t>(std::clamp<int32_t>(mixed, INT16_MIN, INT16_MAX));
+		}
+
+		rendered          += count;
+		tick_samples_left -= static_cast<uint32_t>(count);
+		if (tick_samples_left == 0 && ++tick >= speed) {
+			tick = 0;
+			advance_row();
+		}
+	}
+	return rendered;
+}
+
+void tracker::process_row() {
+	const auto data{ patterns + orders[order] * PATTERN_SIZE + row * ROW_SIZE };
+
+	for (size_t i{}; i < std::size(channels); ++i) {
+		const auto note{ data + i * NOTE_SIZE };
+		auto &ch{ channels[i] };
+
+		const uint8_t  sample_id{ static_cast<uint8_t>((note[0] & 0xF0) | (note[2] >> 4)) };
+		const uint16_t period   { static_cast<uint16_t>(((note[0] & 0x0F) << 8) | note[1]) };
+		ch.effect = note[2] & 0x0F;
+		ch.param  = note[3];
+
+		if (sample_id != 0 && sample_id <= std::size(instruments)) {
+			ch.selected = &instruments[sample_id - 1];
+			ch.volume   = ch.selected->volume;
+		}
+
+		if (period != 0) {
+			if (ch.effect == 0x3) {
+				ch.porta_target = period;
+			} else if (ch.selected != nullptr) {
+				ch.sample   = ch.selected;
+				ch.period   = period;
+				ch.position = 0;
+				ch.fraction = 0;
+				ch.active   = ch.sample->length != 0;
+			}
+		}
+
+		const uint8_t x{ static_cast<uint8_t>(ch.param >> 4) };
+		const uint8_t y{ static_cast<uint8_t>(ch.param & 0x0F) };
+		switch (ch.effect) {
+			case 0x3:
+				if (ch.param != 0) {
+					ch.porta_speed = ch.param;
+				}
+				break;
+
+			case 0x9:
+				if (ch.param != 0) {
+					ch.offset = ch.param;
+				}
+				if (period != 0 && ch.sample != nullptr) {
+					ch.position = static_cast<uint32_t>(ch.offset) << 8;
+					ch.active   = ch.position < ch.sample->length;
+				}
+				break;
+
+			case 0xB:
+				jump_order = ch.param;
+				break_row  = break_row < 0 ? 0 : break_row;
+				break;
+
+			case 0xC:
+				ch.volume = std::min(ch.param, TRACKER_MAX_VOLUME);
+				break;
+
+			case 0xD:
+				break_row  = std::min<int16_t>(x * 10 + y, TRACKER_ROWS - 1);
+				jump_order = jump_order < 0 ? order + 1 : jump_order;
+				break;
+
+			case 0xE:
+				switch (x) {
+					case 0x1: ch.period = std::max<uint16_t>(ch.period - y, MIN_PERIOD); break;
+					case 0x2: ch.period = std::min<uint16_t>(ch.period + y, MAX_PERIOD); break;
+					case 0xA: ch.volume = std::min<uint8_t>(ch.volume + y, TRACKER_MAX_VOLUME); break;
+					case 0xB: ch.volume = static_cast<uint8_t>(std::max(ch.volume - y, 0)); break;
+					case 0xC: if (y == 0) { ch.volume = 0; } break;
+					default: break;
+				}
+				break;
+
+			case 0xF:
+				if (ch.param != 0 && ch.param < 32) {
+					speed = ch.param;
+				} else if (ch.param >= 32) {
+					tempo = ch.param;
+				}
+				break;
+
+			default: break;
+		}
+
+		update_step(ch, ch.period);
+	}
+}
+
+void tracker::process_tick() {
+	for (auto &ch : channels) {
+		const uint8_t x{ static_cast<uint8_t>(ch.param >> 4) };
+		const uint8_t y{ static_cast<uint8_t>(ch.param & 0x0F) };
+
+		switch (ch.effect) {
+			case 0x0:
+				if (ch.param != 0) {
+					const uint8_t semitones[]{ 0, x, y };
+					update_step(ch, arpeggio_period(ch.period, semitones[tick % 3]));
+					continue;
+				}
+				break;
+
+			case 0x1:
+				ch.period = std::max<uint16_t>(ch.period - ch.param, MIN_PERIOD);
+				break;
+
+			case 0x2:
+				ch.period = std::min<uint16_t>(ch.period + ch.param, MAX_PERIOD);
+				break;
+
+			case 0x3:
+				if (ch.porta_target == 0) {
+					break;
+				}
+				if (ch.period < ch.porta_target) {
+					ch.period = std::min<uint16_t>(ch.period + ch.porta_speed, ch.porta_target);
+				} else {
+					ch.period = std::max<uint16_t>(ch.period - ch.porta_speed, ch.porta_target);
+				}
+				break;
+
+			case 0xA:
+				if (x != 0) {
+					ch.volume = std::min<uint8_t>(ch.volume + x, TRACKER_MAX_VOLUME);
+				} else {
+					ch.volume = static_cast<uint8_t>(std::max(ch.volume - y, 0));
+				}
+				break;
+
+			case 0xE:
+				if (x == 0xC && y == tick) {
+					ch.volume = 0;
+				}
+				break;
+
+			default: break;
+		}
+
+		update_step(ch, ch.period);
+	}
+}
+
+void tracker::advance_row() {
+	if (jump_order >= 0 || break_row >= 0) {
+		order      = static_cast<uint8_t>(jump_order >= 0 ? jump_order : order + 1);
+		row        = static_cast<uint8_t>(break_row  >= 0 ? break_row  : 0);
+		jump_order = -1;
+		break_row  = -1;
+	} else if (++row >= TRACKER_ROWS) {
+		row = 0;
+		++order;
+	}
+
+	if (order < song_length) {
+		return;
+	}
+
+	if (loop) {
+		order = restart_position < song_length ? restart_position : 0;
+	} else {
+		playing = false;
+	}
+}
+
+void tracker::update_step(channel &ch, const uint16_t period) {
+	if (period == 0 || ch.sample == nullptr) {
+		ch.step = 0;
+		return;
+	}
+	const auto step{ (PAL_CLOCK << 16) / (static_cast<uint64_t>(period) * output_rate) };
+	ch.step = static_cast<uint32_t>((step * FINETUNES[ch.sample->finetune]) >> 16);
+}
+
+} // namespace gzn::audio
@@ -0,0 +1,324 @@
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+#include "gzn/audio/voice.hpp"
+#include "gzn/audio/wav-format.hpp"
+
+namespace gzn::audio {
+
+namespace {
+
+/// Applies linear fade-out to the fetched frames and returns new batch size
+[[gnu::always_inline]]
+inline auto apply_fade_out(
+	std::span<int16_t> samples,
+	const uint8_t channels,
+	uint16_t &fade_left
+) -> size_t {
+	const auto count{ std::min<size_t>(std::size(samples) / channels, fade_left) };
+	for (size_t frame{}; frame < count; ++frame) {
+		const auto gain{ static_cast<int32_t>(fade_left - frame) };
+		for (size_t channel{}; channel < channels; ++channel) {
+			auto &sample{ samples[frame * channels + channel] };
+			sample = static_cast<int16_t>((sample * gain) >> FADE_OUT_SHIFT);
+		}
+	}
+	fade_left -= static_cast<uint16_t>(count);
+	return count * channels;
+}
+
+[[gnu::always_inline]]
+inline void take_stream_parameters(voice_state &voice, const stream_info &stream) {
+	voice.volume      = stream.volume;
+	voice.pan         = stream.pan;
+	voice.channels    = stream.channels;
+	voice.start_frame = stream.start_frame;
+	voice.scheduled   = stream.scheduled;
+}
+
+} // namespace
+
+auto stream_info::rewind() -> bool {
+	samples_left = samples_total;
+	return memory != nullptr || 0 == std::fseek(file_descr, data_offset, SEEK_SET);
+}
+
+auto stream_info::read(std::span<int16_t> samples) -> size_t {
+	const auto count{ std::min(std::size(samples), samples_left) };
+	if (memory != nullptr) {
+		std::copy_n(memory + (samples_total - samples_left), count, std::begin(samples));
+		samples_left -= count;
+		return count;
+	}
+
+	const auto read{ std::fread(std::data(samples), sizeof(samples[0]), count, file_descr) };
+	samples_left -= read;
+	return read;
+}
+
+auto prefetch_ring::pop(const uint16_t serial, std::span<int16_t> batch) -> size_t {
+	while (!empty()) {
+		const auto index{ head.load(std::memory_order_relaxed) };
+		const auto slot{ index % PREFETCH_BUFFERS };
+
+		size_t size{};
+		if (serials[slot] == serial) {
+			size = std::min<size_t>(sizes[slot], std::size(batch));
+			std::copy_n(std::begin(buffers[slot]), size, std::begin(batch));
+		}
+		head.store(index + 1, std::memory_order_release);
+
+		if (size != 0) {
+			return size;
+		}
+	}
+	return 0;
+}
+
+void voice_state::close() {
+	current.close();
+	pending.close();
+	steal_requested.store(false, std::memory_order_relaxed);
+	scheduled = false;
+	primed    = false;
+	++serial;
+}
+
+void voice_state::start(stream_info &&stream, const uint32_t now) {
+	pending.close();
+	if (!current.is_open()) {
+		current = std::exchange(stream, stream_info{});
+		steal_requested.store(false, std::memory_order_relaxed);
+		take_stream_parameters(*this, current);
+		primed = false;
+		++serial;
+	} else {
+		// Stealing: current sound fades out first and then the pending one
+		// takes its place
+		pending = std::exchange(stream, stream_info{});
+		steal_requested.store(true, std::memory_order_release);
+	}
+
+	started_at = now;
+	++generation;
+}
+
+void voice_state::swap() {
+	if (pending.is_open()) {
+		current.close();
+		current = std::exchange(pending, stream_info{});
+		take_stream_parameters(*this, current);
+		primed = false;
+		++serial;
+	}
+	fade_left = 0;
+	muted     = false;
+}
+
+auto voice_state::restart(const uint32_t now) -> bool {
+	if (!current.is_open() || pending.is_open() || !current.rewind()) {
+		return false;
+	}
+	steal_requested.store(false, std::memory_order_relaxed);
+	started_at = now;
+	scheduled  = false;
+	current.lead_frames = 0;
+	primed     = false;
+	++serial; // drops the prefetched batches
+	return true;
+}
+
+auto voice_state::prefetch() -> bool {
+	if (!current.is_open() || ring.full()) {
+		return false;
+	}
+
+	// Whole block of frames, no matter how wide they are
+	const auto batch{ std::span{ ring.back() }.first(SAMPLE_BATCH_SIZE * current.channels) };
+	size_t size{};
+	if (current.lead_frames != 0) [[unlikely]] {
+		// Shifts the stream inside the block, so it starts at the exact frame
+		size = std::exchange(current.lead_frames, 0) * current.channels;
+		std::fill_n(std::begin(batch), size, 0);
+	}
+
+	size_t wrapped_at{ SIZE_MAX };
+	while (size < std::size(batch) && current.is_open()) {
+		if (current.samples_left == 0) {
+			// The loop point is prefetched right away, so looping is seamless.
+			// Wrapping twice without reading anything means the data is gone
+			if (current.loop && wrapped_at != size && current.rewind()) [[likely]] {
+				wrapped_at = size;
+				continue;
+			}
+			current.close();
+			break;
+		}
+
+		// Never read past the data chunk, trailing chunks aren't samples
+		const auto read{ current.read(batch.subspan(size)) };
+		size += read;
+
+		if (read == 0) [[unlikely]] {
+			if (current.file_descr != nullptr && !std::feof(current.file_descr)) { // I/O error, try again later
+				break;
+			}
+			current.samples_left = 0; // the file was truncated
+		}
+	}
+
+	if (size != 0) {
+		ring.push(size, serial);
+	}
+	return true;
+}
+
+auto voice_state::consume(std::span<int16_t> batch, const uint32_t frame) -> size_t {
+	if (fade_serial != serial && (fade_left != 0 || muted)) {
+		// The stream was replaced without us, nothing to fade out anymore
+		fade_left = 0;
+		muted     = false;
+	}
+	if (steal_requested.exchange(false, std::memory_order_acq_rel) && fade_left == 0 && !muted) {
+		fade_left   = FADE_OUT_SAMPLES;
+		fade_serial = serial;
+	}
+	if (muted) {
+		return 0;
+	}
+
+	if (scheduled) [[unlikely]] {
+		// Wrap-safe: the start is in one of the next blocks
+		if (static_cast<int32_t>(start_frame - frame) >= static_cast<int32_t>(SAMPLE_BATCH_SIZE)) {
+			if (fade_left != 0) { // stolen before it was heard
+				fade_left = 0;
+				muted     = true;
+			}
+			return 0;
+		}
+		scheduled = false;
+	}
+
+	auto size{ ring.pop(serial, batch) };
+	if (size != 0) {
+		primed = true;
+	} else if (primed && fade_left == 0 && current.is_open()) [[unlikely]] {
+		// Not before the first batch, the reader hasn't had a chance yet
+		++underruns;
+	}
+
+	if (fade_left != 0) [[unlikely]] {
+		size = apply_fade_out(batch.first(size), channels, fade_left);
+		if (fade_left == 0 || size == 0) {
+			fade_left = 0;
+			muted     = true;
+		}
+	}
+	return size;
+}
+
+auto open_stream(const track_info &info, stream_info &stream) -> open_result {
+	wav::layout layout{};
+	return open_stream(info, stream, layout);
+}
+
+auto open_stream(const track_info &info, stream_info &stream, wav::layout &layout) -> open_result {
+	stream.file_descr = std::fopen(std::data(info.filename), "rb");
+	if (!stream.file_descr) [[unlikely]] {
+		return open_result::cannot_open;
+	}
+
+	if (layout.data_size == 0) {
+		const auto result{ wav::parse(stream.file_descr, layout) };
+		if (result != wav::parse_result::ok) [[unlikely]] {
+			layout = {};
+			stream.close();
+			return result == wav::parse_result::too_small ? open_result::too_small : open_result::corrupted;
+		}
+#if defined(GZN_DEBUG)
+		layout.dump();
+#endif // defined(GZN_DEBUG)
+	}
+
+	// Played as is, so a file of another rate would play at a wrong speed
+	if (wav::format_t::PCM  != layout.format
+	||  std::to_underlying(SAMPLE_RATE) != layout.sample_rate
+	||  BITS_PER_SAMPLE     != layout.bits_per_sample
+	||  0                   == layout.channels
+	||  MAX_SOURCE_CHANNELS <  layout.channels
+	) [[unlikely]] {
+		stream.close();
+		return open_result::unsupported_format;
+	}
+
+	if (layout.data_size == 0
+	||  0 != std::fseek(stream.file_descr, layout.data_offset, SEEK_SET)
+	) [[unlikely]] {
+		stream.close();
+		return open_result::too_small;
+	}
+
+	stream.samples_total  = layout.data_size / BYTES_PER_SAMPLE;
+	stream.samples_left   = stream.samples_total;
+	stream.priority       = info.priority;
+	stream.volume         = info.volume;
+	stream.pan            = info.pan;
+	stream.channels       = static_cast<uint8_t>(layout.channels);
+	stream.data_offset    = layout.data_offset;
+	stream.loop           = info.loop;
+	return open_result::ok;
+}
+
+auto open_stream(
+	const std::span<const int16_t> samples,
+	const track_info &info,
+	stream_info &stream
+) -> open_result {
+	if (std::empty(samples)) [[unlikely]] {
+		return open_result::too_small;
+	}
+
+	stream.memory        = std::data(samples);
+	stream.samples_total = std::size(samples);
+	stream.samples_left  = stream.samples_total;
+	stream.priority      = info.priority;
+	stream.volume        = info.volume;
+	stream.pan           = info.pan;
+	stream.channels      = 1;
+	stream.loop          = info.loop;
+	return open_result::ok;
+}
+
+auto select_voice(
+	const std::span<const voice_state> voices,
+	const uint32_t booked_bitset,
+	const uint8_t priority
+) -> size_t {
+	static constexpr auto better_victim{ [](const voice_state &lhv, const voice_state &rhv) {
+		const auto &lhs{ lhv.audible() };
+		const auto &rhs{ rhv.audible() };
+		if (lhs.priority != rhs.priority) return lhs.priority < rhs.priority;
+		if (lhs.volume   != rhs.volume  ) return lhs.volume   < rhs.volume;
+		const auto lhs_left{ lhs.loop ? SIZE_MAX : lhs.samples_left };
+		const auto rhs_left{ rhs.loop ? SIZE_MAX : rhs.samples_left };
+		if (lhs_left     != rhs_left    ) return lhs_left     < rhs_left;
+		return lhv.started_at < rhv.started_at;
+	} };
+
+	size_t victim{ NO_VOICE };
+	for (size_t i{}; i < std::size(voices); ++i) {
+		if (!(booked_bitset & (1u << i))) {
+			return i;
+		}
+		if (voices[i].audible().priority > priority) {
+			continue;
+		}
+		if (victim == NO_VOICE || better_victim(voices[i], voices[victim])) {
+			victim = i;
+		}
+	}
+	return victim;
+}
+
+} // namespace gzn::audio
@@ -0,0 +1,138 @@
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+#include "gzn/audio/wav-format.hpp"
+
+namespace gzn::audio::wav {
+
+namespace {
+
+inline constexpr size_t DESCRIPTOR_SIZE  { 12 };
+inline constexpr size_t CHUNK_HEADER_SIZE{  8 };
+inline constexpr size_t FORMAT_MIN_SIZE  { 16 };
+inline constexpr size_t FORMAT_EXT_SIZE  { 40 }; ///< WAVE_FORMAT_EXTENSIBLE
+inline constexpr size_t SUBFORMAT_OFFSET { 24 };
+
+[[nodiscard]] [[gnu::always_inline]]
+inline auto is_id(const uint8_t *data, const char (&id)[5]) -> bool {
+	return 0 == std::memcmp(data, id, sizeof(char4_t));
+}
+
+template<class T>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto load(const uint8_t *data) -> T {
+	T value;
+	std::memcpy(&value, data, sizeof(T)); // RIFF is little-endian, so are we
+	return value;
+}
+
+/**
+ * @brief Walks the RIFF chunks till both `fmt ` and `data` are found
+ * @param read `(offset, span) -> bool`, has to fill the whole span
+ * @param total size of the file
+ */
+template<class Reader>
+auto walk_chunks(Reader &&read, const size_t total, layout &out) -> parse_result {
+	std::array<uint8_t, FORMAT_EXT_SIZE> buffer{};
+	const std::span chunk{ buffer };
+
+	if (total < DESCRIPTOR_SIZE + CHUNK_HEADER_SIZE
+	||  !read(0, chunk.first(DESCRIPTOR_SIZE))
+	) {
+		return parse_result::too_small;
+	}
+	if (!is_id(&buffer[0], "RIFF") || !is_id(&buffer[8], "WAVE")) {
+		return parse_result::not_riff;
+	}
+
+	// RIFF size of the truncated files lies, the actual size wins
+	const auto riff_end{ std::min<size_t>(total, load<uint32_t>(&buffer[4]) + CHUNK_HEADER_SIZE) };
+
+	bool has_format{ false };
+	bool has_data  { false };
+	for (size_t offset{ DESCRIPTOR_SIZE };
+		offset + CHUNK_HEADER_SIZE <= riff_end && !(has_format && has_data);
+	) {
+		if (!read(offset, chunk.first(CHUNK_HEADER_SIZE))) {
+			return parse_result::corrupted;
+		}
+		const auto size{ load<uint32_t>(&buffer[4]) };
+		const auto body{ offset + CHUNK_HEADER_SIZE };
+
+		if (is_id(&buffer[0], "fmt ")) {
+			if (size < FORMAT_MIN_SIZE || size > riff_end - body) {
+				return parse_result::corrupted;
+			}
+			const auto length{ std::min<size_t>(size, FORMAT_EXT_SIZE) };
+			if (!read(body, chunk.first(length))) {
+				return parse_result::corrupted;
+			}
+			out.format          = static_cast<format_t>(load<uint16_t>(&buffer[0]));
+			out.channels        = load<uint16_t>(&buffer[2]);
+			out.sample_rate     = load<uint32_t>(&buffer[4]);
+			out.block_align     = load<uint16_t>(&buffer[12]);
+			out.bits_per_sample = load<uint16_t>(&buffer[14]);
+			if (out.format == format_t::Extensible && length >= SUBFORMAT_OFFSET + sizeof(uint16_t)) {
+				// The sub-format GUID starts with the actual format tag
+				out.format = static_cast<format_t>(load<uint16_t>(&buffer[SUBFORMAT_OFFSET]));
+			}
+			has_format = true;
+		} else if (is_id(&buffer[0], "data")) {
+			out.data_offset = static_cast<uint32_t>(body);
+			out.data_size   = static_cast<uint32_t>(std::min<size_t>(size, riff_end - body));
+			has_data = true;
+		}
+
+		if (size >= riff_end - body) {
+			break;
+		}
+		offset = body + size + (size & 1); // chunks are word aligned
+	}
+
+	if (!has_format) return parse_result::no_format;
+	if (!has_data  ) return parse_result::no_data;
+
+	// Whole bytes per sample, so the data is a whole number of non-empty frames
+	if (out.channels == 0
+	||  out.bits_per_sample == 0
+	||  out.bits_per_sample % 8u != 0
+	||  out.block_align == 0
+	||  out.block_align != out.channels * (out.bits_per_sample / 8u)
+	) {
+		return parse_result::corrupted;
+	}
+	out.data_size -= out.data_size % out.block_align;
+	return parse_result::ok;
+}
+
+} // namespace
+
+auto parse(const std::span<const uint8_t> file, layout &out) -> parse_result {
+	const auto read{ [file](const size_t offset, std::span<uint8_t> to) {
+		if (offset + std::size(to) > std::size(file)) {
+			return false;
+		}
+		std::copy_n(std::begin(file) + offset, std::size(to), std::begin(to));
+		return true;
+	} };
+	return walk_chunks(read, std::size(file), out);
+}
+
+auto parse(std::FILE *file, layout &out) -> parse_result {
+	if (0 != std::fseek(file, 0, SEEK_END)) {
+		return parse_result::corrupted;
+	}
+	const auto total{ std::ftell(file) };
+	if (total < 0) {
+		return parse_result::corrupted;
+	}
+
+	const auto read{ [file](const size_t offset, std::span<uint8_t> to) {
+		return 0 == std::fseek(file, static_cast<long>(offset), SEEK_SET)
+			&& std::size(to) == std::fread(std::data(to), sizeof(uint8_t), std::size(to), file);
+	} };
+	return walk_chunks(read, static_cast<size_t>(total), out);
+}
+
+} // namespace gzn::audio::wav
@@ -0,0 +1,35 @@
+#include <esp_littlefs.h>
+
+#include "gzn/filesystem/backend/littlefs.hpp"
+
+namespace gzn::fs::backend {
+
+auto littlefs::mount(const mount_info &info) -> mount_error {
+	const esp_vfs_littlefs_conf_t config{
+		.base_path              = std::data(info.base_path),
+		.partition_label        = std::data(info.partition_label),
+		.format_if_mount_failed = info.format_if_mount_failed,
+	};
+	switch (esp_vfs_littlefs_register(&config)) {
+		case ESP_ERR_NO_MEM       : return mount_error::not_enough_memory;
+		case ESP_ERR_INVALID_STATE: return mount_error::already_mounted_or_encrypted;
+		case ESP_ERR_NOT_FOUND    : return mount_error::not_found;
+		case ESP_FAIL             : return mount_error::mount_failed;
+		default: break;
+	}
+	return mount_error::ok;
+}
+
+void littlefs::unmount(const std::string_view label) {
+	esp_vfs_littlefs_unregister(std::data(label));
+}
+
+auto littlefs::format(const std::string_view label) -> bool {
+	return esp_littlefs_format(std::data(label)) == ESP_OK;
+}
+
+auto littlefs::usage(const std::string_view label, size_t &total, size_t &used) -> bool {
+	return esp_littlefs_info(std::data(label), &total, &used) == ESP_OK;
+}
+
+} // namespace gzn::fs::backend
@@ -0,0 +1,146 @@
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gzn/filesystem/context.hpp"
+#include "gzn/filesystem/backend/posix.hpp"
+
+namespace gzn::fs::backend {
+
+namespace {
+
+struct host_mount {
+	std::string label{};
+	std::string base_path{};
+};
+
+posix::config                                   g_config{};
+std::array<host_mount, max_mounted_portations> g_mounts{};
+std::mutex                                      g_mounts_guard{};
+
+void delay(const uint64_t us) {
+	if (us != 0) {
+		std::this_thread::sleep_for(std::chrono::microseconds{ us });
+	}
+}
+
+auto host_path(const std::string_view label) -> std::string {
+	return std::string{ g_config.root } + '/' + std::string{ label };
+}
+
+/// `/assets/x.bin` to `<root>/assets/x.bin`, empty if nothing is mounted there
+auto host_file(const std::string_view file) -> std::string {
+	std::scoped_lock lock{ g_mounts_guard };
+	for (const auto &mounted : g_mounts) {
+		if (!std::empty(mounted.base_path)
+		&&  file.starts_with(mounted.base_path)
+		&&  file.substr(std::size(mounted.base_path)).starts_with('/')
+		) {
+			return host_path(mounted.label) + std::string{ file.substr(std::size(mounted.base_path)) };
+		}
+	}
+	return {};
+}
+
+} // namespace
+
+void posix::configure(const config &info) {
+	g_config = info;
+}
+
+auto posix::mount(const mount_info &info) -> mount_error {
+	struct stat folder{};
+	if (0 != stat(host_path(info.partition_label).c_str(), &folder) || !S_ISDIR(folder.st_mode)) {
+		return mount_error::not_found;
+	}
+
+	std::scoped_lock lock{ g_mounts_guard };
+	for (auto &mounted : g_mounts) {
+		if (std::empty(mounted.base_path)) {
+			mounted.label     = info.partition_label;
+			mounted.base_path = info.base_path;
+			return mount_error::ok;
+		}
+	}
+	return mount_error::max_mounted_portations_reached;
+}
+
+void posix::unmount(const std::string_view label) {
+	std::scoped_lock lock{ g_mounts_guard };
+	for (auto &mounted : g_mounts) {
+		if (mounted.label == label) {
+			mounted.label.clear();
+			mounted.base_path.clear();
+		}
+	}
+}
+
+auto posix::open(const std::string_view file) -> std::FILE * {
+	const auto path{ host_file(file) };
+	delay(g_config.open_latency_us);
+	return std::empty(path) ? nullptr : std::fopen(path.c_str(), "rb");
+}
+
+auto posix::seek(std::FILE *file, const size_t offset) -> bool {
+	delay(g_config.seek_latency_us);
+	return 0 == std::fseek(file, static_cast<long>(offset), SEEK_SET);
+}
+
+auto posix::read(std::FILE *file, const std::span<uint8_t> out) -> size_t {
+	const auto read{ std::fread(std::data(out), sizeof(uint8_t), std::size(out), file) };
+	delay(g_config.read_latency_us + (g_config.bytes_per_second != 0
+		? uint64_t{ read } * 1'000'000 / g_config.bytes_per_second
+		: 0
+	));
+	return std::ferror(file) ? SIZE_MAX : read;
+}
+
+auto posix::size(const std::string_view file) -> size_t {
+	const auto path{ host_file(file) };
+	struct stat info{};
+	return !std::empty(path) && 0 == stat(path.c_str(), &info) ? static_cast<size_t>(info.st_size) : SIZE_MAX;
+}
+
+auto posix::create(const std::string_view file) -> std::FILE * {
+	const auto path{ host_file(file) };
+	delay(g_config.open_latency_us);
+	return std::empty(path) ? nullptr : std::fopen(path.c_str(), "wb");
+}
+
+auto posix::remove(const std::string_view file) -> bool {
+	const auto path{ host_file(file) };
+	return !std::empty(path) && 0 == std::remove(path.c_str());
+}
+
+auto posix::map(const std::string_view label, mapping &out) -> mount_error {
+	const auto fd{ ::open((host_path(label) + ".bin").c_str(), O_RDONLY) };
+	if (fd < 0) {
+		return mount_error::not_found;
+	}
+
+	struct stat info{};
+	void *mapped{ MAP_FAILED };
+	if (0 == fstat(fd, &info) && info.st_size > 0) {
+		mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	::close(fd); // the mapping keeps the file
+	if (mapped == MAP_FAILED) {
+		return mount_error::mount_failed;
+	}
+
+	out = { .data{ static_cast<const uint8_t *>(mapped), static_cast<size_t>(info.st_size) } };
+	return mount_error::ok;
+}
+
+void posix::unmap(const mapping &mapped) {
+	munmap(const_cast<uint8_t *>(std::data(mapped.data)), std::size(mapped.data));
+}
+
+} // namespace gzn::fs::backend
@@ -0,0 +1,61 @@
+#include <sys/stat.h>
+
+#include <esp_partition.h>
+
+#include "gzn/filesystem/backend/vfs.hpp"
+
+namespace gzn::fs::backend {
+
+auto vfs::open(const std::string_view file) -> std::FILE * {
+	return std::fopen(std::data(file), "rb");
+}
+
+auto vfs::seek(std::FILE *file, const size_t offset) -> bool {
+	return 0 == std::fseek(file, static_cast<long>(offset), SEEK_SET);
+}
+
+auto vfs::read(std::FILE *file, const std::span<uint8_t> out) -> size_t {
+	const auto read{ std::fread(std::data(out), sizeof(uint8_t), std::size(out), file) };
+	return std::ferror(file) ? SIZE_MAX : read;
+}
+
+auto vfs::size(const std::string_view file) -> size_t {
+	struct stat info{};
+	return 0 == stat(std::data(file), &info) ? static_cast<size_t>(info.st_size) : SIZE_MAX;
+}
+
+auto vfs::create(const std::string_view file) -> std::FILE * {
+	return std::fopen(std::data(file), "wb");
+}
+
+auto vfs::remove(const std::string_view file) -> bool {
+	return 0 == std::remove(std::data(file));
+}
+
+auto vfs::map(const std::string_view label, mapping &out) -> mount_error {
+	const auto partition{ esp_partition_find_first(
+		ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, std::data(label)
+	) };
+	if (partition == nullptr) {
+		return mount_error::not_found;
+	}
+
+	const void                 *mapped{};
+	esp_partition_mmap_handle_t handle{};
+	switch (esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &mapped, &handle)) {
+		case ESP_OK           : break;
+		case ESP_ERR_NO_MEM   : return mount_error::not_enough_memory;
+		default               : return mount_error::mount_failed;
+	}
+	out = {
+		.data{ static_cast<const uint8_t *>(mapped), partition->size },
+		.handle{ handle },
+	};
+	return mount_error::ok;
+}
+
+void vfs::unmap(const mapping &mapped) {
+	esp_partition_munmap(mapped.handle);
+}
+
+} // namespace gzn::fs::backend
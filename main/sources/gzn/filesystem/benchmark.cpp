@@ -0,0 +1,237 @@
+#include <array>
+#include <cstdio>
+#include <utility>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#include "gzn/filesystem/manager.hpp"
+#include "gzn/filesystem/benchmark.hpp"
+
+namespace gzn::fs {
+
+static constexpr auto TAG{ "fs::benchmark" };
+
+namespace {
+
+using path_buffer = std::array<char, 64>;
+
+auto make_path(path_buffer &path, const std::string_view base_path, const char *name, const size_t index) -> std::string_view {
+	const auto length{ std::snprintf(std::data(path), std::size(path), "%.*s/bench-%s-%zu.bin",
+		static_cast<int>(std::size(base_path)), std::data(base_path), name, index
+	) };
+	return { std::data(path), static_cast<size_t>(std::clamp(length, 0, static_cast<int>(std::size(path)) - 1)) };
+}
+
+/// Writes @p size bytes of @p data over and over
+auto write_file(const driver &backend, const std::string_view file, const std::span<const uint8_t> data, const size_t size) -> bool {
+	auto out{ backend.create(file) };
+	if (out == nullptr) {
+		ESP_LOGE(TAG, R"(Cannot create "%.*s")", static_cast<int>(std::size(file)), std::data(file));
+		return false;
+	}
+	size_t written{};
+	while (written != size) {
+		const auto count{ std::min(size - written, std::size(data)) };
+		if (std::fwrite(std::data(data), sizeof(uint8_t), count, out) != count) {
+			break;
+		}
+		written += count;
+	}
+	std::fclose(out);
+	manager::notify_written(file, written);
+	return written == size;
+}
+
+[[nodiscard]]
+auto per_second(const size_t bytes, const int64_t us) -> uint32_t {
+	return us > 0 ? static_cast<uint32_t>(bytes * 1'000'000ull / static_cast<uint64_t>(us)) : 0;
+}
+
+[[nodiscard]]
+auto average(const int64_t us, const size_t count) -> uint32_t {
+	return count != 0 ? static_cast<uint32_t>(us / static_cast<int64_t>(count)) : 0;
+}
+
+/// xorshift32, the same offsets on every run
+[[nodiscard]]
+auto next_random(uint32_t &state) -> uint32_t {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+struct bench_run {
+	std::string_view        base_path{};
+	const benchmark_config &config;
+	const driver           &backend;
+	std::span<uint8_t>      buffer{};
+	benchmark_result       &result;
+
+	auto create_files() -> bool {
+		const auto begin{ esp_timer_get_time() };
+		for (size_t i{}; i < config.files; ++i) {
+			path_buffer path{};
+			if (!write_file(backend, make_path(path, base_path, "small", i), buffer, config.file_size)) {
+				return false;
+			}
+		}
+		result.create_us = average(esp_timer_get_time() - begin, config.files);
+
+		path_buffer path{};
+		const auto  stream_begin{ esp_timer_get_time() };
+		if (!write_file(backend, make_path(path, base_path, "stream", 0), buffer, config.stream_size)) {
+			return false;
+		}
+		result.write_bytes_per_second = per_second(config.stream_size, esp_timer_get_time() - stream_begin);
+		return true;
+	}
+
+	auto measure_opens() -> bool {
+		const auto begin{ esp_timer_get_time() };
+		for (size_t i{}; i < config.files; ++i) {
+			path_buffer path{};
+			if (!manager::open(make_path(path, base_path, "small", i), false)) {
+				return false;
+			}
+		}
+		result.open_us = average(esp_timer_get_time() - begin, config.files);
+		return true;
+	}
+
+	auto measure_reads() -> bool {
+		path_buffer path{};
+		const auto  file{ make_path(path, base_path, "stream", 0) };
+
+		// Uncached, as bulk loads read, so the numbers are of the backend
+		auto source{ manager::open(file, false) };
+		if (!source) {
+			return false;
+		}
+		size_t     bytes{};
+		const auto begin{ esp_timer_get_time() };
+		for (const auto chunk : source.chunks(buffer)) {
+			bytes += std::size(chunk);
+		}
+		result.read_bytes_per_second = per_second(bytes, esp_timer_get_time() - begin);
+		if (source.failed() || bytes != config.stream_size) {
+			return false;
+		}
+
+		const auto range{ config.stream_size - std::min<uint32_t>(config.seek_read, config.stream_size) + 1 };
+		const auto block{ buffer.first(std::min<size_t>(config.seek_read, std::size(buffer))) };
+		uint32_t   state{ 0x9E3779B9u };
+		const auto seeks_begin{ esp_timer_get_time() };
+		for (size_t i{}; i < config.seeks; ++i) {
+			source.seek(next_random(state) % range);
+			if (source.read_into(block) != std::size(block)) {
+				return false;
+			}
+		}
+		result.seek_us = average(esp_timer_get_time() - seeks_begin, config.seeks);
+		return true;
+	}
+
+	auto measure_writes() -> bool {
+		path_buffer path{};
+		const auto  file{ make_path(path, base_path, "writes", 0) };
+		auto out{ backend.create(file) };
+		if (out == nullptr) {
+			return false;
+		}
+
+		const auto record{ buffer.first(std::min<size_t>(config.write_size, std::size(buffer))) };
+		int64_t total{};
+		bool    written{ true };
+		for (size_t i{}; i < config.writes && written; ++i) {
+			const auto begin{ esp_timer_get_time() };
+			written = std::fwrite(std::data(record), sizeof(uint8_t), std::size(record), out) == std::size(record)
+				&& 0 == std::fflush(out)
+				&& 0 == fsync(fileno(out));
+			const auto elapsed{ esp_timer_get_time() - begin };
+			total              += elapsed;
+			result.write_max_us = std::max(result.write_max_us, static_cast<uint32_t>(elapsed));
+		}
+		std::fclose(out);
+		manager::notify_written(file, size_t{ config.writes } * std::size(record));
+		result.write_us = average(total, config.writes);
+		return written;
+	}
+
+	void remove_files() {
+		path_buffer path{};
+		for (size_t i{}; i < config.files; ++i) {
+			backend.remove(make_path(path, base_path, "small", i));
+		}
+		backend.remove(make_path(path, base_path, "stream", 0));
+		backend.remove(make_path(path, base_path, "writes", 0));
+	}
+};
+
+} // namespace
+
+auto benchmark::run(const std::string_view base_path, benchmark_result &result, const benchmark_config &config) -> bool {
+	path_buffer probe{};
+	const auto  backend{ manager::backend_of(make_path(probe, base_path, "small", 0)) };
+	if (backend == nullptr || !backend->create || !backend->remove) {
+		ESP_LOGE(TAG, R"("%.*s" isn't mounted or is read-only)",
+			static_cast<int>(std::size(base_path)), std::data(base_path)
+		);
+		return false;
+	}
+	if (config.files > max_benchmark_files || config.chunk_size == 0
+	||  std::max<size_t>({ config.seek_read, config.write_size }) > config.chunk_size
+	) {
+		return false;
+	}
+
+	const auto memory{ static_cast<uint8_t *>(heap_caps_malloc(config.chunk_size, MALLOC_CAP_8BIT)) };
+	if (memory == nullptr) {
+		return false;
+	}
+	const std::span buffer{ memory, config.chunk_size };
+	for (size_t i{}; i < std::size(buffer); ++i) {
+		buffer[i] = static_cast<uint8_t>(i * 31);
+	}
+
+	result = {};
+	bench_run bench{
+		.base_path{ base_path },
+		.config{ config },
+		.backend{ *backend },
+		.buffer{ buffer },
+		.result{ result },
+	};
+	const auto ok{ bench.create_files()
+		&& bench.measure_opens()
+		&& bench.measure_reads()
+		&& bench.measure_writes()
+	};
+	bench.remove_files();
+	heap_caps_free(memory);
+
+	if (!ok) {
+		ESP_LOGE(TAG, "Benchmark of %.*s failed",
+			static_cast<int>(std::size(base_path)), std::data(base_path)
+		);
+		return false;
+	}
+	ESP_LOGI(TAG, "%.*s on %.*s: open %u us, create %u us, read %u KB/s, write %u KB/s, "
+		"seek+read %u us, small write %u us (max %u us)",
+		static_cast<int>(std::size(base_path)), std::data(base_path),
+		static_cast<int>(std::size(backend->name)), std::data(backend->name),
+		static_cast<unsigned>(result.open_us), static_cast<unsigned>(result.create_us),
+		static_cast<unsigned>(result.read_bytes_per_second / 1024),
+		static_cast<unsigned>(result.write_bytes_per_second / 1024),
+		static_cast<unsigned>(result.seek_us),
+		static_cast<unsigned>(result.write_us), static_cast<unsigned>(result.write_max_us)
+	);
+	return true;
+}
+
+} // namespace gzn::fs
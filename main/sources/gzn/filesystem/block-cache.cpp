@@ -0,0 +1,58 @@
+#include <bit>
+#include <utility>
+
+#include "gzn/filesystem/block-cache.hpp"
+
+namespace gzn::fs {
+
+void block_cache::assign(const std::span<uint8_t> memory_, const uint32_t block_size_) {
+	block_size = std::bit_floor(block_size_);
+	shift      = static_cast<uint8_t>(std::countr_zero(block_size));
+	count      = block_size != 0
+		? static_cast<uint16_t>(std::min(std::size(memory_) / block_size, max_cache_blocks))
+		: 0;
+	memory     = memory_.first(count * block_size);
+	hand       = 0;
+	clear();
+}
+
+void block_cache::invalidate(const file_key &key) {
+	for (auto &item : std::span{ entries }.first(count)) {
+		if (item.key.same_path(key)) {
+			item.valid = false;
+		}
+	}
+}
+
+void block_cache::clear() {
+	entries.fill({});
+}
+
+auto block_cache::find(const file_key &key, const uint32_t block) const -> size_t {
+	for (size_t i{}; i < count; ++i) {
+		const auto &item{ entries[i] };
+		if (item.valid && item.key == key && item.block == block) {
+			return i;
+		}
+	}
+	return count;
+}
+
+auto block_cache::victim() -> size_t {
+	while (true) {
+		const auto index{ hand };
+		hand = static_cast<uint16_t>(hand + 1 == count ? 0 : hand + 1);
+
+		auto &item{ entries[index] };
+		if (!item.valid) {
+			return index;
+		}
+		if (!std::exchange(item.referenced, false)) {
+			++statistics.evictions;
+			item.valid = false;
+			return index;
+		}
+	}
+}
+
+} // namespace gzn::fs
@@ -0,0 +1,70 @@
+#include <cstring>
+
+#include "gzn/filesystem/compression.hpp"
+
+namespace gzn::fs::lz {
+
+auto read_header(const std::span<const uint8_t> data, header &info) -> bool {
+	if (std::size(data) < sizeof(header)) {
+		return false;
+	}
+	std::memcpy(&info, std::data(data), sizeof(info));
+	return info.magic == MAGIC
+		&& info.method == codec::lzss
+		&& info.window_bits != 0 && info.window_bits <= MAX_WINDOW_BITS
+		&& info.length_bits != 0 && info.length_bits <= MAX_LENGTH_BITS;
+}
+
+void decoder::reset(const header &info) {
+	window.fill(0);
+	bits        = 0;
+	remaining   = info.size;
+	head        = 0;
+	distance    = 0;
+	copy_left   = 0;
+	bit_count   = 0;
+	window_bits = info.window_bits;
+	length_bits = info.length_bits;
+}
+
+auto decoder::decode(std::span<const uint8_t> &in, const std::span<uint8_t> out) -> size_t {
+	constexpr uint16_t mask{ (1u << MAX_WINDOW_BITS) - 1 };
+
+	size_t produced{};
+	const auto emit{ [&](const uint8_t value) {
+		window[head++ & mask] = value;
+		out[produced++]       = value;
+		--remaining;
+	} };
+
+	while (produced < std::size(out) && remaining != 0) {
+		if (copy_left != 0) {
+			emit(window[(head - distance) & mask]);
+			--copy_left;
+			continue;
+		}
+
+		while (bit_count <= 24 && !std::empty(in)) {
+			bits      |= uint32_t{ in.front() } << (24 - bit_count);
+			bit_count += 8;
+			in         = in.subspan(1);
+		}
+
+		const bool    literal{ (bits >> 31) != 0 };
+		const uint8_t needed { static_cast<uint8_t>(literal ? 9 : 1 + window_bits + length_bits) };
+		if (bit_count < needed) {
+			break; // till more input
+		}
+
+		take(1);
+		if (literal) {
+			emit(static_cast<uint8_t>(take(8)));
+		} else {
+			distance  = static_cast<uint16_t>(take(window_bits) + 1);
+			copy_left = static_cast<uint8_t>(take(length_bits) + MIN_MATCH);
+		}
+	}
+	return produced;
+}
+
+} // namespace gzn::fs::lz
@@ -1,10 +1,14 @@
+#include <bit>
 #include <cerrno>
 #include <cstdio>
 #include <cstring>
 #include <utility>
+#include <algorithm>
 
 #include <esp_log.h>
-#include <esp_spiffs.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_memory_utils.h>
 
 #include "gzn/filesystem/manager.hpp"
 
@@ -13,39 +17,233 @@ namespace gzn::fs {
 
 static constexpr auto TAG{ "fs::manager" };
 
+namespace {
+
+/// Takes the guard held by the caller and gives it back
+void finish_request(context &ctx, io_slot &slot, const io_status status) {
+	slot.file.close();
+	slot.status = status;
+
+	const io_result result{
+		.id{ slot.id },
+		.status{ status },
+		.read{ slot.read },
+		.user{ slot.request.user },
+	};
+	const auto callback{ slot.request.on_complete };
+	const auto notify  { slot.request.notify };
+	xSemaphoreGive(ctx.io_guard);
+
+	if (callback) {
+		callback(result);
+	}
+	if (notify) {
+		xTaskNotifyGive(notify);
+	}
+}
+
+/**
+ * @brief One bounded step of the idle collection, see garbage_collector_config
+ * SPIFFS collects blocks till the requested bytes are free, so a slice asks
+ * for the estimated free space plus slice_bytes. Backends without
+ * driver::collect are skipped.
+ */
+void collect_garbage_slice(context &ctx) {
+	const auto &config{ ctx.gc_config };
+	if (config.can_collect && !config.can_collect()) {
+		return;
+	}
+
+	for (size_t i{}; i < std::size(ctx.mounted_partitions); ++i) {
+		const auto partition{ ctx.mounted_partitions[i] };
+		const auto backend  { ctx.backends[i] };
+		size_t total{};
+		size_t used {};
+		if (std::empty(partition)
+		||  !backend->collect || !backend->usage
+		||  !backend->usage(partition, total, used)
+		||  total == 0
+		) {
+			continue;
+		}
+
+		auto &state{ ctx.gc_states[i] };
+		state.churn    += used > state.last_used ? used - state.last_used : state.last_used - used;
+		state.last_used = used;
+
+		const auto free{ total - std::min(used, total) };
+		if (state.churn == 0
+		|| (free * 100 >= total * config.min_free_percent && state.churn < config.churn_threshold)
+		) {
+			continue;
+		}
+
+		const auto request{ std::min(free, free - std::min(state.churn, free) + state.slice_bytes) };
+		const auto begin  { esp_timer_get_time() };
+		const auto result { backend->collect(partition, request) };
+		const auto elapsed{ static_cast<uint32_t>(esp_timer_get_time() - begin) };
+
+		state.churn = result
+			? state.churn - std::min(state.churn, size_t{ state.slice_bytes })
+			: 0; // nothing left to collect
+		if (elapsed > config.slice_budget_us) {
+			state.slice_bytes = std::max(state.slice_bytes / 2, min_gc_slice_bytes);
+		} else if (elapsed < config.slice_budget_us / 2) {
+			state.slice_bytes = std::min(state.slice_bytes * 2, max_gc_slice_bytes);
+		}
+		ESP_LOGD(TAG, R"(GC slice of "%.*s": %lu us, %zu bytes of churn left)",
+			static_cast<int>(std::size(partition)), std::data(partition),
+			static_cast<unsigned long>(elapsed), state.churn
+		);
+		return; // a partition a slice
+	}
+}
+
+void io_task(void *user) {
+	auto &ctx{ *static_cast<context *>(user) };
+
+	while (ctx.io_running) {
+		xSemaphoreTake(ctx.io_guard, portMAX_DELAY);
+		auto slot{ ctx.next_request() };
+		if (slot == nullptr) {
+			xSemaphoreGive(ctx.io_guard);
+			// Idle: no reads wait, so the flash has time for the garbage
+			if (0 == ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ctx.gc_config.idle_interval_ms))) {
+				collect_garbage_slice(ctx);
+			}
+			continue;
+		}
+		if (slot->cancel) {
+			finish_request(ctx, *slot, io_status::cancelled);
+			continue;
+		}
+
+		// Only this task writes the file and the progress, so they are used unlocked
+		slot->status = io_status::reading;
+		const auto request{ slot->request };
+		const auto offset { slot->read };
+		auto      &file   { slot->file };
+		xSemaphoreGive(ctx.io_guard);
+
+		if (!file.is_open()) {
+			// Bulk loads are read once, only the hot requests go through the cache
+			file = manager::open(request.file, !request.uncached && request.priority <= io_priority::high);
+			file.seek(request.offset);
+		}
+		const auto chunk{ std::min(std::size(request.destination) - offset, default_chunk_size) };
+		const auto read { file.read_into(std::span{ request.destination }.subspan(offset, chunk)) };
+
+		auto status{ io_status::reading };
+		if (!file.is_open()) {
+			status = io_status::failed;
+		} else if (read < chunk || offset + read == std::size(request.destination)) {
+			status = io_status::done; // EOF or full
+		}
+
+		xSemaphoreTake(ctx.io_guard, portMAX_DELAY);
+		slot->read += read;
+		if (status == io_status::reading && slot->cancel) {
+			status = io_status::cancelled;
+		}
+		if (status == io_status::reading) {
+			xSemaphoreGive(ctx.io_guard);
+		} else {
+			finish_request(ctx, *slot, status);
+		}
+	}
+
+	// FreeRTOS tasks must not return
+	ctx.io_task = nullptr;
+	vTaskDelete(nullptr);
+}
+
+} // namespace
+
 auto manager::initialize(const setup_info &info) -> bool {
 	if (ctx) {
 		return false;
 	}
 
+	if (info.backend == nullptr) {
+		ESP_LOGE(TAG, "No file system backend");
+		return false;
+	}
+
 	ctx = std::make_unique<context>();
 	if (!ctx) {
 		return false;
 	}
 
-	ctx->gc_config = info.gc_config;
+	ctx->default_backend = info.backend;
+	ctx->gc_config   = info.gc_config;
+	ctx->io_guard    = xSemaphoreCreateMutex();
+	ctx->cache_guard = xSemaphoreCreateMutex();
+	ctx->io_running  = true;
+
+	const auto block_size{ std::bit_floor(info.cache.block_size) };
+	const auto cache_size{ size_t{ block_size } * std::min<size_t>(info.cache.block_count, max_cache_blocks) };
+	if (cache_size != 0) {
+		auto memory{ heap_caps_malloc(cache_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) };
+		if (memory == nullptr) {
+			memory = heap_caps_malloc(cache_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+		}
+		if (memory == nullptr) {
+			ESP_LOGW(TAG, "No memory for the %zu bytes block cache, reading uncached", cache_size);
+		} else {
+			ctx->cache_memory = std::span{ static_cast<uint8_t *>(memory), cache_size };
+			ctx->cache.assign(ctx->cache_memory, block_size);
+			ESP_LOGI(TAG, "Block cache: %zu x %lu bytes in %s", cache_size / block_size,
+				static_cast<unsigned long>(block_size),
+				esp_ptr_external_ram(memory) ? "PSRAM" : "internal RAM"
+			);
+		}
+	}
+
+	const auto status{ xTaskCreatePinnedToCore(
+		io_task, "fs_io_task",
+		io_task_stack_size, ctx.get(),
+		io_task_priority, &ctx->io_task,
+		io_task_core_id
+	) };
+	if (ctx->io_guard == nullptr || ctx->cache_guard == nullptr || status != pdPASS) {
+		ESP_LOGE(TAG, "Cannot start the I/O task");
+		destroy();
+		return false;
+	}
 	return true;
 };
 
 void manager::destroy() {
 	if (!ctx) { return; }
 
-	for (auto &partition : ctx->mounted_partitions) {
+	ctx->io_running = false;
+	if (ctx->io_task) {
+		xTaskNotifyGive(ctx->io_task);
+	}
+	while (ctx->io_task) {
+		vTaskDelay(pdMS_TO_TICKS(10)); // lets the current chunk finish
+	}
+
+	for (const auto partition : ctx->mounted_partitions) {
 		if (!std::empty(partition)) {
-			esp_vfs_spiffs_unregister(std::data(partition));
-			partition = std::string_view{};
+			unmount(partition);
 		}
 	}
-};
+	unmount_pack();
 
-void manager::update() {
-	assert(ctx != nullptr && "Use manager::update before successful manager::initialization!");
+	for (auto &slot : ctx->io_slots) {
+		slot.file.close();
+	}
+	if (ctx->io_guard) {
+		vSemaphoreDelete(std::exchange(ctx->io_guard, nullptr));
+	}
 
-	if (ctx->gc_counter == ctx->gc_config.cleanup_frequency) {
-		collect_garbage();
-		ctx->gc_counter = 0u;
+	ctx->cache.assign({}, 0);
+	heap_caps_free(std::data(std::exchange(ctx->cache_memory, {})));
+	if (ctx->cache_guard) {
+		vSemaphoreDelete(std::exchange(ctx->cache_guard, nullptr));
 	}
-}
+};
 
 auto manager::mount(const mount_info &info) -> mount_error {
 	if (std::empty(info.base_path) || std::empty(info.partition_label)) {
@@ -57,40 +255,49 @@ auto manager::mount(const mount_info &info) -> mount_error {
 		return mount_error::max_mounted_portations_reached;
 	}
 
-	if (is_mounted(info.partition_label) || is_mounted(info.base_path)) {
+	if (is_mounted(info.partition_label)) {
 		return mount_error::already_mounted;
 	}
 
-	const esp_vfs_spiffs_conf_t config{
-		.base_path              = std::data(info.base_path),
-		.partition_label        = std::data(info.partition_label),
-		.max_files              = info.max_simultanious_opened_files,
-		.format_if_mount_failed = info.format_if_mount_failed
-	};
-	switch (esp_vfs_spiffs_register(&config)) {
-		case ESP_ERR_NO_MEM       : return mount_error::not_enough_memory;
-		case ESP_ERR_INVALID_STATE: return mount_error::already_mounted_or_encrypted;
-		case ESP_ERR_NOT_FOUND    : return mount_error::not_found;
-		case ESP_FAIL             : return mount_error::mount_failed;
-		default: break;
+	const auto backend{ info.backend ? info.backend : ctx->default_backend };
+	if (const auto err{ backend->mount(info) }; err != mount_error::ok) {
+		return err;
 	}
 
 	ctx->mounted_partitions[mount_id] = info.partition_label;
+	ctx->backends[mount_id]           = backend;
+	ctx->gc_states[mount_id]          = {};
+	if (size_t total{}; backend->usage) {
+		backend->usage(info.partition_label, total, ctx->gc_states[mount_id].last_used);
+	}
+	ESP_LOGI(TAG, R"(Mounted "%.*s" with %.*s)",
+		static_cast<int>(std::size(info.partition_label)), std::data(info.partition_label),
+		static_cast<int>(std::size(backend->name)), std::data(backend->name)
+	);
 
 	return mount_error::ok;
 }
 
 
 void manager::unmount(const std::string_view portation) {
-	std::ignore = esp_vfs_spiffs_unregister(std::data(portation));
+	const auto mount_id{ ctx->find_mount(portation) };
+	if (mount_id == context::npos) {
+		return;
+	}
+	ctx->backends[mount_id]->unmount(portation);
+	ctx->mounted_partitions[mount_id] = {};
+	ctx->backends[mount_id]           = nullptr;
 }
 
 auto manager::is_mounted(const std::string_view portation) -> bool {
-	return esp_spiffs_mounted(std::data(portation));
+	return ctx->find_portation(portation);
 }
 
 auto manager::format(const std::string_view portation) -> bool {
-	return esp_spiffs_format(std::data(portation)) == ESP_OK;
+	const auto mount_id{ ctx->find_mount(portation) };
+	return mount_id != context::npos
+		&& ctx->backends[mount_id]->format
+		&& ctx->backends[mount_id]->format(portation);
 }
 
 auto manager::can_open(const std::string_view file) -> bool {
@@ -118,104 +325,173 @@ auto manager::can_open(const std::string_view file) -> bool {
 	return true;
 }
 
-auto manager::read_file(
-	const std::string_view file,
-	const file_callbacks &callbacks,
-	void *const user
-) -> bool {
-	if (std::empty(callbacks) || !can_open(file)) {
-		return false;
+auto manager::file_size(const std::string_view file) -> size_t {
+	const auto backend{ ctx->backend_of(file) };
+	return backend ? backend->size(file) : SIZE_MAX;
+}
+
+auto manager::backend_of(const std::string_view file) -> const driver * {
+	return ctx->backend_of(file);
+}
+
+auto manager::mount_pack(const std::string_view partition_label) -> mount_error {
+	if (std::empty(partition_label)) {
+		return mount_error::invalid_argument;
+	}
+	if (!std::empty(ctx->pack.data)) {
+		return mount_error::already_mounted;
+	}
+	if (!ctx->default_backend->map) {
+		return mount_error::not_found;
 	}
 
-	auto file_descriptor{ std::fopen(std::data(file), "rb") };
-	if (!file_descriptor) {
-		ESP_LOGE(TAG, R"(Cannot open "%.*s" file: %s)",
-			static_cast<int>(std::size(file)), std::data(file),
-			std::strerror(errno)
+	mapping mapped{};
+	if (const auto err{ ctx->default_backend->map(partition_label, mapped) }; err != mount_error::ok) {
+		return err;
+	}
+
+	if (const auto err{ pack::validate(mapped.data) }; err != pack::error::ok) {
+		ESP_LOGE(TAG, R"(Partition "%.*s" has no valid asset pack: %u)",
+			static_cast<int>(std::size(partition_label)), std::data(partition_label),
+			std::to_underlying(err)
 		);
-		return false;
+		ctx->default_backend->unmap(mapped);
+		return mount_error::invalid_pack;
 	}
 
-	std::array<uint8_t, buffer_length> buffer{};
+	ctx->pack = mapped;
+	ESP_LOGI(TAG, "Asset pack mapped: %zu assets", std::size(pack::entries(mapped.data)));
+	return mount_error::ok;
+}
+
+void manager::unmount_pack() {
+	if (std::empty(ctx->pack.data)) {
+		return;
+	}
+	ctx->default_backend->unmap(ctx->pack);
+	ctx->pack = {};
+}
+
+auto manager::find_asset(const pack::hash_t hash) -> std::span<const uint8_t> {
+	return pack::find(ctx->pack.data, hash);
+}
 
-	const auto read_cb{ [&buffer, file_descriptor](const size_t count){
-		const size_t read{ std::fread(
-			std::data(buffer), sizeof(uint8_t),
-			std::min(count, std::size(buffer)),
-			file_descriptor
-		) };
-		return std::span{ std::data(buffer), read };
-	} };
+auto manager::submit(const read_request &request) -> request_id {
+	if (!ctx->io_running || !can_open(request.file)) {
+		return invalid_request;
+	}
 
-	if (callbacks.on_open && !callbacks.on_open(read_cb, user)) {
-		std::fclose(file_descriptor);
-		return true;
+	xSemaphoreTake(ctx->io_guard, portMAX_DELAY);
+	const auto slot{ ctx->reusable_slot() };
+	if (slot == nullptr) {
+		xSemaphoreGive(ctx->io_guard);
+		ESP_LOGW(TAG, R"(I/O queue is full, "%.*s" isn't read)",
+			static_cast<int>(std::size(request.file)), std::data(request.file)
+		);
+		return invalid_request;
 	}
 
-	while (!std::feof(file_descriptor) && callbacks.on_read(read_cb, user)) {}
+	if (++ctx->last_request == invalid_request) {
+		++ctx->last_request;
+	}
+	*slot = io_slot{
+		.request{ request },
+		.id{ ctx->last_request },
+		.status{ io_status::pending },
+	};
+	const auto id{ slot->id };
+	xSemaphoreGive(ctx->io_guard);
 
-	std::fclose(file_descriptor);
-	return true;
+	xTaskNotifyGive(ctx->io_task);
+	return id;
 }
 
+auto manager::cancel(const request_id id) -> bool {
+	xSemaphoreTake(ctx->io_guard, portMAX_DELAY);
+	const auto slot{ ctx->find_request(id) };
+	const auto active{ slot != nullptr && slot->is_active() };
+	if (active) {
+		slot->cancel = true;
+	}
+	xSemaphoreGive(ctx->io_guard);
 
-auto manager::read_file_loop(
-	const std::string_view file,
-	const file_callbacks &callbacks,
-	void *const user
-) -> bool {
-	if (std::empty(callbacks) || !can_open(file)) {
-		return false;
+	if (active) {
+		xTaskNotifyGive(ctx->io_task);
 	}
+	return active;
+}
 
-	auto file_descriptor{ std::fopen(std::data(file), "rb") };
-	if (!file_descriptor) {
-		ESP_LOGE(TAG, R"(Cannot open "%.*s" file: %s)",
-			static_cast<int>(std::size(file)), std::data(file),
-			std::strerror(errno)
-		);
-		return false;
+auto manager::status(const request_id id) -> io_result {
+	xSemaphoreTake(ctx->io_guard, portMAX_DELAY);
+	io_result result{ .id{ id } };
+	if (const auto slot{ ctx->find_request(id) }; slot != nullptr) {
+		result.status = slot->status;
+		result.read   = slot->read;
+		result.user   = slot->request.user;
 	}
+	xSemaphoreGive(ctx->io_guard);
+	return result;
+}
+
+auto manager::cache_stats() -> fs::cache_stats {
+	xSemaphoreTake(ctx->cache_guard, portMAX_DELAY);
+	const auto stats{ ctx->cache.stats() };
+	xSemaphoreGive(ctx->cache_guard);
+	return stats;
+}
 
-	std::array<uint8_t, buffer_length> buffer{};
-	const auto read_cb{ [&buffer, file_descriptor](const size_t count){
-		const size_t read{ std::fread(
-			std::data(buffer), sizeof(uint8_t),
-			std::min(count, std::size(buffer)),
-			file_descriptor
-		) };
-		return std::span{ std::data(buffer), read };
-	} };
+void manager::reset_cache_stats() {
+	xSemaphoreTake(ctx->cache_guard, portMAX_DELAY);
+	ctx->cache.reset_stats();
+	xSemaphoreGive(ctx->cache_guard);
+}
 
-	if (callbacks.on_open && !callbacks.on_open(read_cb, user)) {
-		std::fclose(file_descriptor);
-		return true;
-	}
+void manager::invalidate_cache(const std::string_view file) {
+	xSemaphoreTake(ctx->cache_guard, portMAX_DELAY);
+	ctx->cache.invalidate(file_key::of(file));
+	xSemaphoreGive(ctx->cache_guard);
+}
 
-	const auto base_offset{ std::ftell(file_descriptor) };
-	while (callbacks.on_read(read_cb, user)) {
-		if (std::feof(file_descriptor)) {
-			std::fseek(file_descriptor, base_offset, SEEK_SET);
+void manager::notify_written(const std::string_view file, const size_t bytes) {
+	invalidate_cache(file);
+
+	const auto second_sep{ file.find_first_of(sep, 1) };
+	const auto port      { file.substr(1, second_sep == std::string_view::npos ? 0 : second_sep - 1) };
+	for (size_t i{}; i < std::size(ctx->mounted_partitions); ++i) {
+		if (ctx->mounted_partitions[i] == port) {
+			ctx->gc_states[i].churn += bytes;
 		}
 	}
+}
 
-	std::fclose(file_descriptor);
-	return true;
+auto manager::open(const std::string_view file, const bool cached) -> reader {
+	if (!can_open(file)) {
+		return {};
+	}
+	reader result{ file, cached, ctx->backend_of(file) };
+	if (!result.open()) {
+		return {};
+	}
+	return result;
 }
 
 
 void manager::collect_garbage() {
 	ESP_LOGI(TAG, "Collecting garbage");
-	for (const auto partition : ctx->mounted_partitions) {
-		if (std::empty(partition)) {
+	for (size_t i{}; i < std::size(ctx->mounted_partitions); ++i) {
+		const auto partition{ ctx->mounted_partitions[i] };
+		const auto backend  { ctx->backends[i] };
+		size_t total{};
+		size_t used {};
+		if (std::empty(partition)
+		||  !backend->collect || !backend->usage
+		||  !backend->usage(partition, total, used)
+		) {
 			continue;
 		}
-
-		for (size_t attemts{ ctx->gc_config.cleanup_attempts }; attemts != 0; --attemts) {
-			if (ESP_ERR_NOT_FINISHED != esp_spiffs_gc(std::data(partition), 1024 * 1024)) {
-				break;
-			}
-		}
+		// Asking for all the free space collects every deleted page
+		backend->collect(partition, total - std::min(used, total));
+		ctx->gc_states[i] = { .last_used{ used } };
 	}
 }
 
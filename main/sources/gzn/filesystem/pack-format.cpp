@@ -0,0 +1,63 @@
+#include <cstring>
+#include <algorithm>
+
+#include "gzn/filesystem/pack-format.hpp"
+
+namespace gzn::fs::pack {
+
+auto validate(const std::span<const uint8_t> blob) -> error {
+	if (std::size(blob) < sizeof(header)) {
+		return error::too_small;
+	}
+
+	header head{};
+	std::memcpy(&head, std::data(blob), sizeof(head));
+	if (head.magic != MAGIC) {
+		return error::bad_magic;
+	}
+	if (head.version != VERSION || head.alignment != ALIGNMENT) {
+		return error::unsupported_version;
+	}
+
+	const auto index_end{ sizeof(header) + uint64_t{ head.count } * sizeof(entry) };
+	// The partition is usually bigger than the pack, but never smaller
+	if (head.size > std::size(blob) || index_end > head.size) {
+		return error::too_small;
+	}
+	if (reinterpret_cast<uintptr_t>(std::data(blob)) % alignof(entry) != 0) {
+		return error::corrupted;
+	}
+
+	const auto all{ entries(blob) };
+	for (size_t i{}; i < std::size(all); ++i) {
+		const auto &item{ all[i] };
+		if ((i != 0 && all[i - 1].hash >= item.hash)
+		||  item.offset < index_end
+		||  item.offset % ALIGNMENT != 0
+		||  uint64_t{ item.offset } + item.size > head.size
+		) {
+			return error::corrupted;
+		}
+	}
+	return error::ok;
+}
+
+auto entries(const std::span<const uint8_t> blob) -> std::span<const entry> {
+	const auto &head{ *reinterpret_cast<const header *>(std::data(blob)) };
+	return std::span{ reinterpret_cast<const entry *>(std::data(blob) + sizeof(header)), head.count };
+}
+
+auto find(const std::span<const uint8_t> blob, const hash_t hash) -> std::span<const uint8_t> {
+	if (std::empty(blob)) {
+		return {};
+	}
+
+	const auto all{ entries(blob) };
+	const auto found{ std::ranges::lower_bound(all, hash, {}, &entry::hash) };
+	if (found == std::end(all) || found->hash != hash) {
+		return {};
+	}
+	return blob.subspan(found->offset, found->size);
+}
+
+} // namespace gzn::fs::pack
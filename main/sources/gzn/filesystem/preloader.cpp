@@ -0,0 +1,341 @@
+#include <atomic>
+#include <utility>
+#include <algorithm>
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "gzn/filesystem/manager.hpp"
+#include "gzn/filesystem/preloader.hpp"
+#include "gzn/filesystem/compression.hpp"
+
+namespace gzn::fs {
+
+static constexpr auto TAG{ "fs::preloader" };
+
+namespace {
+
+struct pending_load {
+	size_t                 index{};
+	request_id             id{ invalid_request };
+	std::span<uint8_t>     target{};  ///< the asset
+	std::span<uint8_t>     buffer{};  ///< the file, the target itself unless it's compressed
+	std::atomic<io_status> status{ io_status::unknown };
+	size_t                 read{};
+	bool                   compressed{ false };
+};
+
+struct preload_context {
+	std::array<manifest_entry, max_manifest_assets> manifest{};
+	std::array<size_t, max_manifest_assets>         sizes{};
+	size_t                                          count{};
+	std::array<asset_set, 2>                        sets{};
+	std::atomic<asset_set *>                        active{ &sets[0] };
+	asset_set                                      *staging{ &sets[1] };
+	std::atomic<preload_state>                      state{ preload_state::idle };
+	std::atomic<uint32_t>                           assets_done{};
+	std::atomic<uint32_t>                           bytes_done{};
+	std::atomic<uint32_t>                           bytes_total{};
+	std::atomic<bool>                               cancel{ false };
+};
+
+preload_context g_preload{};
+
+[[nodiscard]]
+auto allocate(const size_t size, const memory_class memory) -> std::span<uint8_t> {
+	void *data{};
+	switch (memory) {
+		case memory_class::internal:
+			data = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+			break;
+		case memory_class::simd:
+			data = heap_caps_aligned_alloc(simd_alignment, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+			break;
+		case memory_class::psram:
+			data = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+			if (data == nullptr) {
+				data = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+			}
+			break;
+	}
+	return data != nullptr ? std::span{ static_cast<uint8_t *>(data), size } : std::span<uint8_t>{};
+}
+
+void release(pending_load &load) {
+	if (std::data(load.buffer) != std::data(load.target)) {
+		heap_caps_free(std::data(std::exchange(load.buffer, {})));
+	}
+	heap_caps_free(std::data(std::exchange(load.target, {})));
+}
+
+/// Called on the I/O task
+void on_loaded(const io_result &result) {
+	auto &load{ *static_cast<pending_load *>(result.user) };
+	load.read = result.read;
+	load.status.store(result.status, std::memory_order_release);
+}
+
+[[nodiscard]]
+auto is_over(const io_status status) -> bool {
+	return status != io_status::pending && status != io_status::reading;
+}
+
+void wait_for(pending_load &load) {
+	while (!is_over(load.status.load(std::memory_order_acquire))) {
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));
+	}
+}
+
+/// Allocates the asset and queues its read
+auto submit_load(preload_context &ctx, const size_t index, pending_load &load) -> bool {
+	const auto &entry{ ctx.manifest[index] };
+	const auto  size { ctx.sizes[index] };
+
+	lz::header info{};
+	{
+		std::array<uint8_t, sizeof(lz::header)> raw{};
+		auto probe{ manager::open(entry.file, false) };
+		if (!probe) {
+			return false;
+		}
+		load.compressed = probe.read_into(raw) == std::size(raw) && lz::read_header(raw, info);
+	}
+
+	load.index  = index;
+	load.read   = 0;
+	load.status = io_status::pending;
+	if (size == 0) {
+		load.id     = invalid_request;
+		load.status = io_status::done;
+		return true;
+	}
+
+	load.target = allocate(load.compressed ? info.size : size, entry.memory);
+	load.buffer = load.compressed ? allocate(size, memory_class::psram) : load.target;
+	if ((std::empty(load.target) && info.size != 0) || std::empty(load.buffer)) {
+		ESP_LOGE(TAG, R"(No memory for "%.*s", %zu bytes)",
+			static_cast<int>(std::size(entry.file)), std::data(entry.file), size
+		);
+		release(load);
+		return false;
+	}
+
+	const read_request request{
+		.file{ entry.file },
+		.destination{ load.buffer },
+		.priority{ io_priority::background },
+		.on_complete{ on_loaded },
+		.user{ &load },
+		.notify{ xTaskGetCurrentTaskHandle() },
+	};
+	// The queue is shared, so a full one only means waiting a bit
+	for (size_t attempt{}; attempt < 100 && !ctx.cancel; ++attempt) {
+		if ((load.id = manager::submit(request)) != invalid_request) {
+			return true;
+		}
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+	release(load);
+	return false;
+}
+
+/// Decodes the compressed asset and adds it to the staging set
+auto finish_load(preload_context &ctx, pending_load &load) -> bool {
+	const auto &entry{ ctx.manifest[load.index] };
+	const auto  size { ctx.sizes[load.index] };
+	if (load.status != io_status::done || load.read != size) {
+		ESP_LOGE(TAG, R"(Cannot load "%.*s": %zu of %zu bytes)",
+			static_cast<int>(std::size(entry.file)), std::data(entry.file), load.read, size
+		);
+		release(load);
+		return false;
+	}
+
+	if (load.compressed) {
+		decompressor source{ std::span<const uint8_t>{ load.buffer } };
+		const auto decoded{ source.read_into(load.target) };
+		heap_caps_free(std::data(std::exchange(load.buffer, load.target)));
+		if (decoded != std::size(load.target) || !source.eof()) {
+			ESP_LOGE(TAG, R"("%.*s" is corrupted)",
+				static_cast<int>(std::size(entry.file)), std::data(entry.file)
+			);
+			release(load);
+			return false;
+		}
+	}
+
+	ctx.staging->add(pack::hash(entry.file), std::exchange(load.target, {}));
+	load.buffer = {};
+	ctx.bytes_done  += size;
+	ctx.assets_done += 1;
+	return true;
+}
+
+void preload_task(void *) {
+	auto &ctx{ g_preload };
+	auto  status{ preload_state::ready };
+
+	// Sizes first, so the progress has the total from the very start
+	size_t total{};
+	for (size_t i{}; i < ctx.count; ++i) {
+		const auto file{ ctx.manifest[i].file };
+		ctx.sizes[i] = manager::file_size(file);
+		if (ctx.sizes[i] == SIZE_MAX) {
+			ESP_LOGE(TAG, R"(No "%.*s" file)", static_cast<int>(std::size(file)), std::data(file));
+			status = preload_state::failed;
+			break;
+		}
+		total += ctx.sizes[i];
+	}
+	ctx.bytes_total = static_cast<uint32_t>(total);
+
+	// The I/O task reads the next assets while this one decodes
+	std::array<pending_load, preload_pipeline_depth> loads{};
+	size_t first{};
+	size_t in_flight{};
+	size_t next{};
+	while (status == preload_state::ready) {
+		while (in_flight < std::size(loads) && next < ctx.count && !ctx.cancel) {
+			if (!submit_load(ctx, next, loads[(first + in_flight) % std::size(loads)])) {
+				status = preload_state::failed;
+				break;
+			}
+			++in_flight;
+			++next;
+		}
+		if (ctx.cancel) {
+			status = preload_state::cancelled;
+		}
+		if (in_flight == 0 || status != preload_state::ready) {
+			break;
+		}
+
+		auto &load{ loads[first] };
+		wait_for(load);
+		if (!finish_load(ctx, load)) {
+			status = preload_state::failed;
+		}
+		first = (first + 1) % std::size(loads);
+		--in_flight;
+	}
+
+	// Nothing may read into the memory which is about to be freed
+	for (; in_flight != 0; --in_flight, first = (first + 1) % std::size(loads)) {
+		auto &load{ loads[first] };
+		std::ignore = manager::cancel(load.id);
+		wait_for(load);
+		release(load);
+	}
+	if (status != preload_state::ready) {
+		ctx.staging->release();
+	}
+
+	ESP_LOGI(TAG, "Preload is over: %u of %zu assets",
+		static_cast<unsigned>(ctx.assets_done), ctx.count
+	);
+	ctx.state = status;
+	vTaskDelete(nullptr);
+}
+
+} // namespace
+
+auto asset_set::find(const pack::hash_t hash) const -> std::span<const uint8_t> {
+	for (const auto &asset : std::span{ assets }.first(count)) {
+		if (asset.hash == hash) {
+			return asset.data;
+		}
+	}
+	return {};
+}
+
+auto asset_set::add(const pack::hash_t hash, const std::span<uint8_t> data) -> bool {
+	if (count == std::size(assets)) {
+		return false;
+	}
+	assets[count++] = { .hash{ hash }, .data{ data } };
+	return true;
+}
+
+void asset_set::release() {
+	for (auto &asset : std::span{ assets }.first(count)) {
+		heap_caps_free(std::data(std::exchange(asset.data, {})));
+	}
+	count = 0;
+}
+
+auto preloader::start(const std::span<const manifest_entry> manifest) -> bool {
+	auto &ctx{ g_preload };
+	if (std::size(manifest) > max_manifest_assets || ctx.state == preload_state::loading) {
+		return false;
+	}
+
+	ctx.staging->release();
+	std::ranges::copy(manifest, std::begin(ctx.manifest));
+	ctx.count       = std::size(manifest);
+	ctx.assets_done = 0;
+	ctx.bytes_done  = 0;
+	ctx.bytes_total = 0;
+	ctx.cancel      = false;
+	ctx.state       = preload_state::loading;
+
+	const auto status{ xTaskCreatePinnedToCore(
+		preload_task, "fs_preload_task",
+		preload_task_stack_size, nullptr,
+		io_task_priority, nullptr,
+		io_task_core_id
+	) };
+	if (status != pdPASS) {
+		ESP_LOGE(TAG, "Cannot start the preload task");
+		ctx.state = preload_state::failed;
+		return false;
+	}
+	return true;
+}
+
+void preloader::cancel() {
+	auto &ctx{ g_preload };
+	ctx.cancel = true;
+	while (ctx.state == preload_state::loading) {
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+}
+
+auto preloader::progress() -> preload_progress {
+	const auto &ctx{ g_preload };
+	return {
+		.state{ ctx.state },
+		.assets_done{ static_cast<uint16_t>(ctx.assets_done.load()) },
+		.assets_total{ static_cast<uint16_t>(ctx.count) },
+		.bytes_done{ ctx.bytes_done },
+		.bytes_total{ ctx.bytes_total },
+	};
+}
+
+auto preloader::commit() -> bool {
+	auto &ctx{ g_preload };
+	if (ctx.state != preload_state::ready) {
+		return false;
+	}
+
+	const auto previous{ ctx.active.exchange(ctx.staging) };
+	previous->release();
+	ctx.staging = previous;
+	ctx.state   = preload_state::idle;
+	return true;
+}
+
+auto preloader::find(const pack::hash_t hash) -> std::span<const uint8_t> {
+	return g_preload.active.load()->find(hash);
+}
+
+void preloader::destroy() {
+	auto &ctx{ g_preload };
+	cancel();
+	ctx.staging->release();
+	ctx.active.load()->release();
+	ctx.state = preload_state::idle;
+}
+
+} // namespace gzn::fs
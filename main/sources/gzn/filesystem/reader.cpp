@@ -0,0 +1,121 @@
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <esp_log.h>
+
+#include "gzn/filesystem/reader.hpp"
+#include "gzn/filesystem/manager.hpp"
+
+namespace gzn::fs {
+
+static constexpr auto TAG{ "fs::reader" };
+
+reader::reader(const std::string_view path_, const bool cached_, const driver *backend_)
+	: path{ path_ }
+	, backend{ backend_ }
+	, key{ file_key::of(path_) }
+	, cached{ cached_ } {}
+
+reader::reader(reader &&other) noexcept
+	: path    { std::exchange(other.path, {}) }
+	, file    { std::exchange(other.file, nullptr) }
+	, backend { other.backend }
+	, position{ other.position }
+	, key     { other.key }
+	, cached  { other.cached }
+	, end     { other.end }
+	, error   { other.error } {}
+
+auto reader::operator=(reader &&other) noexcept -> reader & {
+	if (this != &other) {
+		close();
+		path     = std::exchange(other.path, {});
+		file     = std::exchange(other.file, nullptr);
+		backend  = other.backend;
+		position = other.position;
+		key      = other.key;
+		cached   = other.cached;
+		end      = other.end;
+		error    = other.error;
+	}
+	return *this;
+}
+
+void reader::close() {
+	if (file) {
+		std::fclose(std::exchange(file, nullptr));
+	}
+	path = {};
+}
+
+auto reader::open() -> bool {
+	auto &ctx{ *manager::ctx };
+	if (!cached || !ctx.cache.enabled()) {
+		return ensure_open();
+	}
+
+	// Blocks are served only for a file which is still there, and the size
+	// keys them, so a file rewritten without notify_written() mostly misses
+	const auto size{ backend ? backend->size(path) : SIZE_MAX };
+	if (size == SIZE_MAX) {
+		ESP_LOGE(TAG, R"(No "%.*s" file)", static_cast<int>(std::size(path)), std::data(path));
+		error = true;
+		return false;
+	}
+	key.size = static_cast<uint32_t>(size);
+	return true;
+}
+
+auto reader::read_into(const std::span<uint8_t> destination) -> size_t {
+	if (!is_open()) {
+		return 0;
+	}
+
+	auto  &ctx{ *manager::ctx };
+	size_t read{};
+	if (!cached || !ctx.cache.enabled()) {
+		read = fill(position, destination);
+		read = read == SIZE_MAX ? 0 : read;
+	} else {
+		xSemaphoreTake(ctx.cache_guard, portMAX_DELAY);
+		read = ctx.cache.read(key, position, destination,
+			[this](const uint32_t block, const std::span<uint8_t> data) {
+				return fill(size_t{ block } * std::size(data), data);
+			}
+		);
+		xSemaphoreGive(ctx.cache_guard);
+	}
+
+	position += read;
+	end       = read < std::size(destination);
+	return read;
+}
+
+auto reader::ensure_open() -> bool {
+	if (file == nullptr && (backend == nullptr || (file = backend->open(path)) == nullptr)) {
+		ESP_LOGE(TAG, R"(Cannot open "%.*s" file: %s)",
+			static_cast<int>(std::size(path)), std::data(path),
+			backend ? std::strerror(errno) : "not mounted"
+		);
+		error = true;
+	}
+	return file != nullptr;
+}
+
+auto reader::fill(const size_t offset, const std::span<uint8_t> out) -> size_t {
+	if (!ensure_open()) {
+		return SIZE_MAX;
+	}
+	if (std::ftell(file) != static_cast<long>(offset)
+	&&  !backend->seek(file, offset)
+	) {
+		error = true;
+		return SIZE_MAX;
+	}
+	const auto read{ backend->read(file, out) };
+	error = read == SIZE_MAX;
+	return read;
+}
+
+} // namespace gzn::fs
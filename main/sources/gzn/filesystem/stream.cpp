@@ -0,0 +1,186 @@
+#include <bit>
+#include <utility>
+#include <algorithm>
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include "gzn/filesystem/stream.hpp"
+#include "gzn/filesystem/manager.hpp"
+
+namespace gzn::fs {
+
+static constexpr auto TAG{ "fs::stream" };
+
+auto stream::open(const std::string_view file_, const stream_config &config, const std::span<uint8_t> ring_) -> bool {
+	close();
+
+	const auto size{ manager::file_size(file_) };
+	if (size == SIZE_MAX) {
+		ESP_LOGE(TAG, R"(No "%.*s" file)", static_cast<int>(std::size(file_)), std::data(file_));
+		return false;
+	}
+
+	owns_ring = std::empty(ring_);
+	ring      = ring_;
+	if (owns_ring) {
+		const auto memory{ heap_caps_malloc(config.ahead, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) };
+		if (memory == nullptr) {
+			ESP_LOGE(TAG, "No memory for %zu bytes of read-ahead", config.ahead);
+			return false;
+		}
+		ring = { static_cast<uint8_t *>(memory), config.ahead };
+	}
+	const auto capacity{ std::bit_floor(std::size(ring)) };
+	if (capacity < 2) {
+		if (owns_ring) {
+			heap_caps_free(std::data(std::exchange(ring, {})));
+		}
+		return false;
+	}
+
+	file          = file_;
+	capacity_mask = capacity - 1;
+	burst         = std::clamp<size_t>(config.burst, 1, capacity / 2);
+	source_end    = std::min(config.end, size);
+	source        = std::min(config.offset, source_end);
+	loop_from     = std::min(config.loop_from, source_end);
+	loop          = config.loop && loop_from < source_end;
+	priority      = config.priority;
+	requested     = 0;
+	head          = 0;
+	tail          = 0;
+	busy          = false;
+	ended         = source == source_end && !loop;
+	error         = false;
+	closing       = false;
+	pending       = invalid_request;
+	underrun_count = 0;
+
+	pump();
+	return true;
+}
+
+void stream::close() {
+	if (!is_open()) {
+		return;
+	}
+
+	closing = true;
+	while (busy.load(std::memory_order_acquire)) {
+		manager::cancel(pending.load());
+		vTaskDelay(1);
+	}
+	if (owns_ring) {
+		heap_caps_free(std::data(ring));
+	}
+	ring          = {};
+	file          = {};
+	capacity_mask = 0;
+	owns_ring     = false;
+}
+
+auto stream::read_into(std::span<uint8_t> destination) -> size_t {
+	if (!is_open()) {
+		return 0;
+	}
+
+	const auto from { head.load(std::memory_order_relaxed) };
+	const auto count{ std::min<size_t>(std::size(destination), tail.load(std::memory_order_acquire) - from) };
+	const auto at   { from & capacity_mask };
+	const auto first{ std::min(count, capacity() - at) };
+	std::copy_n(std::begin(ring) + at, first, std::begin(destination));
+	std::copy_n(std::begin(ring), count - first, std::begin(destination) + first);
+	head.store(from + static_cast<uint32_t>(count), std::memory_order_release);
+
+	if (count < std::size(destination) && !ended.load(std::memory_order_acquire)) {
+		++underrun_count;
+	}
+	pump();
+	return count;
+}
+
+auto stream::wait(const size_t bytes, const TickType_t timeout) -> bool {
+	const auto target{ std::min(bytes, capacity()) };
+	for (TickType_t waited{}; ; ++waited) {
+		pump();
+		if (fill_level() >= target || ended || failed()) {
+			return !failed();
+		}
+		if (waited >= timeout) {
+			return false;
+		}
+		vTaskDelay(1);
+	}
+}
+
+void stream::pump() {
+	if (!is_open() || closing.load(std::memory_order_relaxed)) {
+		return;
+	}
+	bool expected{ false };
+	if (!busy.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+		return; // a burst is in flight, its callback queues the next one
+	}
+	if (!submit_next()) {
+		busy.store(false, std::memory_order_release);
+	}
+}
+
+auto stream::submit_next() -> bool {
+	if (ended || error || closing) {
+		return false;
+	}
+
+	const auto end  { tail.load(std::memory_order_relaxed) };
+	const auto free { capacity() - (end - head.load(std::memory_order_acquire)) };
+	const auto at   { end & capacity_mask };
+	const auto count{ std::min({ burst, capacity() - at, source_end - source }) };
+	if (free < count) {
+		return false; // till the consumer makes room for a whole burst
+	}
+
+	requested = count;
+	const auto id{ manager::submit({
+		.file{ file },
+		.offset{ source },
+		.destination{ ring.subspan(at, count) },
+		.priority{ priority },
+		.on_complete{ on_read },
+		.user{ this },
+		.uncached{ true },
+	}) };
+	pending.store(id);
+	return id != invalid_request; // a full queue is retried by the next pump()
+}
+
+void stream::on_read(const io_result &result) {
+	auto &self{ *static_cast<stream *>(result.user) };
+
+	if (result.status == io_status::done && result.read != 0) {
+		self.tail.store(self.tail.load(std::memory_order_relaxed) + static_cast<uint32_t>(result.read), std::memory_order_release);
+		// A short read means the file got shorter, it ends here then
+		self.source = result.read < self.requested ? self.source_end : self.source + result.read;
+		if (self.source == self.source_end) {
+			if (self.loop) {
+				self.source = self.loop_from; // the next burst is past the loop point already
+			} else {
+				self.ended.store(true, std::memory_order_release);
+			}
+		}
+	} else if (result.status != io_status::cancelled) {
+		ESP_LOGE(TAG, R"(Cannot read "%.*s" at %zu)",
+			static_cast<int>(std::size(self.file)), std::data(self.file), self.source
+		);
+		self.error.store(true);
+		self.ended.store(true, std::memory_order_release);
+	}
+
+	// Chained right away, so the ring is kept full between the consumer's reads
+	if (result.status == io_status::done && self.submit_next()) {
+		return;
+	}
+	self.busy.store(false, std::memory_order_release); // the last touch, close() may free it now
+}
+
+} // namespace gzn::fs
@@ -142,13 +142,11 @@ auto render::initialize(
 */
 }
 
-[[gnu::always_inline]]
-inline auto render::is_ready() -> bool {
+auto render::is_ready() -> bool {
 	return ctx != nullptr;
 }
 
-[[gnu::always_inline]]
-inline void render::update() {
+void render::update() {
 	xSemaphoreTake(ctx->render_fence, portMAX_DELAY);
 
 	if (is_ready()) [[likely]] {
@@ -175,40 +173,37 @@ void render::destroy() {
 	delete std::exchange(ctx, nullptr);
 }
 
-[[gnu::always_inline]]
-inline void render::submit() {
+void render::submit() {
 	xSemaphoreTake(ctx->update_fence, portMAX_DELAY);
 	xSemaphoreGive(ctx->render_fence);
 }
 
-[[gnu::always_inline]]
-inline auto render::resolution() noexcept -> gzn::vec2u16 {
+auto render::resolution() noexcept -> gzn::vec2u16 {
 	return ctx->resolution;
 }
 
-[[gnu::always_inline]]
-inline auto render::next_buffer_id() noexcept -> uint8_t {
+auto render::next_buffer_id() noexcept -> uint8_t {
 	return ctx->get_next_buffer_id();
 }
 
-[[gnu::always_inline]]
-inline auto render::current_buffer_id() noexcept -> uint8_t {
+auto render::current_buffer_id() noexcept -> uint8_t {
 	return ctx->current_rendering_buffer;
 }
 
 
-[[gnu::always_inline]]
-inline auto render::get_next_buffer() noexcept -> std::span<color> {
+auto render::buffers_count() noexcept -> uint8_t {
+	return ctx->buffers_count;
+}
+
+auto render::get_next_buffer() noexcept -> std::span<color> {
 	return ctx->get_next_buffer();
 }
 
-[[gnu::always_inline]]
-inline auto render::get_current_buffer() noexcept -> std::span<color> {
+auto render::get_current_buffer() noexcept -> std::span<color> {
 	return ctx->get_current_buffer();
 }
 
-[[gnu::always_inline]]
-inline auto render::display() noexcept -> tft::display & {
+auto render::display() noexcept -> tft::display & {
 	return ctx->display.get();
 }
 
@@ -0,0 +1,121 @@
+#include <cstring>
+#include <algorithm>
+
+#include "gzn/graphics/video-format.hpp"
+
+namespace gzn::graphics::video {
+
+namespace {
+
+/// Byte reader which fails once instead of overrunning the frame
+struct cursor {
+	std::span<const uint8_t> data{};
+	bool                     ok{ true };
+
+	[[gnu::always_inline]]
+	inline auto take(const size_t count) -> const uint8_t * {
+		if (!ok || std::size(data) < count) [[unlikely]] {
+			ok = false;
+			return nullptr;
+		}
+		const auto bytes{ std::data(data) };
+		data = data.subspan(count);
+		return bytes;
+	}
+
+	[[gnu::always_inline]]
+	inline auto u8() -> uint8_t {
+		const auto bytes{ take(1) };
+		return bytes ? bytes[0] : 0;
+	}
+
+	[[gnu::always_inline]]
+	inline auto u16() -> uint16_t {
+		const auto bytes{ take(2) };
+		return bytes ? static_cast<uint16_t>(bytes[0] | (bytes[1] << 8)) : 0;
+	}
+};
+
+} // namespace
+
+auto read_header(const std::span<const uint8_t> data, header &info) -> error {
+	if (std::size(data) < sizeof(header)) {
+		return error::too_small;
+	}
+	std::memcpy(&info, std::data(data), sizeof(info));
+	if (info.magic != MAGIC) {
+		return error::bad_magic;
+	}
+	if (info.version != VERSION) {
+		return error::unsupported_version;
+	}
+	if (info.width == 0 || info.height == 0 || info.frame_us == 0
+	||  info.format > pixel_format::palette8
+	||  info.palette_size > MAX_PALETTE
+	|| (info.format == pixel_format::palette8) != (info.palette_size != 0)
+	) {
+		return error::corrupted;
+	}
+	if (std::size(data) < frames_offset(info)) {
+		return error::too_small;
+	}
+	return error::ok;
+}
+
+auto decode(
+	const std::span<const uint8_t> frame,
+	const header &info,
+	const std::span<const color> palette,
+	std::span<color> target,
+	const size_t stride
+) -> bool {
+	if (info.format == pixel_format::palette8 && std::empty(palette)) {
+		return false;
+	}
+
+	const auto bytes_per_pixel{ pixel_size(info.format) };
+	const auto pixel{ [&](const uint8_t *at) -> color {
+		return info.format == pixel_format::rgb565
+			? static_cast<color>(at[0] | (at[1] << 8))
+			: palette[std::min<size_t>(at[0], std::size(palette) - 1)];
+	} };
+
+	cursor in{ frame };
+	while (in.ok && !std::empty(in.data)) {
+		const auto y  { in.u16() };
+		const auto ops{ in.u8() };
+		if (y >= info.height || size_t{ y } * stride + info.width > std::size(target)) {
+			return false;
+		}
+
+		auto   row{ target.subspan(size_t{ y } * stride, info.width) };
+		size_t x{};
+		for (size_t op{}; op < ops && in.ok; ++op) {
+			x += in.u16();
+			const auto code { in.u8() };
+			const auto count{ size_t{ code & (RUN_BIT - 1u) } + 1 };
+			if (x + count > info.width) {
+				return false;
+			}
+
+			if ((code & RUN_BIT) != 0) {
+				const auto value{ in.take(bytes_per_pixel) };
+				if (value != nullptr) {
+					std::fill_n(std::begin(row) + x, count, pixel(value));
+				}
+			} else if (const auto values{ in.take(count * bytes_per_pixel) }; values != nullptr) {
+				if (info.format == pixel_format::rgb565) {
+					std::memcpy(std::data(row) + x, values, count * sizeof(color));
+				} else {
+					for (size_t i{}; i < count; ++i) {
+						row[x + i] = pixel(values + i);
+					}
+				}
+			}
+			x += count;
+		}
+	}
+	return in.ok;
+}
+
+} // namespace gzn::graphics::video
@@ -0,0 +1,348 @@
+#include <bit>
+#include <array>
+#include <limits>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#include "gzn/audio/manager.hpp"
+#include "gzn/filesystem/stream.hpp"
+#include "gzn/filesystem/manager.hpp"
+#include "gzn/graphics/video.hpp"
+#include "gzn/graphics/render.hpp"
+
+namespace gzn::graphics::video {
+
+namespace {
+
+inline constexpr auto VIDEO_TAG{ "gzn::graphics::video" };
+
+inline constexpr int64_t NO_FRAME{ -1 };
+
+/// Frames kept on top of the render buffers, so a late one may be skipped
+inline constexpr size_t SPARE_HISTORY{ 1 };
+
+[[nodiscard]]
+auto allocate(const size_t size) -> uint8_t * {
+	auto data{ heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) };
+	if (data == nullptr) {
+		data = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+	}
+	return static_cast<uint8_t *>(data);
+}
+
+struct history_slot {
+	uint32_t size{};
+	bool     key{ false };
+};
+
+} // namespace
+
+struct player::context {
+	header                            info{};
+	std::array<color, MAX_PALETTE>    palette{};
+	fs::stream                        source{};
+	uint8_t                          *ring{ nullptr };
+	size_t                            ring_size{};
+
+	uint8_t                          *history{ nullptr };  ///< payloads of the last frames
+	std::array<history_slot, defaults::maximum_buffers_count + SPARE_HISTORY> slots{};
+	size_t                            slots_count{};
+
+	/// What every render buffer shows, as an index of the presented frames
+	std::array<int64_t, defaults::maximum_buffers_count> buffer_frames{};
+
+	frame_header                      next{};
+	bool                              has_next{ false };
+	int64_t                           read_frames{};       ///< also counts the loops
+	int64_t                           shown{ NO_FRAME };
+
+	std::string_view                  soundtrack{};
+	int8_t                            volume{};
+	int64_t                           next_lap{};          ///< frame the soundtrack restarts at
+	bool                              loop{ false };
+
+	vec2u16                           position{};
+	int64_t                           start_us{};
+	uint32_t                          dropped{};
+
+	~context() {
+		source.close();
+		heap_caps_free(ring);
+		heap_caps_free(history);
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto payload(const int64_t frame) -> std::span<const uint8_t> {
+		const auto slot{ static_cast<size_t>(frame) % slots_count };
+		return { history + slot * info.max_frame_size, slots[slot].size };
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto oldest_kept() const -> int64_t {
+		return std::max<int64_t>(read_frames - static_cast<int64_t>(slots_count), 0);
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto due_frame(const int64_t now) const -> int64_t {
+		return now < start_us ? NO_FRAME : (now - start_us) / info.frame_us;
+	}
+
+	[[nodiscard]] [[gnu::always_inline]]
+	inline auto frame_time(const int64_t frame) const -> int64_t {
+		return start_us + frame * info.frame_us;
+	}
+
+	/// Takes the frames due by now which are buffered already, never blocks
+	auto read_due(const int64_t due) -> bool {
+		while (read_frames <= due) {
+			if (!loop && read_frames >= info.frame_count) {
+				return true;
+			}
+			if (!has_next) {
+				if (source.fill_level() < sizeof(frame_header)) {
+					break;
+				}
+				source.read_into({ reinterpret_cast<uint8_t *>(&next), sizeof(next) });
+				if (next.size > info.max_frame_size) {
+					ESP_LOGE(VIDEO_TAG, "Frame %lld is %u bytes, %u is max",
+						read_frames, static_cast<unsigned>(next.size), static_cast<unsigned>(info.max_frame_size)
+					);
+					return false;
+				}
+				has_next = true;
+			}
+			if (source.fill_level() < next.size) {
+				break;
+			}
+
+			const auto slot{ static_cast<size_t>(read_frames) % slots_count };
+			source.read_into({ history + slot * info.max_frame_size, next.size });
+			slots[slot] = { .size = next.size, .key = (next.flags & KEY_FRAME) != 0 };
+			has_next    = false;
+			++read_frames;
+		}
+		return !source.failed();
+	}
+
+	/// The soundtrack of the next lap is queued ahead, so it starts with its first frame
+	void schedule_soundtrack(const int64_t now) {
+		if (std::empty(soundtrack) || !loop) {
+			return;
+		}
+		const auto lap_start{ frame_time(next_lap) };
+		if (now + audio::manager::output_latency_us() >= lap_start) {
+			audio::manager::play_at({ .filename{ soundtrack }, .volume = volume }, lap_start);
+			next_lap += info.frame_count;
+		}
+	}
+
+	auto apply(std::span<color> target, const int64_t from, const int64_t to) -> bool {
+		const auto stride{ static_cast<size_t>(render::resolution().w) };
+		const auto origin{ size_t{ position.y } * stride + position.x };
+		for (auto frame{ from }; frame <= to; ++frame) {
+			if (!decode(payload(frame), info, palette, target.subspan(origin), stride)) {
+				ESP_LOGE(VIDEO_TAG, "Frame %lld is corrupted", frame);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void copy_rect(const std::span<const color> from, std::span<color> to) const {
+		const auto stride{ static_cast<size_t>(render::resolution().w) };
+		for (size_t y{}; y < info.height; ++y) {
+			const auto row{ (size_t{ position.y } + y) * stride + position.x };
+			std::memcpy(std::data(to) + row, std::data(from) + row, info.width * sizeof(color));
+		}
+	}
+
+	/// Brings the next render buffer to @p frame with the least frames decoded
+	auto present(const int64_t frame) -> bool {
+		const auto target_id{ render::next_buffer_id() };
+		const auto current_id{ render::current_buffer_id() };
+		const auto target{ render::get_next_buffer() };
+		const auto oldest{ oldest_kept() };
+		const auto have{ buffer_frames[target_id] };
+		const auto current{ buffer_frames[current_id] };
+
+		auto ok{ true };
+		if (have == frame) {
+			return true;
+		} else if (have != NO_FRAME && have < frame && have + 1 >= oldest) {
+			ok = apply(target, have + 1, frame);
+		} else if (current != NO_FRAME && current <= frame && current + 1 >= oldest) {
+			copy_rect(render::get_current_buffer(), target);
+			ok = apply(target, current + 1, frame);
+		} else {
+			auto key{ frame };
+			while (key >= oldest && !slots[static_cast<size_t>(key) % slots_count].key) {
+				--key;
+			}
+			if (key < oldest) {
+				// The buffer missed more frames than are kept, it waits for a key frame
+				buffer_frames[target_id] = NO_FRAME;
+				++dropped;
+				return true;
+			}
+			ok = apply(target, key, frame);
+		}
+
+		buffer_frames[target_id] = ok ? frame : NO_FRAME;
+		return ok;
+	}
+};
+
+auto player::play(const play_info &info) -> play_error {
+	if (ctx != nullptr) {
+		return play_error::already_playing;
+	}
+
+	auto file{ fs::manager::open(info.file) };
+	if (!file) {
+		ESP_LOGE(VIDEO_TAG, R"(No "%.*s" video)", static_cast<int>(std::size(info.file)), std::data(info.file));
+		return play_error::not_found;
+	}
+
+	std::array<uint8_t, sizeof(header) + MAX_PALETTE * sizeof(color)> prologue{};
+	header     video{};
+	const auto prologue_size{ file.read_into(prologue) };
+	if (const auto result{ read_header(std::span{ prologue }.first(prologue_size), video) };
+		result != error::ok || video.frame_count == 0 || video.max_frame_size == 0
+	) {
+		ESP_LOGE(VIDEO_TAG, R"("%.*s" isn't a video (%u))",
+			static_cast<int>(std::size(info.file)), std::data(info.file), std::to_underlying(result)
+		);
+		return play_error::invalid_format;
+	}
+
+	const auto screen{ render::resolution() };
+	if (size_t{ info.position.x } + video.width  > screen.w
+	||  size_t{ info.position.y } + video.height > screen.h
+	) {
+		ESP_LOGE(VIDEO_TAG, "%ux%u video doesn't fit %ux%u screen at %u, %u",
+			video.width, video.height, screen.w, screen.h, info.position.x, info.position.y
+		);
+		return play_error::too_large;
+	}
+
+	auto context_{ new context{} };
+	if (context_ == nullptr) {
+		return play_error::not_enough_memory;
+	}
+	context_->info        = video;
+	context_->slots_count = render::buffers_count() + SPARE_HISTORY;
+	context_->history     = allocate(context_->slots_count * video.max_frame_size);
+	// Two whole frames, so the next one is read while the last one waits to be taken
+	context_->ring_size   = std::max(
+		std::bit_ceil(2 * (size_t{ video.max_frame_size } + sizeof(frame_header))),
+		fs::default_stream_ahead
+	);
+	context_->ring        = allocate(context_->ring_size);
+	if (context_->history == nullptr || context_->ring == nullptr) {
+		ESP_LOGE(VIDEO_TAG, "No memory for %zu frames of %u bytes",
+			context_->slots_count, static_cast<unsigned>(video.max_frame_size)
+		);
+		delete context_;
+		return play_error::not_enough_memory;
+	}
+	std::memcpy(std::data(context_->palette), std::data(prologue) + sizeof(header),
+		size_t{ video.palette_size } * sizeof(color)
+	);
+	context_->buffer_frames.fill(NO_FRAME);
+	context_->soundtrack = info.soundtrack;
+	context_->volume     = info.volume;
+	context_->loop       = info.loop;
+	context_->position   = info.position;
+
+	const auto offset{ frames_offset(video) };
+	const auto opened{ context_->source.open(info.file, {
+		.ahead     = context_->ring_size,
+		.burst     = fs::default_stream_burst,
+		.offset    = offset,
+		.loop_from = offset,
+		.loop      = info.loop,
+		.priority  = fs::io_priority::high,
+	}, { context_->ring, context_->ring_size }) };
+	if (!opened) {
+		delete context_;
+		return play_error::not_found;
+	}
+	// The first frame is usually a whole picture, so it's waited for
+	context_->source.wait(sizeof(frame_header) + video.max_frame_size, pdMS_TO_TICKS(500));
+
+	const auto has_soundtrack{ !std::empty(info.soundtrack) };
+	context_->start_us = esp_timer_get_time()
+		+ (has_soundtrack ? audio::manager::output_latency_us() : 0);
+	if (has_soundtrack) {
+		audio::manager::play_at({ .filename{ info.soundtrack }, .volume = info.volume }, context_->start_us);
+		context_->next_lap = video.frame_count;
+	}
+
+	ESP_LOGI(VIDEO_TAG, R"(Playing "%.*s": %ux%u, %u frames of %u us)",
+		static_cast<int>(std::size(info.file)), std::data(info.file),
+		video.width, video.height,
+		static_cast<unsigned>(video.frame_count), static_cast<unsigned>(video.frame_us)
+	);
+	ctx = context_;
+	return play_error::ok;
+}
+
+void player::stop() {
+	delete std::exchange(ctx, nullptr);
+}
+
+auto player::update() -> bool {
+	if (ctx == nullptr) {
+		return false;
+	}
+
+	const auto now{ esp_timer_get_time() };
+	const auto due{ ctx->due_frame(now) };
+	if (!ctx->loop && due >= static_cast<int64_t>(ctx->info.frame_count)) {
+		stop();
+		return false;
+	}
+	ctx->schedule_soundtrack(now);
+
+	if (!ctx->read_due(due)) {
+		ESP_LOGE(VIDEO_TAG, "Cannot read the video, stopped");
+		stop();
+		return false;
+	}
+
+	// The latest frame read, the due one unless the flash is behind
+	const auto frame{ ctx->read_frames - 1 };
+	if (frame == NO_FRAME) {
+		return true;
+	}
+	if (frame > ctx->shown) {
+		if (ctx->shown != NO_FRAME) {
+			ctx->dropped += static_cast<uint32_t>(frame - ctx->shown - 1);
+		}
+		ctx->shown = frame;
+	}
+
+	// Still the same frame for the game loop running faster than the video,
+	// but the next buffer may show an older one
+
+	if (!ctx->present(frame)) {
+		stop();
+		return false;
+	}
+	return true;
+}
+
+auto player::is_playing() -> bool {
+	return ctx != nullptr;
+}
+
+auto player::dropped_frames() -> uint32_t {
+	return ctx != nullptr ? ctx->dropped : 0;
+}
+
+} // namespace gzn::graphics::video
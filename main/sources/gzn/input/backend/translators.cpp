@@ -1,4 +1,6 @@
 
+#include <algorithm>
+
 #include <usb/hid_host.h>
 #include <usb/hid_usage_keyboard.h>
 
@@ -6,6 +8,23 @@
 
 namespace gzn::input::backend {
 
+void action_levels::apply(action_array &actions, const uint64_t timestamp) const {
+	for (size_t i{ 1 }; i < std::size(actions); ++i) {
+		const auto type{ static_cast<action_type>(i) };
+		auto &action{ actions[type] };
+		if (is_axis(type)) {
+			const auto value{ static_cast<int8_t>(std::clamp<int16_t>(axes[type], -128, 127)) };
+			if (action.horizontal != value) {
+				action.horizontal = value;
+				action.timestamp  = timestamp;
+			}
+		} else if (action.pressed != held[type]) {
+			action.pressed   = held[type];
+			action.timestamp = timestamp;
+		}
+	}
+}
+
 auto select_translator(const uint8_t hid_protocol, const uint32_t VID_PID) -> translator {
 	switch (hid_protocol) {
 		case HID_PROTOCOL_KEYBOARD: return keyboard_usb_translator;
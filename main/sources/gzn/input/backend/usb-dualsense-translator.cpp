@@ -1,3 +1,6 @@
+#include <bit>
+#include <array>
+
 #include <usb/hid_host.h>
 
 #include "gzn/input/backend/translators.hpp"
@@ -116,40 +119,47 @@ static inline auto normalize(const uint8_t value) -> int8_t {
 	return static_cast<int8_t>(static_cast<int16_t>(value) - 128);
 }
 
-void dualsense_usb_translator(const std::span<const uint8_t> data, action_array &actions) {
+/// D-pad directions of the report as gamepad_button bits, 8 and up are neutral
+constexpr std::array<uint8_t, 16> hat_buttons{
+	0b0001, 0b0011, 0b0010, 0b0110, 0b0100, 0b1100, 0b1000, 0b1001,
+};
+
+/// Bits of the buttons are gamepad_button positions
+[[nodiscard]]
+static auto button_mask(const dualsense_bytes &report) -> uint32_t {
+	return hat_buttons[report.buttons0.direction]
+		| (report.buttons0_bitset & 0xF0u)
+		| (uint32_t{ std::bit_cast<uint8_t>(report.buttons1) } << 8)
+		| (uint32_t{ std::bit_cast<uint8_t>(report.buttons2) & 0x07u } << 16);
+}
+
+auto dualsense_usb_translator(const std::span<const uint8_t> data, const binding_map &bindings, device_state &state) -> bool {
 	if (std::size(data) < sizeof(dualsense_bytes)) {
-		return;
+		return false;
 	}
 
 	const auto &ds_report{
 		*reinterpret_cast<const dualsense_bytes *>(std::data(data))
 	};
 
-	const auto timestamp{ static_cast<uint64_t>(esp_timer_get_time()) };
-
-	static dualsense_bytes previous_report{};
-
-	actions[action_type::horizontal_move].horizontal = normalize(ds_report.lsx);
-	actions[action_type::vertical_move  ].vertical   = normalize(ds_report.lsy);
-
-	const auto update_button{ [&actions, timestamp] (const action_type type, const bool value) {
-		auto &action{ actions[type] };
-		action.timestamp = timestamp;
-		action.pressed   = value;
-	} };
-
-	/// @note We could add another actions here
-	if (ds_report.buttons0_bitset != previous_report.buttons0_bitset) {
-		if (ds_report.buttons0.cross != previous_report.buttons0.cross) {
-			update_button(action_type::attack, ds_report.buttons0.cross);
-		}
-		if (ds_report.buttons0.circle != previous_report.buttons0.circle) {
-			update_button(action_type::use, ds_report.buttons0.circle);
-		}
+	action_levels levels{};
+	for (auto buttons{ button_mask(ds_report) }; buttons != 0; buttons &= buttons - 1) {
+		levels.add(bindings.button(static_cast<gamepad_button>(std::countr_zero(buttons))));
 	}
 
-	previous_report = ds_report;
+	const core::enum_array<gamepad_axis, uint8_t> sticks{
+		ds_report.lsx, ds_report.lsy, ds_report.rsx, ds_report.rsy
+	};
+	for (size_t i{}; i < std::size(sticks); ++i) {
+		const auto axis{ static_cast<gamepad_axis>(i) };
+		levels.add_axis(bindings.axis(axis), normalize(sticks[axis]));
+	}
+	// The pad reports all the time, mostly the same
+	if (levels == state.levels) {
+		return false;
+	}
+	state.levels = levels;
+	return true;
 }
 
 } // namespace gzn::input::backend
-
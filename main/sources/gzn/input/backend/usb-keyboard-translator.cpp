@@ -1,6 +1,3 @@
-#include <cstring>
-#include <algorithm>
-
 #include <usb/hid_host.h>
 #include <usb/hid_usage_keyboard.h>
 
@@ -10,117 +7,68 @@ namespace gzn::input::backend {
 
 namespace {
 
-static auto select_action(const hid_key_t key, action_array &actions) -> action_info * {
-	switch (key) {
-		case HID_KEY_LEFT: [[fallthrough]];
-		case HID_KEY_A:
-			return &actions[action_type::horizontal_move];
-
-		case HID_KEY_RIGHT: [[fallthrough]];
-		case HID_KEY_D:
-			return &actions[action_type::horizontal_move];
-
-		case HID_KEY_DOWN: [[fallthrough]];
-		case HID_KEY_S:
-			return &actions[action_type::vertical_move];
-
-		case HID_KEY_UP: [[fallthrough]];
-		case HID_KEY_W:
-			return &actions[action_type::vertical_move];
-
-		case HID_KEY_ESC:
-			return &actions[action_type::pause];
-
-		case HID_KEY_E: [[fallthrough]];
-		case HID_KEY_SPACE:
-			return &actions[action_type::use];
-
-		default: break;
-	}
-	return nullptr;
-};
-
-static void on_key_pressed(const hid_key_t key, action_info &action) {
-	switch (key) {
-		case HID_KEY_LEFT: [[fallthrough]];
-		case HID_KEY_A:
-			action.horizontal = -128;
-			break;
-
-		case HID_KEY_RIGHT: [[fallthrough]];
-		case HID_KEY_D:
-			action.horizontal = 127;
-			break;
-
-		case HID_KEY_DOWN: [[fallthrough]];
-		case HID_KEY_S:
-			action.vertical = 127;
-			break;
+/// Usage ID of the modifier of the lowest bit, the others follow it
+constexpr uint8_t FIRST_MODIFIER_USAGE{ 0xE0 };
 
-		case HID_KEY_UP: [[fallthrough]];
-		case HID_KEY_W:
-			action.vertical = -128;
-			break;
+/// "No key" and the error codes, which the report fills unused or all slots with
+constexpr uint32_t NOT_KEYS_MASK{ 0x0000'000Fu };
+constexpr uint8_t  ERROR_ROLL_OVER{ 0x01 };
 
-		default: break;
-	}
-}
-
-static void on_key_released(const hid_key_t key, action_info &action) {
-	switch (key) {
-		case HID_KEY_LEFT: [[fallthrough]];
-		case HID_KEY_A: [[fallthrough]];
-		case HID_KEY_RIGHT: [[fallthrough]];
-		case HID_KEY_D:
-			action.horizontal = 0;
-			break;
-
-		case HID_KEY_DOWN: [[fallthrough]];
-		case HID_KEY_S: [[fallthrough]];
-		case HID_KEY_UP: [[fallthrough]];
-		case HID_KEY_W:
-			action.vertical = 0;
-			break;
-
-		default: break;
+[[nodiscard]]
+auto to_key_set(const hid_keyboard_input_report_boot_t &report) -> key_set {
+	key_set keys{};
+	for (const auto key : report.key) {
+		keys.set(key);
 	}
+	keys.words[FIRST_MODIFIER_USAGE / key_set::WORD_BITS] |=
+		uint32_t{ report.modifier.val } << (FIRST_MODIFIER_USAGE % key_set::WORD_BITS);
+	keys.words[0] &= ~NOT_KEYS_MASK;
+	return keys;
 }
 
 } // namespace
 
-void keyboard_usb_translator(const std::span<const uint8_t> data, action_array &actions) {
+auto keyboard_usb_translator(const std::span<const uint8_t> data, const binding_map &bindings, device_state &state) -> bool {
 	if (std::size(data) < sizeof(hid_keyboard_input_report_boot_t)) {
-		return;
+		return false;
 	}
 
 	const auto kb_report{
 		reinterpret_cast<const hid_keyboard_input_report_boot_t *>(std::data(data))
 	};
 
-	const auto timestamp{ static_cast<uint64_t>(esp_timer_get_time()) };
-
-	static std::array<uint8_t, HID_KEYBOARD_KEY_MAX> previous_keys{};
-
-	for (size_t i{}; i < HID_KEYBOARD_KEY_MAX; ++i) {
-		const auto prev_key{ static_cast<hid_key_t>(previous_keys[i]) };
-		if (auto action{ select_action(prev_key, actions) };
-			action && std::ranges::contains(kb_report->key, prev_key)
-		) {
-			action->pressed = false;
-			action->timestamp = timestamp;
-			on_key_released(prev_key, *action);
-		}
+	// Too many keys are held to tell which, so nothing changes till some are released
+	if (kb_report->key[0] == ERROR_ROLL_OVER) {
+		return false;
+	}
 
-		const auto key{ static_cast<hid_key_t>(kb_report->key[i]) };
-		if (auto action{ select_action(key, actions) }; action && !std::ranges::contains(previous_keys, key)) {
-			action->pressed = true;
-			action->timestamp = timestamp;
-			on_key_pressed(prev_key, *action);
-		}
+	// Keyboards repeat the report while keys are held, those change nothing
+	const auto keys{ to_key_set(*kb_report) };
+	if (keys == state.keys) {
+		return false;
+	}
+	const auto pressed { keys.without(state.keys) };
+	const auto released{ state.keys.without(keys) };
+	state.keys = keys;
+
+	// Only the keys which changed are looked up, unbound ones don't touch the actions
+	bool touched{ false };
+	const auto touch{ [&](const uint8_t key) {
+		touched |= bindings.key(key).action != action_type::invalid;
+	} };
+	pressed.for_each(touch);
+	released.for_each(touch);
+	if (!touched) {
+		return true;
 	}
 
-	std::memcpy(std::data(previous_keys), kb_report->key, HID_KEYBOARD_KEY_MAX);
+	// The levels follow what's held rather than the changes, so they always
+	// match the current bindings
+	state.levels = {};
+	keys.for_each([&](const uint8_t key) {
+		state.levels.add(bindings.key(key));
+	});
+	return true;
 }
 
 } // namespace gzn::input::backend
-
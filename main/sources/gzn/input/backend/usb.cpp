@@ -34,7 +34,9 @@ void hid_host_interface_callback(
 			ESP_ERROR_CHECK(hid_host_device_get_raw_input_report_data(
 				hid_device_handle, std::data(buffer), std::size(buffer), &data_length
 			));
-			device->translator({ std::data(buffer), data_length }, ctx->actions);
+			if (device->translator({ std::data(buffer), data_length }, ctx->bindings, device->state)) {
+				ctx->publish_devices();
+			}
 		} break;
 
 		case HID_HOST_INTERFACE_EVENT_DISCONNECTED:
@@ -45,7 +47,9 @@ void hid_host_interface_callback(
 					handler.on_disconnect(*device, handler.user_data);
 				}
 			}
+			// Whatever it held is released
 			*device = {};
+			ctx->publish_devices();
 			break;
 
 		case HID_HOST_INTERFACE_EVENT_TRANSFER_ERROR:
@@ -0,0 +1,243 @@
+#include <array>
+#include <charconv>
+#include <optional>
+#include <algorithm>
+
+#include <esp_log.h>
+
+#include "gzn/input/bindings.hpp"
+
+namespace gzn::input {
+
+namespace {
+
+constexpr auto TAG{ "input::bindings" };
+
+template<class T>
+struct named {
+	std::string_view name;
+	T                value;
+};
+
+constexpr std::array action_names{
+	named{ "horizontal_move", action_type::horizontal_move },
+	named{ "vertical_move",   action_type::vertical_move   },
+	named{ "attack",          action_type::attack          },
+	named{ "use",             action_type::use             },
+	named{ "pause",           action_type::pause           },
+	named{ "none",            action_type::invalid         },
+};
+
+constexpr std::array button_names{
+	named{ "dpad_up",    gamepad_button::dpad_up    },
+	named{ "dpad_right", gamepad_button::dpad_right },
+	named{ "dpad_down",  gamepad_button::dpad_down  },
+	named{ "dpad_left",  gamepad_button::dpad_left  },
+	named{ "square",     gamepad_button::square     },
+	named{ "cross",      gamepad_button::cross      },
+	named{ "circle",     gamepad_button::circle     },
+	named{ "triangle",   gamepad_button::triangle   },
+	named{ "l1",         gamepad_button::l1         },
+	named{ "r1",         gamepad_button::r1         },
+	named{ "l2",         gamepad_button::l2         },
+	named{ "r2",         gamepad_button::r2         },
+	named{ "create",     gamepad_button::create     },
+	named{ "option",     gamepad_button::option     },
+	named{ "l3",         gamepad_button::l3         },
+	named{ "r3",         gamepad_button::r3         },
+	named{ "ps",         gamepad_button::ps         },
+	named{ "touchpad",   gamepad_button::touchpad   },
+	named{ "mute",       gamepad_button::mute       },
+};
+
+constexpr std::array axis_names{
+	named{ "left_x",  gamepad_axis::left_x  },
+	named{ "left_y",  gamepad_axis::left_y  },
+	named{ "right_x", gamepad_axis::right_x },
+	named{ "right_y", gamepad_axis::right_y },
+};
+
+/// HID usage IDs of the keys which aren't a letter or a digit
+constexpr std::array key_names{
+	named{ "enter",     uint8_t{ 0x28 } },
+	named{ "esc",       uint8_t{ 0x29 } },
+	named{ "backspace", uint8_t{ 0x2A } },
+	named{ "tab",       uint8_t{ 0x2B } },
+	named{ "space",     uint8_t{ 0x2C } },
+	named{ "right",     uint8_t{ 0x4F } },
+	named{ "left",      uint8_t{ 0x50 } },
+	named{ "down",      uint8_t{ 0x51 } },
+	named{ "up",        uint8_t{ 0x52 } },
+	named{ "lctrl",     uint8_t{ 0xE0 } },
+	named{ "lshift",    uint8_t{ 0xE1 } },
+	named{ "lalt",      uint8_t{ 0xE2 } },
+	named{ "rctrl",     uint8_t{ 0xE4 } },
+	named{ "rshift",    uint8_t{ 0xE5 } },
+	named{ "ralt",      uint8_t{ 0xE6 } },
+};
+
+constexpr uint8_t KEY_A{ 0x04 };
+constexpr uint8_t KEY_1{ 0x1E };
+constexpr uint8_t KEY_0{ 0x27 };
+
+template<class T, size_t Size>
+[[nodiscard]]
+auto find_name(const std::array<named<T>, Size> &names, const std::string_view name) -> std::optional<T> {
+	const auto found{ std::ranges::find(names, name, &named<T>::name) };
+	return found != std::end(names) ? std::optional{ found->value } : std::nullopt;
+}
+
+template<class T>
+[[nodiscard]]
+auto parse_number(const std::string_view text) -> std::optional<T> {
+	T value{};
+	const auto [end, error]{ std::from_chars(std::data(text), std::data(text) + std::size(text), value) };
+	return error == std::errc{} && end == std::data(text) + std::size(text) ? std::optional{ value } : std::nullopt;
+}
+
+/// A letter, a digit, a name of key_names or a HID usage ID of a key
+[[nodiscard]]
+auto parse_key(const std::string_view name) -> std::optional<uint8_t> {
+	if (std::size(name) == 1 && name[0] >= 'a' && name[0] <= 'z') {
+		return static_cast<uint8_t>(KEY_A + (name[0] - 'a'));
+	}
+	if (std::size(name) == 1 && name[0] == '0') {
+		return KEY_0;
+	}
+	if (std::size(name) == 1 && name[0] >= '1' && name[0] <= '9') {
+		return static_cast<uint8_t>(KEY_1 + (name[0] - '1'));
+	}
+	if (const auto key{ find_name(key_names, name) }; key) {
+		return key;
+	}
+	// Below are "no key" and the error codes, which the reports fill unused slots with
+	const auto usage{ parse_number<uint8_t>(name) };
+	return usage && *usage >= KEY_A ? usage : std::nullopt;
+}
+
+/// Splits off the next whitespace-separated word of @p text
+[[nodiscard]]
+auto next_word(std::string_view &text) -> std::string_view {
+	const auto begin{ std::min(text.find_first_not_of(" \t\r"), std::size(text)) };
+	text.remove_prefix(begin);
+	const auto end{ std::min(text.find_first_of(" \t\r"), std::size(text)) };
+	const auto word{ text.substr(0, end) };
+	text.remove_prefix(end);
+	return word;
+}
+
+/// The value is required by axis actions and optional for buttons
+[[nodiscard]]
+auto parse_binding(std::string_view &words) -> std::optional<binding> {
+	const auto action{ find_name(action_names, next_word(words)) };
+	if (!action) {
+		return std::nullopt;
+	}
+	const auto value_word{ next_word(words) };
+	if (!is_axis(*action)) {
+		return std::empty(value_word) ? std::optional{ binding{ .action = *action } } : std::nullopt;
+	}
+	const auto value{ parse_number<int8_t>(value_word) };
+	if (!value || *value == 0) {
+		return std::nullopt;
+	}
+	return binding{ .action = *action, .value = *value };
+}
+
+[[nodiscard]]
+auto parse_line(std::string_view words, binding_map &map) -> bool {
+	const auto device{ next_word(words) };
+	const auto input { next_word(words) };
+	if (device == "key") {
+		const auto key    { parse_key(input) };
+		const auto bound  { parse_binding(words) };
+		if (key && bound) {
+			map.keys[*key] = *bound;
+			return true;
+		}
+	} else if (device == "button") {
+		const auto button { find_name(button_names, input) };
+		const auto bound  { parse_binding(words) };
+		if (button && bound) {
+			map.buttons[*button] = *bound;
+			return true;
+		}
+	} else if (device == "axis") {
+		const auto axis   { find_name(axis_names, input) };
+		const auto action { find_name(action_names, next_word(words)) };
+		if (axis && action && (*action == action_type::invalid || is_axis(*action))) {
+			map.axes[*axis] = *action;
+			return std::empty(next_word(words));
+		}
+	}
+	return false;
+}
+
+} // namespace
+
+auto binding_map::defaults() -> binding_map {
+	binding_map map{};
+	const auto key{ [&](const std::string_view name, const binding bound) {
+		map.keys[*parse_key(name)] = bound;
+	} };
+	key("a",     { .action = action_type::horizontal_move, .value = -128 });
+	key("left",  { .action = action_type::horizontal_move, .value = -128 });
+	key("d",     { .action = action_type::horizontal_move, .value =  127 });
+	key("right", { .action = action_type::horizontal_move, .value =  127 });
+	key("w",     { .action = action_type::vertical_move,   .value = -128 });
+	key("up",    { .action = action_type::vertical_move,   .value = -128 });
+	key("s",     { .action = action_type::vertical_move,   .value =  127 });
+	key("down",  { .action = action_type::vertical_move,   .value =  127 });
+	key("esc",   { .action = action_type::pause });
+	key("e",     { .action = action_type::use });
+	key("space", { .action = action_type::use });
+
+	map.buttons[gamepad_button::cross]  = { .action = action_type::attack };
+	map.buttons[gamepad_button::circle] = { .action = action_type::use };
+	map.axes[gamepad_axis::left_x]      = action_type::horizontal_move;
+	map.axes[gamepad_axis::left_y]      = action_type::vertical_move;
+	map.axes[gamepad_axis::right_x]     = action_type::invalid;
+	map.axes[gamepad_axis::right_y]     = action_type::invalid;
+	return map;
+}
+
+auto binding_map::parse(const std::string_view config) -> bool {
+	auto   parsed{ *this };
+	size_t line_number{};
+	for (size_t begin{}; begin < std::size(config); ++line_number) {
+		const auto end { std::min(config.find('\n', begin), std::size(config)) };
+		auto       line{ config.substr(begin, end - begin) };
+		begin = end + 1;
+
+		line = line.substr(0, std::min(line.find('#'), std::size(line)));
+		if (line.find_first_not_of(" \t\r") == std::string_view::npos) {
+			continue;
+		}
+		if (!parse_line(line, parsed)) {
+			ESP_LOGE(TAG, "Line %zu: cannot parse \"%.*s\"", line_number + 1,
+				static_cast<int>(std::size(line)), std::data(line)
+			);
+			return false;
+		}
+	}
+
+	assign(parsed);
+	return true;
+}
+
+void binding_map::assign(const binding_map &other) {
+	for (size_t i{}; i < std::size(keys); ++i) {
+		const auto usage{ static_cast<uint8_t>(i) };
+		bind_key(usage, other.key(usage));
+	}
+	for (size_t i{}; i < std::size(buttons); ++i) {
+		const auto button_{ static_cast<gamepad_button>(i) };
+		bind_button(button_, other.button(button_));
+	}
+	for (size_t i{}; i < std::size(axes); ++i) {
+		const auto axis_{ static_cast<gamepad_axis>(i) };
+		bind_axis(axis_, other.axis(axis_));
+	}
+}
+
+} // namespace gzn::input
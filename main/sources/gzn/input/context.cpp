@@ -1,4 +1,8 @@
+#include <atomic>
+#include <cstring>
+
 #include <esp_log.h>
+#include <esp_timer.h>
 
 #include "gzn/input/context.hpp"
 
@@ -54,5 +58,49 @@ auto context::push_device(const device_info &new_device) -> bool {
 	return true;
 }
 
+void context::publish_devices() {
+	backend::action_levels levels{};
+	key_set                keys{};
+	for (const auto &device : devices) {
+		levels.merge(device.state.levels);
+		keys.merge(device.state.keys);
+	}
+	levels.apply(input.pending.actions, static_cast<uint64_t>(esp_timer_get_time()));
+	input.pending.keys = keys;
+	input.publish();
+}
+
+void state_exchange::publish() {
+	const auto sequence_{ sequence.load(std::memory_order_relaxed) };
+	sequence.store(sequence_ + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(&published, &pending, sizeof(published));
+	sequence.store(sequence_ + 2, std::memory_order_release);
+}
+
+auto state_exchange::take() -> bool {
+	for (size_t attempt{}; attempt < MAX_SNAPSHOT_RETRIES; ++attempt) {
+		const auto before{ sequence.load(std::memory_order_acquire) };
+		if ((before & 1u) == 0) {
+			input_state copy{};
+			std::memcpy(&copy, &published, sizeof(copy));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (sequence.load(std::memory_order_relaxed) == before) {
+				pressed_keys  = copy.keys.without(snapshot.keys);
+				released_keys = snapshot.keys.without(copy.keys);
+				snapshot      = copy;
+				return true;
+			}
+		}
+		++torn_reads;
+	}
+	// The HID task is preempted mid-publish, the next frame gets it. The edges
+	// were this frame's already, so they don't repeat
+	pressed_keys  = {};
+	released_keys = {};
+	++stale_frames;
+	return false;
+}
+
 } // namespace gzn::input
 
@@ -1,6 +1,9 @@
+#include <array>
+
 #include <esp_log.h>
 
 #include "gzn/input/manager.hpp"
+#include "gzn/filesystem/manager.hpp"
 
 #include "gzn/input/backend/usb.hpp"
 // #include "gzn/input/backend/bluetooth.hpp"
@@ -54,32 +57,97 @@ auto manager::initialized_backends() -> backend_mask {
 	return ctx ? ctx->backends : backend_mask{};
 }
 
+void manager::begin_frame() {
+	ctx->input.take();
+}
+
+auto manager::torn_reads() -> uint32_t {
+	return ctx ? ctx->input.torn_reads : 0;
+}
+
+auto manager::stale_frames() -> uint32_t {
+	return ctx ? ctx->input.stale_frames : 0;
+}
+
+auto manager::is_key_pressed(const uint8_t usage) -> bool {
+	return ctx->input.snapshot.keys.test(usage);
+}
+
+auto manager::is_key_just_pressed(const uint8_t usage) -> bool {
+	return ctx->input.pressed_keys.test(usage);
+}
+
+auto manager::is_key_just_released(const uint8_t usage) -> bool {
+	return ctx->input.released_keys.test(usage);
+}
+
+auto manager::held_keys() -> const key_set & {
+	return ctx->input.snapshot.keys;
+}
+
 auto manager::get_horizontal_action(const action_type action) -> int8_t {
-	return ctx->actions[action].horizontal;
+	return ctx->input.snapshot.actions[action].horizontal;
 }
 
 auto manager::get_vertical_action(const action_type action) -> int8_t {
-	return ctx->actions[action].vertical;
+	return ctx->input.snapshot.actions[action].vertical;
 }
 
 auto manager::is_action_pressed(const action_type action) -> bool {
-	return ctx->actions[action].pressed;
+	return ctx->input.snapshot.actions[action].pressed;
 }
 
 auto manager::is_action_released(const action_type action) -> bool {
-	return !ctx->actions[action].pressed;
+	return !ctx->input.snapshot.actions[action].pressed;
 }
 
 auto manager::is_action_just_pressed(
 	const action_type action, const uint64_t theshold
 ) -> bool {
-	return ctx->actions[action].just_pressed(theshold);
+	return ctx->input.snapshot.actions[action].just_pressed(theshold);
 }
 
 auto manager::is_action_just_released(
 	const action_type action, const uint64_t theshold
 ) -> bool {
-	return ctx->actions[action].just_released(theshold);
+	return ctx->input.snapshot.actions[action].just_released(theshold);
+}
+
+auto manager::load_bindings(const std::string_view file) -> bool {
+	const auto size{ fs::manager::file_size(file) };
+	if (size == SIZE_MAX || size > MAX_BINDINGS_FILE) {
+		ESP_LOGE(TAG, R"(Cannot load "%.*s" bindings, %zu bytes is max)",
+			static_cast<int>(std::size(file)), std::data(file), MAX_BINDINGS_FILE
+		);
+		return false;
+	}
+
+	std::array<uint8_t, MAX_BINDINGS_FILE> config{};
+	auto source{ fs::manager::open(file, false) };
+	if (source.read_into(std::span{ config }.first(size)) != size) {
+		return false;
+	}
+	return ctx->bindings.parse({ reinterpret_cast<const char *>(std::data(config)), size });
+}
+
+void manager::reset_bindings() {
+	ctx->bindings.assign(binding_map::defaults());
+}
+
+void manager::bind_key(const uint8_t usage, const binding bound) {
+	ctx->bindings.bind_key(usage, bound);
+}
+
+void manager::bind_button(const gamepad_button button, const binding bound) {
+	ctx->bindings.bind_button(button, bound);
+}
+
+void manager::bind_axis(const gamepad_axis axis, const action_type action) {
+	ctx->bindings.bind_axis(axis, action);
+}
+
+auto manager::bindings() -> const binding_map & {
+	return ctx->bindings;
 }
 
 auto manager::follow_connection_events(
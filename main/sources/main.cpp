@@ -20,6 +20,9 @@
 #include "gzn/audio/manager.hpp"
 #include "gzn/graphics/render.hpp"
 #include "gzn/filesystem/manager.hpp"
+#include "gzn/filesystem/benchmark.hpp"
+#include "gzn/filesystem/backend/spiffs.hpp"
+#include "gzn/filesystem/backend/littlefs.hpp"
 
 static constexpr auto TAG{ "test-proj" };
 
@@ -34,7 +37,12 @@ static auto initialization() -> bool {
 		heap_caps_get_free_size(MALLOC_CAP_8BIT)
 	);
 
-	if (!fs::manager::initialize({})) {
+	// Collecting garbage holds SPIFFS, a streamed sound would starve meanwhile
+	const fs::manager::setup_info fs_info{
+		.backend{ &fs::backend::spiffs_driver },
+		.gc_config{ .can_collect{ [] { return !audio::manager::is_streaming(); } } },
+	};
+	if (!fs::manager::initialize(fs_info)) {
 		ESP_LOGE(TAG, "Failed to initialize file system");
 		return false;
 	}
@@ -44,13 +52,27 @@ static auto initialization() -> bool {
 		.base_path                    { "/assets" },
 		.partition_label              { "assets" },
 		.max_simultanious_opened_files{ 16 },
-		.format_if_mount_failed       { false }
+		.format_if_mount_failed       { false },
+#if defined(GZN_FS_LITTLEFS)
+		.backend                      { &fs::backend::littlefs_driver },
+#endif // defined(GZN_FS_LITTLEFS)
 	}) };
 	if (mount_result != fs::mount_error::ok) {
 		ESP_LOGE(TAG, "Failed to mount assets: %u", std::to_underlying(mount_result));
 		return false;
 	}
 
+#if defined(GZN_FS_BENCHMARK)
+	if (fs::benchmark_result bench{}; !fs::benchmark::run("/assets", bench)) {
+		ESP_LOGW(TAG, "File system benchmark failed");
+	}
+#endif // defined(GZN_FS_BENCHMARK)
+
+	// Optional till everything is moved to the pack, it's flashed separately
+	if (const auto err{ fs::manager::mount_pack("pack") }; err != fs::mount_error::ok) {
+		ESP_LOGW(TAG, "Asset pack isn't mounted: %u", std::to_underlying(err));
+	}
+
 	const auto render_task_status{ xTaskCreatePinnedToCore(
 		render_loop, "RND",
 		graphics::defaults::render_thread_stack_size,
@@ -75,6 +97,9 @@ static auto initialization() -> bool {
 		return false;
 	}
 	ESP_LOGI(TAG, "input::manager initialized");
+	if (!input::manager::load_bindings("/assets/config/bindings.cfg")) {
+		ESP_LOGW(TAG, "Default controls are used");
+	}
 	ulTaskNotifyTake(false, 1000); // wait for the RND
 
 	ESP_LOGI(TAG, "[POST INIT] Available heap size: %zu",
@@ -137,8 +162,8 @@ void update_loop() {
 	using namespace gzn;
 	using namespace utils::literals; // for _ms
 
-	// audio::manager::play({
-	// 	.filename = "/assets/sounds/sound-track.wav",
+	// audio::manager::play_music({
+	// 	.filename = "/assets/music/sound-track.mod",
 	// 	.loop = true
 	// });
 
@@ -166,7 +191,11 @@ void update_loop() {
 		gzn::vec2 dir{};
 		core::color color{ core::colors::white };
 		float speed{ 50 };
-		audio::track_info fire_sound{ .filename = "/assets/sounds/attack.wav" };
+		audio::sound_event_id fire_sound{ audio::manager::register_event({
+			.track         = { .filename = "/assets/sounds/attack.wav" },
+			.window_ms     = 60,
+			.max_instances = 2,
+		}) };
 
 		void update(const float delta) {
 			constexpr float normalization{ 2.0f / 256 };
@@ -214,7 +243,7 @@ void update_loop() {
 		}
 
 		void fire() {
-			audio::manager::play(fire_sound);
+			audio::manager::trigger(fire_sound);
 
 			size_t index{ last_added_bullet_index + 1 };
 			while (bullets[index].pos != no_pos && index != last_added_bullet_index) {
@@ -254,6 +283,7 @@ void update_loop() {
 		// ESP_LOGI("update_loop", "Delta time: %u ms", delta_time_ms);
 
 		// UPDATING
+		input::manager::begin_frame();
 		audio::manager::update();
 		player.update(delta_time);
 
@@ -0,0 +1,392 @@
+/**
+ * @file main.cpp
+ * @brief Builds and inspects the asset pack which fs::manager::mount_pack() maps
+ *
+ * Usage:
+ *   asset-pack [--compress <.ext>[,<.ext>...]] <directory> <output.pack>
+ *   asset-pack --compress-file <input> <output>
+ *   asset-pack --list <file.pack>
+ *   asset-pack --find <file.pack> <name>
+ *
+ * Every regular file of the directory is packed under its relative path
+ * ("sounds/attack.wav"), only the FNV-1a hash of the path is kept. Files with
+ * the listed extensions are stored as fs::lz when that makes them smaller,
+ * read them with fs::decompressor. --compress-file does the same for a single
+ * file to put on SPIFFS. The pack
+ * is read back through mmap, the same way the device maps the partition.
+ * Flash it with:
+ *   parttool.py write_partition --partition-name=pack --input <output.pack>
+ */
+
+#include <span>
+#include <array>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gzn/filesystem/pack-format.hpp"
+#include "gzn/filesystem/compression.hpp"
+
+namespace {
+
+using namespace gzn::fs;
+
+struct asset {
+	std::string          name{};
+	pack::hash_t         hash{};
+	std::vector<uint8_t> data{};
+	bool                 compressed{ false };
+};
+
+[[nodiscard]]
+auto align(const size_t offset) -> size_t {
+	return (offset + pack::ALIGNMENT - 1) / pack::ALIGNMENT * pack::ALIGNMENT;
+}
+
+auto read_file(const std::filesystem::path &path, std::vector<uint8_t> &data) -> bool {
+	auto file{ std::fopen(path.c_str(), "rb") };
+	if (!file) {
+		return false;
+	}
+	std::array<uint8_t, 4096> chunk{};
+	for (size_t read{}; (read = std::fread(std::data(chunk), 1, std::size(chunk), file)) != 0;) {
+		data.insert(std::end(data), std::begin(chunk), std::begin(chunk) + read);
+	}
+	const auto ok{ !std::ferror(file) };
+	std::fclose(file);
+	return ok;
+}
+
+/// Greedy LZSS of fs::lz, hash chains over the 3-byte prefixes find the matches
+[[nodiscard]]
+auto compress(const std::span<const uint8_t> data) -> std::vector<uint8_t> {
+	constexpr size_t window   { 1u << lz::MAX_WINDOW_BITS };
+	constexpr size_t max_match{ lz::MIN_MATCH + (1u << lz::MAX_LENGTH_BITS) - 1 };
+	constexpr size_t max_depth{ 256 };
+	constexpr size_t hash_bits{ 12 };
+
+	const lz::header info{ .size{ static_cast<uint32_t>(std::size(data)) } };
+	std::vector<uint8_t> out(sizeof(info));
+	std::memcpy(std::data(out), &info, sizeof(info));
+
+	uint32_t bits{};
+	uint8_t  bit_count{};
+	const auto put{ [&](const uint32_t value, const uint8_t width) {
+		for (auto i{ width }; i != 0; --i) {
+			bits = bits << 1 | (value >> (i - 1) & 1);
+			if (++bit_count == 8) {
+				out.push_back(static_cast<uint8_t>(bits));
+				bits = bit_count = 0;
+			}
+		}
+	} };
+
+	const auto size{ std::size(data) };
+	std::vector<int64_t> heads(1u << hash_bits, -1);
+	std::vector<int64_t> previous(size, -1);
+	const auto hash3{ [&](const size_t i) {
+		const uint32_t prefix{ uint32_t{ data[i] } << 16 | uint32_t{ data[i + 1] } << 8 | data[i + 2] };
+		return (prefix * 2'654'435'761u) >> (32 - hash_bits);
+	} };
+	const auto insert{ [&](const size_t i) {
+		if (i + lz::MIN_MATCH <= size) {
+			auto &head{ heads[hash3(i)] };
+			previous[i] = std::exchange(head, static_cast<int64_t>(i));
+		}
+	} };
+
+	for (size_t i{}; i < size;) {
+		size_t best_length{};
+		size_t best_distance{};
+		if (i + lz::MIN_MATCH <= size) {
+			const auto limit{ std::min(max_match, size - i) };
+			size_t depth{};
+			for (auto candidate{ heads[hash3(i)] };
+				candidate >= 0 && i - static_cast<size_t>(candidate) <= window && depth < max_depth;
+				candidate = previous[static_cast<size_t>(candidate)], ++depth
+			) {
+				const auto from{ static_cast<size_t>(candidate) };
+				size_t length{};
+				while (length < limit && data[from + length] == data[i + length]) {
+					++length;
+				}
+				if (length > best_length) {
+					best_length   = length;
+					best_distance = i - from;
+					if (length == limit) {
+						break;
+					}
+				}
+			}
+		}
+
+		if (best_length >= lz::MIN_MATCH) {
+			put(0, 1);
+			put(static_cast<uint32_t>(best_distance - 1), info.window_bits);
+			put(static_cast<uint32_t>(best_length - lz::MIN_MATCH), info.length_bits);
+			for (const auto end{ i + best_length }; i < end; ++i) {
+				insert(i);
+			}
+		} else {
+			put(1, 1);
+			put(data[i], 8);
+			insert(i++);
+		}
+	}
+	if (bit_count != 0) {
+		out.push_back(static_cast<uint8_t>(bits << (8 - bit_count)));
+	}
+	return out;
+}
+
+/// Decodes it back the way the device does, a broken asset is worse than a big one
+[[nodiscard]]
+auto round_trips(const std::span<const uint8_t> compressed, const std::span<const uint8_t> original) -> bool {
+	decompressor source{ compressed };
+	std::vector<uint8_t> decoded(std::size(original) + 1);
+	const auto read{ source.read_into(decoded) };
+	return source && source.eof() && read == std::size(original)
+		&& std::equal(std::begin(original), std::end(original), std::begin(decoded));
+}
+
+/// Replaces the data with the compressed one if it's smaller
+auto try_compress(std::vector<uint8_t> &data) -> bool {
+	auto compressed{ compress(data) };
+	if (std::size(compressed) >= std::size(data)) {
+		return false;
+	}
+	if (!round_trips(compressed, data)) {
+		std::fprintf(stderr, "Compression doesn't round-trip, kept uncompressed\n");
+		return false;
+	}
+	data = std::move(compressed);
+	return true;
+}
+
+[[nodiscard]]
+auto has_extension(const std::filesystem::path &path, const std::string_view extensions) -> bool {
+	const auto extension{ path.extension().string() };
+	if (std::empty(extension)) {
+		return false;
+	}
+	for (size_t start{}; start <= std::size(extensions);) {
+		const auto end{ std::min(extensions.find(',', start), std::size(extensions)) };
+		if (extensions.substr(start, end - start) == extension) {
+			return true;
+		}
+		start = end + 1;
+	}
+	return false;
+}
+
+auto build(const char *directory, const char *output_path, const std::string_view compressed_extensions) -> int {
+	std::vector<asset> assets{};
+
+	std::error_code error{};
+	for (const auto &item : std::filesystem::recursive_directory_iterator{ directory, error }) {
+		if (!item.is_regular_file()) {
+			continue;
+		}
+		asset packed{ .name{ std::filesystem::relative(item.path(), directory).generic_string() } };
+		packed.hash = pack::hash(packed.name);
+		if (!read_file(item.path(), packed.data)) {
+			std::fprintf(stderr, "Cannot read \"%s\"\n", item.path().c_str());
+			return 1;
+		}
+		if (has_extension(item.path(), compressed_extensions)) {
+			packed.compressed = try_compress(packed.data);
+		}
+		assets.push_back(std::move(packed));
+	}
+	if (error) {
+		std::fprintf(stderr, "Cannot list \"%s\": %s\n", directory, error.message().c_str());
+		return 1;
+	}
+
+	std::ranges::sort(assets, {}, &asset::hash);
+	for (size_t i{ 1 }; i < std::size(assets); ++i) {
+		if (assets[i - 1].hash == assets[i].hash) {
+			std::fprintf(stderr, "Hash collision of \"%s\" and \"%s\", rename one of them\n",
+				assets[i - 1].name.c_str(), assets[i].name.c_str()
+			);
+			return 1;
+		}
+	}
+
+	std::vector<pack::entry> entries{};
+	size_t offset{ align(sizeof(pack::header) + std::size(assets) * sizeof(pack::entry)) };
+	for (const auto &packed : assets) {
+		entries.push_back({
+			.hash{ packed.hash },
+			.offset{ static_cast<uint32_t>(offset) },
+			.size{ static_cast<uint32_t>(std::size(packed.data)) },
+		});
+		offset = align(offset + std::size(packed.data));
+	}
+
+	std::vector<uint8_t> blob(offset);
+	const pack::header header{
+		.count{ static_cast<uint32_t>(std::size(entries)) },
+		.size{ static_cast<uint32_t>(std::size(blob)) },
+	};
+	std::memcpy(std::data(blob), &header, sizeof(header));
+	std::memcpy(std::data(blob) + sizeof(header), std::data(entries), std::size(entries) * sizeof(pack::entry));
+	for (size_t i{}; i < std::size(assets); ++i) {
+		std::ranges::copy(assets[i].data, std::begin(blob) + entries[i].offset);
+	}
+
+	auto file{ std::fopen(output_path, "wb") };
+	if (!file || std::fwrite(std::data(blob), 1, std::size(blob), file) != std::size(blob)) {
+		std::fprintf(stderr, "Cannot write \"%s\"\n", output_path);
+		if (file) {
+			std::fclose(file);
+		}
+		return 1;
+	}
+	std::fclose(file);
+
+	for (size_t i{}; i < std::size(assets); ++i) {
+		std::printf("%08x %8u %s%s\n", entries[i].hash, entries[i].size,
+			assets[i].name.c_str(), assets[i].compressed ? " (lzss)" : ""
+		);
+	}
+	std::printf("Packed %zu assets, %zu bytes to \"%s\"\n", std::size(assets), std::size(blob), output_path);
+	return 0;
+}
+
+/// Read-only mapping of the whole file, like esp_partition_mmap() on the device
+class mapped_file {
+public:
+	explicit mapped_file(const char *path) {
+		const auto fd{ ::open(path, O_RDONLY) };
+		if (fd < 0) {
+			return;
+		}
+		struct stat info{};
+		if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+			const auto size{ static_cast<size_t>(info.st_size) };
+			if (auto data{ ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) }; data != MAP_FAILED) {
+				view = std::span{ static_cast<const uint8_t *>(data), size };
+			}
+		}
+		::close(fd);
+	}
+
+	~mapped_file() {
+		if (!std::empty(view)) {
+			::munmap(const_cast<uint8_t *>(std::data(view)), std::size(view));
+		}
+	}
+
+	mapped_file(const mapped_file &) = delete;
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	std::span<const uint8_t> view{};
+};
+
+auto open_pack(const char *path, mapped_file &file) -> bool {
+	if (std::empty(file.view)) {
+		std::fprintf(stderr, "Cannot map \"%s\"\n", path);
+		return false;
+	}
+	if (const auto err{ pack::validate(file.view) }; err != pack::error::ok) {
+		std::fprintf(stderr, "\"%s\" is not a valid pack: %u\n", path, static_cast<unsigned>(err));
+		return false;
+	}
+	return true;
+}
+
+auto list(const char *path) -> int {
+	mapped_file file{ path };
+	if (!open_pack(path, file)) {
+		return 1;
+	}
+	for (const auto &item : pack::entries(file.view)) {
+		lz::header info{};
+		if (lz::read_header(file.view.subspan(item.offset, item.size), info)) {
+			std::printf("%08x %8u @ %u, lzss of %u\n", item.hash, item.size, item.offset, info.size);
+		} else {
+			std::printf("%08x %8u @ %u\n", item.hash, item.size, item.offset);
+		}
+	}
+	return 0;
+}
+
+auto compress_file(const char *input_path, const char *output_path) -> int {
+	std::vector<uint8_t> data{};
+	if (!read_file(input_path, data)) {
+		std::fprintf(stderr, "Cannot read \"%s\"\n", input_path);
+		return 1;
+	}
+	const auto original{ std::size(data) };
+	if (!try_compress(data)) {
+		std::fprintf(stderr, "\"%s\" doesn't get smaller, keep it as it is\n", input_path);
+		return 1;
+	}
+
+	auto file{ std::fopen(output_path, "wb") };
+	if (!file || std::fwrite(std::data(data), 1, std::size(data), file) != std::size(data)) {
+		std::fprintf(stderr, "Cannot write \"%s\"\n", output_path);
+		if (file) {
+			std::fclose(file);
+		}
+		return 1;
+	}
+	std::fclose(file);
+	std::printf("%zu -> %zu bytes to \"%s\"\n", original, std::size(data), output_path);
+	return 0;
+}
+
+auto find(const char *path, const std::string_view name) -> int {
+	mapped_file file{ path };
+	if (!open_pack(path, file)) {
+		return 1;
+	}
+	const auto found{ pack::find(file.view, pack::hash(name)) };
+	if (std::data(found) == nullptr) {
+		std::fprintf(stderr, "No \"%.*s\" in the pack\n", static_cast<int>(std::size(name)), std::data(name));
+		return 1;
+	}
+	std::printf("%08x %8zu @ %td\n", pack::hash(name), std::size(found), std::data(found) - std::data(file.view));
+	return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	const std::span args{ argv, static_cast<size_t>(argc) };
+	if (argc == 3 && std::string_view{ args[1] } == "--list") {
+		return list(args[2]);
+	}
+	if (argc == 4 && std::string_view{ args[1] } == "--find") {
+		return find(args[2], args[3]);
+	}
+	if (argc == 4 && std::string_view{ args[1] } == "--compress-file") {
+		return compress_file(args[2], args[3]);
+	}
+	if (argc == 5 && std::string_view{ args[1] } == "--compress") {
+		return build(args[3], args[4], args[2]);
+	}
+	if (argc == 3 && !std::string_view{ args[1] }.starts_with("--")) {
+		return build(args[1], args[2], {});
+	}
+
+	std::fprintf(stderr,
+		"Usage:\n"
+		"  %s [--compress <.ext>[,<.ext>...]] <directory> <output.pack>\n"
+		"  %s --compress-file <input> <output>\n"
+		"  %s --list <file.pack>\n"
+		"  %s --find <file.pack> <name>\n",
+		args[0], args[0], args[0], args[0]
+	);
+	return 1;
+}
@@ -0,0 +1,628 @@
+/**
+ * @file main.cpp
+ * @brief Offline renderer & benchmark of the audio mixing path
+ *
+ * Runs the same voice allocation, fetching, mixing and PWM formatting code
+ * as the sound streaming task does, but without FreeRTOS and the speaker.
+ *
+ * Usage:
+ *   audio-render <script> <output.wav>
+ *   audio-render --bench <file.wav> [blocks]
+ *
+ * Script is a list of timestamped events, one per line (`#` for comments):
+ *   <time_ms> play <name> <file.wav> [volume=<-16..16>] [priority=<0..255>] [pan=<-16..16>] [loop] [exact]
+ *   <time_ms> play <name> sfx:<laser|pickup|jump|explosion|hit|blip> [options as above]
+ *   <time_ms> stop <name>
+ *   <time_ms> music <file.mod> [volume=<-16..16>] [once]
+ *   <time_ms> stop-music
+ *   <time_ms> end
+ * Events are applied at the start of the block they fall into like on the
+ * device, `exact` plays start at their very sample (manager::play_at()).
+ * Rendering stops at `end` or when the script is over and nothing is playing.
+ *
+ * Expectations are checked against the rendered output once it's over, and
+ * the tool fails if any isn't met, see tests/:
+ *   <from_ms> expect silence <to_ms>            every sample is 0
+ *   <from_ms> expect peak <to_ms> <min> <max>   the largest magnitude is in [min; max]
+ *   <from_ms> expect period <to_ms> <frames>    every frame equals the one `frames` later
+ *   <time_ms> expect end                        rendering stopped within the block before
+ */
+
+#include <span>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <charconv>
+#include <algorithm>
+#include <string_view>
+
+#include "gzn/audio/synth.hpp"
+#include "gzn/audio/mixer.hpp"
+#include "gzn/audio/tracker.hpp"
+#include "gzn/audio/wav-format.hpp"
+#include "gzn/audio/backend/pwm.hpp"
+
+namespace {
+
+using namespace gzn;
+using namespace gzn::audio;
+
+inline constexpr uint32_t OUTPUT_RATE{ std::to_underlying(SAMPLE_RATE) };
+inline constexpr std::string_view SFX_PREFIX{ "sfx:" };
+
+inline constexpr std::array<std::pair<std::string_view, sfx_params>, 6> SFX_PRESETS{ {
+	{ "laser",     sfx_presets::LASER     },
+	{ "pickup",    sfx_presets::PICKUP    },
+	{ "jump",      sfx_presets::JUMP      },
+	{ "explosion", sfx_presets::EXPLOSION },
+	{ "hit",       sfx_presets::HIT       },
+	{ "blip",      sfx_presets::BLIP      },
+} };
+
+/// Mirrors audio::manager without locks and the streaming task
+struct host_manager {
+	std::array<voice_state, MAX_SOUND_TRACKS> voices{};
+	audio::mixer                              mixer{};
+	tracker                                   music{};
+	std::vector<uint8_t>                      music_data{};
+	std::vector<std::vector<int16_t>>         effects{}; ///< rendered once, outlive the voices
+	int8_t                                    music_volume{};
+	output_array                              output{};
+	duty_array                                duties{};
+	uint32_t                                  tracks_bitset{};
+	uint32_t                                  mixed_blocks{};
+	uint32_t                                  output_frames{};
+	uint8_t                                   voices_count{ MAX_SOUND_TRACKS };
+
+	~host_manager() {
+		for (auto &voice : voices) {
+			voice.close();
+		}
+	}
+
+	/// @param start_frame output frame to start at, if @p scheduled
+	auto play(const track_info &info, const bool scheduled = false, const uint32_t start_frame = 0) -> track_id {
+		const auto index{ select_voice(
+			std::span{ std::data(voices), voices_count }, tracks_bitset, info.priority
+		) };
+		if (index == NO_VOICE) {
+			std::fprintf(stderr, "No voice for \"%.*s\"\n",
+				static_cast<int>(std::size(info.filename)), std::data(info.filename)
+			);
+			return INVALID_TRACK_ID;
+		}
+
+		stream_info stream{};
+		const auto result{ info.filename.starts_with(SFX_PREFIX)
+			? open_effect(info, stream)
+			: open_stream(info, stream)
+		};
+		if (result != open_result::ok) {
+			std::fprintf(stderr, "Cannot open \"%.*s\": %u\n",
+				static_cast<int>(std::size(info.filename)), std::data(info.filename),
+				std::to_underlying(result)
+			);
+			return INVALID_TRACK_ID;
+		}
+		if (scheduled) {
+			stream.schedule(start_frame);
+		}
+
+		voices[index].start(std::move(stream), mixed_blocks);
+		tracks_bitset |= (1u << index);
+		return make_track_id(index, voices[index].generation);
+	}
+
+	auto open_effect(const track_info &info, stream_info &stream) -> open_result {
+		const auto name{ info.filename.substr(std::size(SFX_PREFIX)) };
+		const auto preset{ std::ranges::find(SFX_PRESETS, name, &decltype(SFX_PRESETS)::value_type::first) };
+		if (preset == std::end(SFX_PRESETS)) {
+			return open_result::cannot_open;
+		}
+
+		auto &samples{ effects.emplace_back(sfx_length(preset->second)) };
+		samples.resize(render_sfx(preset->second, samples));
+		return open_stream(samples, info, stream);
+	}
+
+	auto stop(const track_id track) -> bool {
+		const auto index{ track_index(track) };
+		if (index >= voices_count || voices[index].generation != track_generation(track)) {
+			return false;
+		}
+		voices[index].close();
+		tracks_bitset &= ~(1u << index);
+		return true;
+	}
+
+	auto play_music(const std::string &filename, const int8_t volume, const bool loop) -> bool {
+		music.unload();
+		music_data.clear();
+
+		auto file{ std::fopen(std::data(filename), "rb") };
+		if (!file) {
+			std::fprintf(stderr, "Cannot open \"%s\"\n", std::data(filename));
+			return false;
+		}
+		std::array<uint8_t, 4096> chunk{};
+		for (size_t read{}; (read = std::fread(std::data(chunk), 1, std::size(chunk), file)) != 0;) {
+			music_data.insert(std::end(music_data), std::begin(chunk), std::begin(chunk) + read);
+		}
+		std::fclose(file);
+
+		if (const auto err{ music.load(music_data) }; err != tracker_error::ok) {
+			std::fprintf(stderr, "Cannot load \"%s\" module: %u\n",
+				std::data(filename), std::to_underlying(err)
+			);
+			return false;
+		}
+		music.loop   = loop;
+		music_volume = volume;
+		return true;
+	}
+
+	void update() {
+		for (size_t i{}; i < voices_count; ++i) {
+			if (!voices[i].busy()) {
+				tracks_bitset &= ~(1u << i);
+			}
+		}
+	}
+
+	/// The bodies of prefetch_task and sound_streaming_task: read, fetch, mix & format
+	auto render_block() -> size_t {
+		bool scheduled{ false };
+		for (size_t i{}; i < voices_count; ++i) {
+			while (voices[i].prefetch()) {}
+			mixer.fetch(i, voices[i], output_frames);
+			scheduled |= voices[i].scheduled;
+			if (voices[i].swap_due()) {
+				voices[i].swap();
+			}
+		}
+		if (music.is_playing()) {
+			mixer.fetch_music(music, music_volume);
+		} else {
+			mixer.skip(MUSIC_TRACK);
+		}
+		auto mixed{ mixer.mix(output) };
+		if (mixed == 0 && scheduled) {
+			std::ranges::fill(output, int16_t{});
+			mixed = SAMPLE_BATCH_SIZE;
+		}
+		if (mixed != 0) {
+			++mixed_blocks;
+			pwm::format(std::span{ std::data(output), mixed * OUTPUT_CHANNELS }, duties);
+		}
+		output_frames += static_cast<uint32_t>(mixed);
+		return mixed;
+	}
+};
+
+class wav_writer {
+public:
+	explicit wav_writer(const char *path) : file{ std::fopen(path, "wb") } {
+		if (file) {
+			const wav::header header{};
+			std::fwrite(&header, sizeof(header), 1, file);
+		}
+	}
+
+	~wav_writer() {
+		if (!file) {
+			return;
+		}
+
+		wav::header header{};
+		header.descriptor.size         = sizeof(header) - 8 + samples * BYTES_PER_SAMPLE;
+		header.format.channels         = OUTPUT_CHANNELS;
+		header.format.sample_rate      = OUTPUT_RATE;
+		header.format.byte_rate        = OUTPUT_RATE * BYTES_PER_SAMPLE * OUTPUT_CHANNELS;
+		header.format.block_align      = BYTES_PER_SAMPLE * OUTPUT_CHANNELS;
+		header.format.bits_per_sample  = BITS_PER_SAMPLE;
+		header.data.size               = samples * BYTES_PER_SAMPLE;
+
+		std::fseek(file, 0, SEEK_SET);
+		std::fwrite(&header, sizeof(header), 1, file);
+		std::fclose(file);
+	}
+
+	wav_writer(const wav_writer &) = delete;
+	wav_writer &operator=(const wav_writer &) = delete;
+
+	[[nodiscard]] auto is_open() const -> bool { return file != nullptr; }
+
+	void write(std::span<const int16_t> pcm) {
+		std::fwrite(std::data(pcm), sizeof(int16_t), std::size(pcm), file);
+		samples += static_cast<uint32_t>(std::size(pcm));
+	}
+
+private:
+	std::FILE *file{};
+	uint32_t   samples{};
+};
+
+
+/// What the speaker gets: duties are turned back to signed PCM
+void append_duties(std::span<const uint16_t> duties, std::vector<int16_t> &pcm) {
+	for (const auto duty : duties) {
+		pcm.push_back(static_cast<int16_t>((duty << DUTY_SHIFT) - 0x8000));
+	}
+}
+
+enum class event_type : uint8_t { play, stop, music, stop_music, end };
+
+enum class check_type : uint8_t { silence, peak, period, end };
+
+struct expectation {
+	size_t     line{};
+	check_type type{};
+	uint32_t   from_ms{};
+	uint32_t   to_ms{};
+	int32_t    min{};
+	int32_t    max{};
+	uint32_t   period{};  ///< in frames
+};
+
+struct event {
+	uint32_t    time_ms{};
+	event_type  type{};
+	std::string name{};
+	std::string filename{};
+	int8_t      volume{ 16 };
+	int8_t      pan{ PAN_CENTER };
+	uint8_t     priority{ DEFAULT_PRIORITY };
+	bool        loop{ false };
+	bool        exact{ false };
+};
+
+template<class T>
+auto parse_number(const std::string_view text, T &value) -> bool {
+	const auto [ptr, ec]{ std::from_chars(std::data(text), std::data(text) + std::size(text), value) };
+	return ec == std::errc{} && ptr == std::data(text) + std::size(text);
+}
+
+auto split(std::string_view line) -> std::vector<std::string_view> {
+	std::vector<std::string_view> tokens{};
+	while (!std::empty(line)) {
+		const auto begin{ line.find_first_not_of(" \t\r") };
+		if (begin == std::string_view::npos) {
+			break;
+		}
+		line.remove_prefix(begin);
+		const auto end{ std::min(line.find_first_of(" \t\r"), std::size(line)) };
+		tokens.emplace_back(line.substr(0, end));
+		line.remove_prefix(end);
+	}
+	return tokens;
+}
+
+/// @returns false if @p tokens aren't an expectation at all
+auto parse_expectation(const std::span<const std::string_view> tokens, expectation &out) -> bool {
+	const auto kind{ tokens[2] };
+	if (kind == "end") {
+		out.type = check_type::end;
+		return std::size(tokens) == 3;
+	}
+	if (std::size(tokens) < 4 || !parse_number(tokens[3], out.to_ms) || out.to_ms <= out.from_ms) {
+		return false;
+	}
+	if (kind == "silence") {
+		out.type = check_type::silence;
+		return std::size(tokens) == 4;
+	}
+	if (kind == "peak") {
+		out.type = check_type::peak;
+		return std::size(tokens) == 6
+			&& parse_number(tokens[4], out.min) && parse_number(tokens[5], out.max) && out.min <= out.max;
+	}
+	if (kind == "period") {
+		out.type = check_type::period;
+		return std::size(tokens) == 5 && parse_number(tokens[4], out.period) && out.period != 0;
+	}
+	return false;
+}
+
+auto parse_script(const char *path, std::vector<event> &events, std::vector<expectation> &expectations) -> bool {
+	auto file{ std::fopen(path, "r") };
+	if (!file) {
+		std::fprintf(stderr, "Cannot open script \"%s\"\n", path);
+		return false;
+	}
+
+	std::array<char, 512> buffer{};
+	for (size_t line_number{ 1 }; std::fgets(std::data(buffer), std::size(buffer), file); ++line_number) {
+		std::string_view line{ std::data(buffer) };
+		line = line.substr(0, line.find_first_of("#\n"));
+
+		const auto tokens{ split(line) };
+		if (std::empty(tokens)) {
+			continue;
+		}
+
+		event ev{};
+		bool valid{ std::size(tokens) >= 2 && parse_number(tokens[0], ev.time_ms) };
+		if (valid && tokens[1] == "expect" && std::size(tokens) >= 3) {
+			expectation check{ .line = line_number, .from_ms = ev.time_ms };
+			if (parse_expectation(tokens, check)) {
+				expectations.push_back(check);
+				continue;
+			}
+			valid = false;
+		} else if (valid && tokens[1] == "play" && std::size(tokens) >= 4) {
+			ev.type     = event_type::play;
+			ev.name     = tokens[2];
+			ev.filename = tokens[3];
+			for (const auto option : std::span{ tokens }.subspan(4)) {
+				if (option == "loop") {
+					ev.loop = true;
+				} else if (option == "exact") {
+					ev.exact = true;
+				} else if (option.starts_with("volume=")) {
+					int value{};
+					valid &= parse_number(option.substr(7), value);
+					ev.volume = static_cast<int8_t>(std::clamp<int>(value, -VOLUME_0DB, VOLUME_0DB));
+				} else if (option.starts_with("priority=")) {
+					valid &= parse_number(option.substr(9), ev.priority);
+				} else if (option.starts_with("pan=")) {
+					int value{};
+					valid &= parse_number(option.substr(4), value);
+					ev.pan = static_cast<int8_t>(std::clamp<int>(value, PAN_LEFT, PAN_RIGHT));
+				} else {
+					valid = false;
+				}
+			}
+		} else if (valid && tokens[1] == "music" && std::size(tokens) >= 3) {
+			ev.type     = event_type::music;
+			ev.filename = tokens[2];
+			ev.volume   = 0;
+			ev.loop     = true;
+			for (const auto option : std::span{ tokens }.subspan(3)) {
+				if (option == "once") {
+					ev.loop = false;
+				} else if (option.starts_with("volume=")) {
+					int value{};
+					valid &= parse_number(option.substr(7), value);
+					ev.volume = static_cast<int8_t>(std::clamp<int>(value, -VOLUME_0DB, VOLUME_0DB));
+				} else {
+					valid = false;
+				}
+			}
+		} else if (valid && tokens[1] == "stop-music" && std::size(tokens) == 2) {
+			ev.type = event_type::stop_music;
+		} else if (valid && tokens[1] == "stop" && std::size(tokens) == 3) {
+			ev.type = event_type::stop;
+			ev.name = tokens[2];
+		} else if (valid && tokens[1] == "end") {
+			ev.type = event_type::end;
+		} else {
+			valid = false;
+		}
+
+		if (!valid) {
+			std::fprintf(stderr, "%s:%zu: invalid event\n", path, line_number);
+			std::fclose(file);
+			return false;
+		}
+		events.push_back(std::move(ev));
+	}
+	std::fclose(file);
+
+	std::ranges::stable_sort(events, {}, &event::time_ms);
+	return true;
+}
+
+[[nodiscard]]
+constexpr auto frame_at(const uint32_t time_ms) -> size_t {
+	return size_t{ time_ms } * OUTPUT_RATE / 1000u;
+}
+
+/// Prints every expectation which isn't met, @p pcm is the whole output
+auto check(const char *script_path, const std::vector<expectation> &expectations, const std::span<const int16_t> pcm) -> bool {
+	const auto frames{ std::size(pcm) / OUTPUT_CHANNELS };
+	bool passed{ true };
+	for (const auto &expected : expectations) {
+		const auto from{ frame_at(expected.from_ms) };
+		const auto to  { frame_at(expected.to_ms) };
+		const auto fail{ [&](const char *what, const long long got) {
+			std::fprintf(stderr, "%s:%zu: expected %s, got %lld\n", script_path, expected.line, what, got);
+			passed = false;
+		} };
+		if (expected.type == check_type::end) {
+			if (frames > from || frames + SAMPLE_BATCH_SIZE <= from) {
+				fail("the end", static_cast<long long>(frames));
+			}
+			continue;
+		}
+		if (to > frames) {
+			fail("more frames", static_cast<long long>(frames));
+			continue;
+		}
+
+		const auto range{ pcm.subspan(from * OUTPUT_CHANNELS, (to - from) * OUTPUT_CHANNELS) };
+		switch (expected.type) {
+			case check_type::silence:
+				if (const auto loud{ std::ranges::find_if(range, [](const int16_t s) { return s != 0; }) };
+					loud != std::end(range)
+				) {
+					fail("silence", static_cast<long long>(from + (loud - std::begin(range)) / OUTPUT_CHANNELS));
+				}
+				break;
+
+			case check_type::peak: {
+				int32_t peak{};
+				for (const auto sample : range) {
+					peak = std::max(peak, std::abs(int32_t{ sample }));
+				}
+				if (peak < expected.min || peak > expected.max) {
+					fail("the peak in range", peak);
+				}
+			} break;
+
+			case check_type::period: {
+				const auto shift{ size_t{ expected.period } * OUTPUT_CHANNELS };
+				if (to + expected.period > frames) {
+					fail("more frames", static_cast<long long>(frames));
+					break;
+				}
+				for (size_t i{}; i < std::size(range); ++i) {
+					if (range[i] != std::data(pcm)[from * OUTPUT_CHANNELS + i + shift]) {
+						fail("a repeat of the frame", static_cast<long long>(from + i / OUTPUT_CHANNELS));
+						break;
+					}
+				}
+			} break;
+
+			case check_type::end: break;
+		}
+	}
+	return passed;
+}
+
+auto render(const char *script_path, const char *output_path) -> int {
+	std::vector<event>       events{};
+	std::vector<expectation> expectations{};
+	if (!parse_script(script_path, events, expectations)) {
+		return 1;
+	}
+
+	wav_writer writer{ output_path };
+	if (!writer.is_open()) {
+		std::fprintf(stderr, "Cannot create \"%s\"\n", output_path);
+		return 1;
+	}
+
+	host_manager manager{};
+	std::vector<std::pair<std::string, track_id>> tracks{};
+	std::vector<int16_t> pcm{};
+
+	uint64_t rendered{};
+	auto next{ std::begin(events) };
+	while (true) {
+		// Events within the block about to be rendered
+		const auto frame_of{ [](const event &ev) { return uint64_t{ frame_at(ev.time_ms) }; } };
+		bool finished{ false };
+		for (; next != std::end(events) && frame_of(*next) < rendered + SAMPLE_BATCH_SIZE; ++next) {
+			switch (next->type) {
+				case event_type::play: {
+					const auto id{ manager.play(track_info{
+						.filename = next->filename,
+						.volume   = next->volume,
+						.loop     = next->loop,
+						.priority = next->priority,
+						.pan      = next->pan,
+					}, next->exact, static_cast<uint32_t>(frame_of(*next))) };
+					tracks.emplace_back(next->name, id);
+				} break;
+
+				case event_type::stop:
+					for (const auto &[name, id] : tracks) {
+						if (name == next->name) {
+							manager.stop(id);
+						}
+					}
+					break;
+
+				case event_type::music:
+					manager.play_music(next->filename, next->volume, next->loop);
+					break;
+
+				case event_type::stop_music:
+					manager.music.unload();
+					break;
+
+				case event_type::end:
+					finished = true;
+					break;
+			}
+		}
+		if (finished) {
+			break;
+		}
+
+		manager.update();
+		const auto mixed{ manager.render_block() };
+		if (mixed == 0) {
+			if (next == std::end(events)) {
+				break;
+			}
+			pcm.resize(std::size(pcm) + SAMPLE_BATCH_SIZE * OUTPUT_CHANNELS);
+			rendered += SAMPLE_BATCH_SIZE;
+			manager.output_frames += SAMPLE_BATCH_SIZE;
+			continue;
+		}
+
+		append_duties(std::span{ std::data(manager.duties), mixed * OUTPUT_CHANNELS }, pcm);
+		rendered += mixed;
+	}
+	writer.write(pcm);
+
+	std::printf("Rendered %llu frames (%.3f s) to \"%s\"\n",
+		static_cast<unsigned long long>(rendered),
+		static_cast<double>(rendered) / OUTPUT_RATE, output_path
+	);
+	if (!check(script_path, expectations, pcm)) {
+		return 1;
+	}
+	if (!std::empty(expectations)) {
+		std::printf("%zu expectations are met\n", std::size(expectations));
+	}
+	return 0;
+}
+
+auto benchmark(const char *sound_path, const size_t blocks) -> int {
+	using clock = std::chrono::steady_clock;
+
+	std::printf("voices | blocks | output samples/s | voice samples/s | realtime x\n");
+	for (size_t voices{ 1 }; voices <= MAX_SOUND_TRACKS; ++voices) {
+		host_manager manager{};
+		for (size_t i{}; i < voices; ++i) {
+			if (INVALID_TRACK_ID == manager.play({ .filename = sound_path, .loop = true })) {
+				return 1;
+			}
+		}
+
+		size_t samples{};
+		const auto begin{ clock::now() };
+		for (size_t i{}; i < blocks; ++i) {
+			samples += manager.render_block();
+		}
+		const std::chrono::duration<double> elapsed{ clock::now() - begin };
+
+		const auto throughput{ static_cast<double>(samples) / elapsed.count() };
+		std::printf("%6zu | %6zu | %16.0f | %15.0f | %10.1f\n",
+			voices, blocks, throughput, throughput * static_cast<double>(voices),
+			throughput / OUTPUT_RATE
+		);
+	}
+	return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	if (argc >= 3 && std::string_view{ argv[1] } == "--bench") {
+		size_t blocks{ 2000 };
+		if (argc >= 4 && !parse_number(std::string_view{ argv[3] }, blocks)) {
+			std::fprintf(stderr, "Invalid blocks count \"%s\"\n", argv[3]);
+			return 1;
+		}
+		return benchmark(argv[2], blocks);
+	}
+
+	if (argc != 3) {
+		std::fprintf(stderr,
+			"Usage:\n"
+			"  %s <script> <output.wav>\n"
+			"  %s --bench <file.wav> [blocks]\n",
+			argv[0], argv[0]
+		);
+		return 1;
+	}
+	return render(argv[1], argv[2]);
+}
@@ -0,0 +1,238 @@
+/**
+ * @file main.cpp
+ * @brief fs::manager on a development machine, see backend::posix
+ *
+ * Mounts `<root>/assets` under /assets and `<root>/pack.bin` as the asset
+ * pack, then reads the files the way the game does and times them.
+ *
+ * Usage:
+ *   fs-host <root> [--spiffs] [--cache <blocks>] [--chunk <bytes>] <file>...
+ *   fs-host <root> [--spiffs] --bench
+ *   fs-host <root> [--spiffs] --stream <file>...
+ * Files are relative to /assets. Each one is read cold and then warm with
+ * read_file(), then once more through the I/O queue. `--spiffs` adds the
+ * delays of backend::spiffs_timings, `--cache 0` disables the block
+ * cache. `--bench` runs fs::benchmark on /assets as the firmware built with
+ * GZN_FS_BENCHMARK does. `--stream` plays the files twice through a looping
+ * fs::stream, 512 bytes a millisecond, checks the data and reports the fill.
+ */
+
+#include <span>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "gzn/filesystem/stream.hpp"
+#include "gzn/filesystem/manager.hpp"
+#include "gzn/filesystem/benchmark.hpp"
+#include "gzn/filesystem/backend/posix.hpp"
+
+namespace {
+
+using namespace gzn;
+
+struct options {
+	fs::backend::posix::config backend{};
+	fs::block_cache::config    cache{};
+	size_t                     chunk{ 1024 };
+	std::vector<std::string>   files{};
+	bool                       bench{ false };
+	bool                       stream{ false };
+};
+
+auto parse_number(const std::string_view text, size_t &value) -> bool {
+	const auto [end, error]{ std::from_chars(std::data(text), std::data(text) + std::size(text), value) };
+	return error == std::errc{} && end == std::data(text) + std::size(text);
+}
+
+auto elapsed_ms(const std::chrono::steady_clock::time_point begin) -> double {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void report(const char *pass, const std::string &file, const size_t bytes, const double ms) {
+	const auto stats{ fs::manager::cache_stats() };
+	std::printf("%-6s %-32s %8zu B %9.3f ms %8.2f MB/s  cache %u hits %u misses\n",
+		pass, file.c_str(), bytes, ms,
+		ms > 0.0 ? static_cast<double>(bytes) / 1000.0 / ms : 0.0,
+		static_cast<unsigned>(stats.hits), static_cast<unsigned>(stats.misses)
+	);
+	fs::manager::reset_cache_stats();
+}
+
+auto read_synchronous(const std::string &file, const size_t chunk, size_t &bytes) -> bool {
+	std::vector<uint8_t> buffer(chunk);
+	bytes = 0;
+	return fs::manager::read_file(file, buffer, [&](const std::span<uint8_t> data) {
+		bytes += std::size(data);
+		return true;
+	});
+}
+
+auto read_queued(const std::string &file, const size_t size, size_t &bytes) -> bool {
+	std::vector<uint8_t> buffer(size);
+	const auto id{ fs::manager::submit({
+		.file{ file },
+		.destination{ buffer },
+		.notify{ xTaskGetCurrentTaskHandle() },
+	}) };
+	if (id == fs::invalid_request) {
+		return false;
+	}
+
+	auto result{ fs::manager::status(id) };
+	while (result.status == fs::io_status::pending || result.status == fs::io_status::reading) {
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+		result = fs::manager::status(id);
+	}
+	bytes = result.read;
+	return result.status == fs::io_status::done;
+}
+
+/// Two laps of a looping stream against the file read in one go
+auto play_stream(const std::string &file, const size_t size, size_t &lowest) -> bool {
+	std::vector<uint8_t> expected(size);
+	if (auto source{ fs::manager::open(file, false) }; !source || source.read_into(expected) != size) {
+		return false;
+	}
+
+	fs::stream music{};
+	if (!music.open(file, { .loop{ true } }) || !music.wait(music.capacity(), pdMS_TO_TICKS(5000))) {
+		return false;
+	}
+
+	std::array<uint8_t, 512> block{};
+	size_t played{};
+	lowest = music.capacity();
+	while (played < size * 2 && !music.failed()) {
+		lowest = std::min(lowest, music.fill_level());
+		const auto read{ music.read_into(block) };
+		for (size_t i{}; i < read; ++i, ++played) {
+			if (block[i] != expected[played % size]) {
+				std::fprintf(stderr, "Stream of \"%s\" differs at %zu\n", file.c_str(), played);
+				return false;
+			}
+		}
+		vTaskDelay(pdMS_TO_TICKS(1));
+	}
+	std::printf("stream %-32s %8zu B  fill %zu..%zu B  %u underruns\n",
+		file.c_str(), size, lowest, music.capacity(), static_cast<unsigned>(music.underruns())
+	);
+	return !music.failed();
+}
+
+auto run(const options &info) -> int {
+	fs::backend::posix::configure(info.backend);
+	if (!fs::manager::initialize({ .backend{ &fs::backend::posix_driver }, .cache{ info.cache } })) {
+		return 1;
+	}
+
+	if (const auto err{ fs::manager::mount({
+		.base_path      { "/assets" },
+		.partition_label{ "assets" },
+	}) }; err != fs::mount_error::ok) {
+		std::fprintf(stderr, "Cannot mount %s/assets: %u\n",
+			std::data(info.backend.root), std::to_underlying(err)
+		);
+		fs::manager::destroy();
+		return 1;
+	}
+	if (fs::manager::mount_pack("pack") == fs::mount_error::ok) {
+		std::printf("Asset pack is mounted\n");
+	}
+
+	int status{};
+	if (fs::benchmark_result bench{}; info.bench && !fs::benchmark::run("/assets", bench)) {
+		status = 1;
+	}
+	for (const auto &name : info.files) {
+		const auto file{ "/assets/" + name };
+		const auto size{ fs::manager::file_size(file) };
+		if (size == SIZE_MAX) {
+			std::fprintf(stderr, "No \"%s\" file\n", file.c_str());
+			status = 1;
+			continue;
+		}
+
+		if (info.stream) {
+			if (size_t lowest{}; size == 0 || !play_stream(file, size, lowest)) {
+				status = 1;
+			}
+			continue;
+		}
+
+		size_t bytes{};
+		fs::manager::reset_cache_stats();
+		for (const auto pass : { "cold", "warm" }) {
+			const auto begin{ std::chrono::steady_clock::now() };
+			if (!read_synchronous(file, info.chunk, bytes)) {
+				status = 1;
+			}
+			report(pass, name, bytes, elapsed_ms(begin));
+		}
+
+		const auto begin{ std::chrono::steady_clock::now() };
+		if (!read_queued(file, size, bytes)) {
+			status = 1;
+		}
+		report("queued", name, bytes, elapsed_ms(begin));
+	}
+
+	fs::manager::destroy();
+	return status;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	options info{};
+	bool    has_root{ false };
+	const std::span args{ argv + 1, static_cast<size_t>(std::max(argc - 1, 0)) };
+	for (size_t i{}; i < std::size(args); ++i) {
+		const std::string_view arg{ args[i] };
+		size_t value{};
+		if (arg == "--bench") {
+			info.bench = true;
+		} else if (arg == "--stream") {
+			info.stream = true;
+		} else if (arg == "--spiffs") {
+			const auto root{ info.backend.root };
+			info.backend      = fs::backend::spiffs_timings;
+			info.backend.root = root;
+		} else if ((arg == "--cache" || arg == "--chunk") && i + 1 < std::size(args)) {
+			if (!parse_number(args[++i], value) || (arg == "--chunk" && value == 0)) {
+				std::fprintf(stderr, "Invalid %s \"%s\"\n", std::data(arg), args[i]);
+				return 1;
+			}
+			if (arg == "--cache") {
+				info.cache.block_count = static_cast<uint16_t>(std::min(value, fs::max_cache_blocks));
+			} else {
+				info.chunk = value;
+			}
+		} else if (!std::exchange(has_root, true)) {
+			info.backend.root = arg;
+		} else {
+			info.files.emplace_back(arg);
+		}
+	}
+
+	if (!has_root || (std::empty(info.files) && !info.bench)) {
+		std::fprintf(stderr,
+			"Usage:\n"
+			"  %s <root> [--spiffs] [--cache <blocks>] [--chunk <bytes>] <file>...\n"
+			"  %s <root> [--spiffs] --bench\n"
+			"  %s <root> [--spiffs] --stream <file>...\n",
+			argv[0], argv[0], argv[0]
+		);
+		return 1;
+	}
+	return run(info);
+}
@@ -0,0 +1,25 @@
+#pragma once
+// Host stand-in of the IDF capability allocator, everything is one heap
+
+#include <cstdlib>
+#include <cstdint>
+
+#define MALLOC_CAP_8BIT     (1u << 2)
+#define MALLOC_CAP_DMA      (1u << 3)
+#define MALLOC_CAP_SPIRAM   (1u << 10)
+#define MALLOC_CAP_INTERNAL (1u << 11)
+
+[[gnu::always_inline]]
+inline auto heap_caps_malloc(const size_t size, const uint32_t) -> void * {
+	return std::malloc(size);
+}
+
+[[gnu::always_inline]]
+inline auto heap_caps_aligned_alloc(const size_t alignment, const size_t size, const uint32_t) -> void * {
+	return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+[[gnu::always_inline]]
+inline void heap_caps_free(void *data) {
+	std::free(data);
+}
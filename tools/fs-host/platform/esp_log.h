@@ -0,0 +1,13 @@
+#pragma once
+// Host stand-in of the IDF logging, to stderr
+
+#include <cstdio>
+
+#define GZN_HOST_LOG(letter, tag, format, ...) \
+	std::fprintf(stderr, letter " (%s) " format "\n", tag __VA_OPT__(,) __VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) GZN_HOST_LOG("E", tag, format __VA_OPT__(,) __VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) GZN_HOST_LOG("W", tag, format __VA_OPT__(,) __VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) GZN_HOST_LOG("I", tag, format __VA_OPT__(,) __VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do {} while (false)
+#define ESP_LOGV(tag, format, ...) do {} while (false)
@@ -0,0 +1,7 @@
+#pragma once
+// Host stand-in, there's no PSRAM
+
+[[gnu::always_inline]]
+inline auto esp_ptr_external_ram(const void *) -> bool {
+	return false;
+}
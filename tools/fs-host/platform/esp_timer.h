@@ -0,0 +1,11 @@
+#pragma once
+// Host stand-in of the IDF high resolution timer
+
+#include <chrono>
+#include <cstdint>
+
+[[gnu::always_inline]]
+inline auto esp_timer_get_time() -> int64_t {
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
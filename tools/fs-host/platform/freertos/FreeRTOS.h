@@ -0,0 +1,17 @@
+#pragma once
+// Host stand-in of the FreeRTOS subset fs::manager uses, see platform.cpp
+// Ticks are milliseconds and tasks are threads.
+
+#include <cstdint>
+
+using BaseType_t  = int32_t;
+using UBaseType_t = uint32_t;
+using TickType_t  = uint32_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdPASS  1
+#define pdFAIL  0
+
+#define portMAX_DELAY     TickType_t{ 0xffffffffu }
+#define pdMS_TO_TICKS(ms) static_cast<TickType_t>(ms)
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+struct host_semaphore;
+using SemaphoreHandle_t = host_semaphore *;
+
+auto xSemaphoreCreateMutex() -> SemaphoreHandle_t;
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+auto xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) -> BaseType_t;
+auto xSemaphoreGive(SemaphoreHandle_t semaphore) -> BaseType_t;
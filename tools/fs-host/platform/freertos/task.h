@@ -0,0 +1,20 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+struct host_task;
+using TaskHandle_t   = host_task *;
+using TaskFunction_t = void (*)(void *);
+
+auto xTaskCreatePinnedToCore(
+	TaskFunction_t function, const char *name, uint32_t stack_size, void *user,
+	UBaseType_t priority, TaskHandle_t *created, BaseType_t core
+) -> BaseType_t;
+
+/// Only of the calling task, which has to return right after it on the host
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+auto xTaskGetCurrentTaskHandle() -> TaskHandle_t;
+
+auto xTaskNotifyGive(TaskHandle_t task) -> BaseType_t;
+auto ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) -> uint32_t;
@@ -0,0 +1,100 @@
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
+
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+struct host_task {
+	std::mutex              guard{};
+	std::condition_variable notified{};
+	uint32_t                count{};
+};
+
+struct host_semaphore {
+	std::timed_mutex mutex{};
+};
+
+namespace {
+
+thread_local host_task *g_current{};
+
+auto timeout(const TickType_t ticks) -> std::chrono::milliseconds {
+	return std::chrono::milliseconds{ ticks };
+}
+
+} // namespace
+
+auto xTaskCreatePinnedToCore(
+	TaskFunction_t function, const char *, uint32_t, void *user,
+	UBaseType_t, TaskHandle_t *created, BaseType_t
+) -> BaseType_t {
+	// Never freed, the firmware doesn't churn tasks either
+	auto task{ new host_task{} };
+	if (created) {
+		*created = task;
+	}
+	std::thread{ [=] {
+		g_current = task;
+		function(user);
+	} }.detach();
+	return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t) {}
+
+void vTaskDelay(const TickType_t ticks) {
+	std::this_thread::sleep_for(timeout(ticks));
+}
+
+auto xTaskGetCurrentTaskHandle() -> TaskHandle_t {
+	if (g_current == nullptr) {
+		g_current = new host_task{}; // the main thread
+	}
+	return g_current;
+}
+
+auto xTaskNotifyGive(TaskHandle_t task) -> BaseType_t {
+	{
+		std::scoped_lock lock{ task->guard };
+		++task->count;
+	}
+	task->notified.notify_one();
+	return pdPASS;
+}
+
+auto ulTaskNotifyTake(const BaseType_t clear, const TickType_t ticks) -> uint32_t {
+	auto &task{ *xTaskGetCurrentTaskHandle() };
+	std::unique_lock lock{ task.guard };
+	const auto ready{ [&] { return task.count != 0; } };
+	if (ticks == portMAX_DELAY) {
+		task.notified.wait(lock, ready);
+	} else {
+		task.notified.wait_for(lock, timeout(ticks), ready);
+	}
+	const auto count{ task.count };
+	task.count = clear ? 0 : count - (count != 0);
+	return count;
+}
+
+auto xSemaphoreCreateMutex() -> SemaphoreHandle_t {
+	return new host_semaphore{};
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+	delete semaphore;
+}
+
+auto xSemaphoreTake(SemaphoreHandle_t semaphore, const TickType_t ticks) -> BaseType_t {
+	if (ticks == portMAX_DELAY) {
+		semaphore->mutex.lock();
+		return pdTRUE;
+	}
+	return semaphore->mutex.try_lock_for(timeout(ticks)) ? pdTRUE : pdFALSE;
+}
+
+auto xSemaphoreGive(SemaphoreHandle_t semaphore) -> BaseType_t {
+	semaphore->mutex.unlock();
+	return pdTRUE;
+}
@@ -0,0 +1,493 @@
+/**
+ * @file main.cpp
+ * @brief Encodes and inspects the videos which graphics::video::player plays
+ *
+ * Usage:
+ *   video-encode [--fps <n>] [--palette] [--key <n>] [--threshold <n>] <output> <frame.ppm>...
+ *   video-encode --info <video>
+ *
+ * Frames are binary PPM (P6) files of the same size, in order, e.g. exported by
+ *   ffmpeg -i clip.mp4 -vf scale=120:80,fps=15 frame-%04d.ppm
+ * Every frame only codes the pixels which changed since the previous one, as
+ * runs or literals. --palette stores 8-bit indices of the 256 most common
+ * colors instead of RGB565, --key makes every n-th frame a whole picture (the
+ * player recovers from dropped frames at them), --threshold keeps pixels
+ * which are off by up to n in every RGB565 channel. Every frame is decoded
+ * back with video::decode(), which the player uses, and compared.
+ */
+
+#include <span>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+#include "gzn/graphics/video-format.hpp"
+
+namespace {
+
+using namespace gzn::graphics::video;
+using gzn::core::color;
+
+/// Unchanged pixels which cost less than a new op, so they are coded over
+inline constexpr size_t OP_SIZE { 3 };
+inline constexpr size_t MAX_OPS { 255 };
+
+struct image {
+	uint16_t           width{};
+	uint16_t           height{};
+	std::vector<color> pixels{};
+};
+
+struct encode_options {
+	uint32_t fps{ 15 };
+	uint16_t key_interval{};
+	uint8_t  threshold{};
+	bool     palette{ false };
+};
+
+auto read_file(const char *path, std::vector<uint8_t> &data) -> bool {
+	auto file{ std::fopen(path, "rb") };
+	if (!file) {
+		return false;
+	}
+	std::array<uint8_t, 4096> chunk{};
+	for (size_t read{}; (read = std::fread(std::data(chunk), 1, std::size(chunk), file)) != 0;) {
+		data.insert(std::end(data), std::begin(chunk), std::begin(chunk) + read);
+	}
+	const auto ok{ !std::ferror(file) };
+	std::fclose(file);
+	return ok;
+}
+
+[[nodiscard]]
+auto to_rgb565(const uint8_t r, const uint8_t g, const uint8_t b) -> color {
+	return static_cast<color>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+/// Binary PPM with 8-bit channels, comments allowed in the header
+auto read_ppm(const char *path, image &frame) -> bool {
+	std::vector<uint8_t> data{};
+	if (!read_file(path, data)) {
+		std::fprintf(stderr, "Cannot read \"%s\"\n", path);
+		return false;
+	}
+
+	size_t at{};
+	const auto field{ [&]() -> long {
+		while (at < std::size(data)) {
+			if (data[at] == '#') {
+				while (at < std::size(data) && data[at] != '\n') {
+					++at;
+				}
+			} else if (std::isspace(data[at])) {
+				++at;
+			} else {
+				break;
+			}
+		}
+		long value{};
+		bool digits{ false };
+		for (; at < std::size(data) && std::isdigit(data[at]); ++at, digits = true) {
+			value = value * 10 + (data[at] - '0');
+		}
+		return digits ? value : -1;
+	} };
+
+	if (std::size(data) < 2 || data[0] != 'P' || data[1] != '6') {
+		std::fprintf(stderr, "\"%s\" isn't a binary PPM (P6)\n", path);
+		return false;
+	}
+	at = 2;
+	const auto width{ field() }, height{ field() }, max_value{ field() };
+	if (width <= 0 || height <= 0 || width > UINT16_MAX || height > UINT16_MAX || max_value != 255) {
+		std::fprintf(stderr, "\"%s\" has to be up to 65535x65535 with 8-bit channels\n", path);
+		return false;
+	}
+	++at; // the single whitespace before the pixels
+
+	const auto count{ static_cast<size_t>(width) * static_cast<size_t>(height) };
+	if (std::size(data) < at + count * 3) {
+		std::fprintf(stderr, "\"%s\" is truncated\n", path);
+		return false;
+	}
+	frame.width  = static_cast<uint16_t>(width);
+	frame.height = static_cast<uint16_t>(height);
+	frame.pixels.resize(count);
+	for (size_t i{}; i < count; ++i) {
+		const auto rgb{ std::data(data) + at + i * 3 };
+		frame.pixels[i] = to_rgb565(rgb[0], rgb[1], rgb[2]);
+	}
+	return true;
+}
+
+[[nodiscard]]
+auto channel_distance(const color a, const color b) -> int {
+	const auto r{ std::abs(((a >> 11) & 0x1F) - ((b >> 11) & 0x1F)) };
+	const auto g{ std::abs(((a >>  5) & 0x3F) - ((b >>  5) & 0x3F)) };
+	const auto bl{ std::abs((a & 0x1F) - (b & 0x1F)) };
+	return std::max({ r, g, bl });
+}
+
+[[nodiscard]]
+auto squared_distance(const color a, const color b) -> int {
+	// Green has a bit more, so it's halved to weigh the channels evenly
+	const auto r{ ((a >> 11) & 0x1F) - ((b >> 11) & 0x1F) };
+	const auto g{ (((a >> 5) & 0x3F) - ((b >> 5) & 0x3F)) / 2 };
+	const auto bl{ (a & 0x1F) - (b & 0x1F) };
+	return r * r + g * g + bl * bl;
+}
+
+/// The most common colors of all frames, the others map to the nearest of them
+struct palette_map {
+	std::vector<color>                    colors{};
+	std::unordered_map<color, uint8_t>    indices{};
+
+	void build(const std::span<const image> frames) {
+		std::unordered_map<color, size_t> counts{};
+		for (const auto &frame : frames) {
+			for (const auto pixel : frame.pixels) {
+				++counts[pixel];
+			}
+		}
+		std::vector<std::pair<color, size_t>> sorted{ std::begin(counts), std::end(counts) };
+		std::ranges::sort(sorted, [](const auto &a, const auto &b) {
+			return a.second != b.second ? a.second > b.second : a.first < b.first;
+		});
+		for (size_t i{}; i < std::min(std::size(sorted), MAX_PALETTE); ++i) {
+			colors.push_back(sorted[i].first);
+		}
+	}
+
+	[[nodiscard]]
+	auto index_of(const color value) -> uint8_t {
+		if (const auto found{ indices.find(value) }; found != std::end(indices)) {
+			return found->second;
+		}
+		size_t best{};
+		for (size_t i{ 1 }; i < std::size(colors); ++i) {
+			if (squared_distance(colors[i], value) < squared_distance(colors[best], value)) {
+				best = i;
+			}
+		}
+		return indices[value] = static_cast<uint8_t>(best);
+	}
+};
+
+struct encoder {
+	header             info{};
+	encode_options     options{};
+	palette_map        palette{};
+	std::vector<color> shown{};    ///< what the player has on the screen
+	std::vector<uint8_t> out{};
+
+	static void put_u8(std::vector<uint8_t> &to, const uint8_t value) { to.push_back(value); }
+
+	static void put_u16(std::vector<uint8_t> &to, const uint16_t value) {
+		to.push_back(static_cast<uint8_t>(value));
+		to.push_back(static_cast<uint8_t>(value >> 8));
+	}
+
+	void put_pixel(std::vector<uint8_t> &to, const uint16_t value) {
+		if (info.format == pixel_format::rgb565) {
+			put_u16(to, value);
+		} else {
+			put_u8(to, static_cast<uint8_t>(value));
+		}
+	}
+
+	struct record {
+		std::vector<uint8_t> &frame;
+		std::vector<uint8_t>  ops{};
+		size_t                count{};
+		size_t                end_x{};  ///< of the last op, skips count from it
+		uint16_t              y{};
+	};
+
+	void flush(record &row) {
+		if (row.count == 0) {
+			return;
+		}
+		put_u16(row.frame, row.y);
+		put_u8(row.frame, static_cast<uint8_t>(row.count));
+		row.frame.insert(std::end(row.frame), std::begin(row.ops), std::end(row.ops));
+		row.ops.clear();
+		row.count = 0;
+		row.end_x = 0;
+	}
+
+	/// A row with more than MAX_OPS ops goes on in another record
+	void put_op(record &row, const size_t x, const uint8_t code) {
+		if (row.count == MAX_OPS) {
+			flush(row);
+		}
+		put_u16(row.ops, static_cast<uint16_t>(x - row.end_x));
+		put_u8(row.ops, code);
+		row.end_x = x + (code & (RUN_BIT - 1u)) + 1;
+		++row.count;
+	}
+
+	/// Codes @p values at @p x as runs and literals of up to MAX_OP pixels
+	void put_span(record &row, const size_t x, const std::span<const uint16_t> values) {
+		const auto pixel{ pixel_size(info.format) };
+		// A run is worth an op of its own once it saves more than the op costs
+		const auto min_run{ (OP_SIZE + pixel) / pixel + 1 };
+
+		size_t at{};
+		while (at < std::size(values)) {
+			size_t run{ 1 };
+			while (at + run < std::size(values) && run < MAX_OP && values[at + run] == values[at]) {
+				++run;
+			}
+			if (run >= min_run) {
+				put_op(row, x + at, static_cast<uint8_t>(RUN_BIT | (run - 1)));
+				put_pixel(row.ops, values[at]);
+				at += run;
+				continue;
+			}
+
+			// Literals till the next run which is worth it
+			auto end{ at };
+			while (end < std::size(values) && end - at < MAX_OP) {
+				size_t ahead{ 1 };
+				while (end + ahead < std::size(values) && ahead < min_run && values[end + ahead] == values[end]) {
+					++ahead;
+				}
+				if (ahead >= min_run) {
+					break;
+				}
+				++end;
+			}
+			put_op(row, x + at, static_cast<uint8_t>(end - at - 1));
+			for (auto i{ at }; i < end; ++i) {
+				put_pixel(row.ops, values[i]);
+			}
+			at = end;
+		}
+	}
+
+	auto add(const image &source, const bool key) -> bool {
+		const auto width{ size_t{ info.width } };
+		std::vector<uint16_t> values(std::size(source.pixels));
+		std::vector<color>    target(std::size(source.pixels));
+		for (size_t i{}; i < std::size(values); ++i) {
+			if (info.format == pixel_format::palette8) {
+				values[i] = palette.index_of(source.pixels[i]);
+				target[i] = palette.colors[values[i]];
+			} else {
+				values[i] = target[i] = source.pixels[i];
+			}
+		}
+
+		const auto pixel{ pixel_size(info.format) };
+		const auto max_gap{ std::max<size_t>(OP_SIZE / pixel, 1) };
+		std::vector<uint8_t> payload{};
+		for (size_t y{}; y < info.height; ++y) {
+			const auto offset{ y * width };
+			const auto changed{ [&](const size_t x) {
+				return key || channel_distance(shown[offset + x], target[offset + x]) > options.threshold;
+			} };
+
+			record row{ .frame{ payload }, .y = static_cast<uint16_t>(y) };
+			size_t x{};
+			while (x < width) {
+				if (!changed(x)) {
+					++x;
+					continue;
+				}
+				// The span runs till a gap which is cheaper as a new op
+				auto   end{ x + 1 };
+				size_t gap{};
+				for (auto next{ end }; next < width; ++next) {
+					if (changed(next)) {
+						end = next + 1;
+						gap = 0;
+					} else if (++gap > max_gap) {
+						break;
+					}
+				}
+				put_span(row, x, std::span{ values }.subspan(offset + x, end - x));
+				x = end;
+			}
+			flush(row);
+		}
+
+		if (!decode(payload, info, palette.colors, shown, width)) {
+			std::fprintf(stderr, "Frame %u doesn't decode back\n", static_cast<unsigned>(info.frame_count));
+			return false;
+		}
+		for (size_t i{}; i < std::size(shown); ++i) {
+			if (channel_distance(shown[i], target[i]) > options.threshold) {
+				std::fprintf(stderr, "Frame %u decodes to something else at %zu, %zu\n",
+					static_cast<unsigned>(info.frame_count), i % width, i / width
+				);
+				return false;
+			}
+		}
+
+		const frame_header frame{
+			.size  = static_cast<uint32_t>(std::size(payload)),
+			.flags = key ? KEY_FRAME : uint8_t{},
+		};
+		const auto bytes{ reinterpret_cast<const uint8_t *>(&frame) };
+		out.insert(std::end(out), bytes, bytes + sizeof(frame));
+		out.insert(std::end(out), std::begin(payload), std::end(payload));
+		info.max_frame_size = std::max(info.max_frame_size, frame.size);
+		++info.frame_count;
+		return true;
+	}
+};
+
+auto encode(const encode_options &options, const char *output, const std::span<char *> inputs) -> int {
+	std::vector<image> frames(std::size(inputs));
+	for (size_t i{}; i < std::size(inputs); ++i) {
+		if (!read_ppm(inputs[i], frames[i])) {
+			return 1;
+		}
+		if (frames[i].width != frames[0].width || frames[i].height != frames[0].height) {
+			std::fprintf(stderr, "\"%s\" is %ux%u, the video is %ux%u\n", inputs[i],
+				frames[i].width, frames[i].height, frames[0].width, frames[0].height
+			);
+			return 1;
+		}
+	}
+
+	encoder video{ .options{ options } };
+	video.info.format       = options.palette ? pixel_format::palette8 : pixel_format::rgb565;
+	video.info.width        = frames[0].width;
+	video.info.height       = frames[0].height;
+	video.info.frame_us     = 1'000'000u / options.fps;
+	video.info.key_interval = options.key_interval;
+	if (options.palette) {
+		video.palette.build(frames);
+		video.info.palette_size = static_cast<uint16_t>(std::size(video.palette.colors));
+	}
+	video.shown.resize(std::size(frames[0].pixels));
+
+	for (size_t i{}; i < std::size(frames); ++i) {
+		const auto key{ i == 0 || (options.key_interval != 0 && i % options.key_interval == 0) };
+		if (!video.add(frames[i], key)) {
+			return 1;
+		}
+	}
+
+	auto file{ std::fopen(output, "wb") };
+	const auto written{ file
+		&& std::fwrite(&video.info, sizeof(video.info), 1, file) == 1
+		// RGB565 videos have no palette, and fwrite() mustn't get its null data
+		&& (std::empty(video.palette.colors)
+			|| std::fwrite(std::data(video.palette.colors), sizeof(color), std::size(video.palette.colors), file)
+				== std::size(video.palette.colors))
+		&& std::fwrite(std::data(video.out), 1, std::size(video.out), file) == std::size(video.out)
+	};
+	if (file) {
+		std::fclose(file);
+	}
+	if (!written) {
+		std::fprintf(stderr, "Cannot write \"%s\"\n", output);
+		return 1;
+	}
+
+	const auto raw{ std::size(frames) * std::size(frames[0].pixels) * sizeof(color) };
+	const auto size{ frames_offset(video.info) + std::size(video.out) };
+	std::printf("%zu frames of %ux%u to \"%s\": %zu bytes (%.1f%% of raw RGB565), "
+		"%u bytes max per frame, %u KB/s at %u fps\n",
+		std::size(frames), video.info.width, video.info.height, output, size,
+		100.0 * static_cast<double>(size) / static_cast<double>(raw),
+		static_cast<unsigned>(video.info.max_frame_size),
+		static_cast<unsigned>(size * options.fps / std::size(frames) / 1024),
+		static_cast<unsigned>(options.fps)
+	);
+	return 0;
+}
+
+auto info(const char *path) -> int {
+	std::vector<uint8_t> data{};
+	if (!read_file(path, data)) {
+		std::fprintf(stderr, "Cannot read \"%s\"\n", path);
+		return 1;
+	}
+	header video{};
+	if (const auto err{ read_header(data, video) }; err != error::ok) {
+		std::fprintf(stderr, "\"%s\" isn't a video: %u\n", path, static_cast<unsigned>(err));
+		return 1;
+	}
+
+	std::vector<color> palette(video.palette_size);
+	if (!std::empty(palette)) {
+		std::memcpy(std::data(palette), std::data(data) + sizeof(header), std::size(palette) * sizeof(color));
+	}
+	std::vector<color> screen(size_t{ video.width } * video.height);
+
+	auto   at{ frames_offset(video) };
+	size_t keys{}, largest{};
+	for (uint32_t i{}; i < video.frame_count; ++i) {
+		frame_header frame{};
+		if (std::size(data) < at + sizeof(frame)) {
+			std::fprintf(stderr, "Frame %u is missing\n", static_cast<unsigned>(i));
+			return 1;
+		}
+		std::memcpy(&frame, std::data(data) + at, sizeof(frame));
+		at += sizeof(frame);
+		if (std::size(data) < at + frame.size || frame.size > video.max_frame_size
+		||  !decode(std::span{ data }.subspan(at, frame.size), video, palette, screen, video.width)
+		) {
+			std::fprintf(stderr, "Frame %u is corrupted\n", static_cast<unsigned>(i));
+			return 1;
+		}
+		at     += frame.size;
+		keys   += (frame.flags & KEY_FRAME) != 0;
+		largest = std::max<size_t>(largest, frame.size);
+	}
+
+	std::printf("%ux%u %s, %u frames of %u us, %zu key, %u bytes max per frame (%zu seen), %zu bytes\n",
+		video.width, video.height,
+		video.format == pixel_format::rgb565 ? "rgb565" : "palette8",
+		static_cast<unsigned>(video.frame_count), static_cast<unsigned>(video.frame_us),
+		keys, static_cast<unsigned>(video.max_frame_size), largest, std::size(data)
+	);
+	return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	const std::span args{ argv, static_cast<size_t>(argc) };
+	if (argc == 3 && std::string_view{ args[1] } == "--info") {
+		return info(args[2]);
+	}
+
+	encode_options options{};
+	size_t at{ 1 };
+	for (; at + 1 < std::size(args) && std::string_view{ args[at] }.starts_with("--"); ++at) {
+		const std::string_view option{ args[at] };
+		if (option == "--palette") {
+			options.palette = true;
+		} else if (option == "--fps") {
+			options.fps = static_cast<uint32_t>(std::clamp(std::atol(args[++at]), 1l, 1000l));
+		} else if (option == "--key") {
+			options.key_interval = static_cast<uint16_t>(std::clamp(std::atol(args[++at]), 0l, 65535l));
+		} else if (option == "--threshold") {
+			options.threshold = static_cast<uint8_t>(std::clamp(std::atol(args[++at]), 0l, 63l));
+		} else {
+			break;
+		}
+	}
+	if (at + 2 <= std::size(args) && !std::string_view{ args[at] }.starts_with("--")) {
+		return encode(options, args[at], args.subspan(at + 1));
+	}
+
+	std::fprintf(stderr,
+		"Usage:\n"
+		"  %s [--fps <n>] [--palette] [--key <n>] [--threshold <n>] <output> <frame.ppm>...\n"
+		"  %s --info <video>\n",
+		args[0], args[0]
+	);
+	return 1;
+}